@@ -10,9 +10,9 @@ path const VERTEX_SHADER_FILE = "height_overlap_outline.vs",
 	GEOMETRY_SHADER_FILE = "to_outline.gs",
 	FRAGMENT_SHADER_FILE = "colored.fs";
 
-above_terrain_outline_shader_program::above_terrain_outline_shader_program() {
-	string const vertex_shader = read_file(VERTEX_SHADER_FILE),
-		geometry_shader = read_file(GEOMETRY_SHADER_FILE),
+above_terrain_outline_shader_program::above_terrain_outline_shader_program(terrain_shader_variant variant) {
+	string const vertex_shader = with_variant_defines(read_file(VERTEX_SHADER_FILE), variant),
+		geometry_shader = with_variant_defines(read_file(GEOMETRY_SHADER_FILE), variant),
 		fragment_shader = read_file(FRAGMENT_SHADER_FILE);
 
 	assert(!empty(vertex_shader) && !empty(geometry_shader) && !empty(fragment_shader));
@@ -21,12 +21,14 @@ above_terrain_outline_shader_program::above_terrain_outline_shader_program() {
 	assert(_prog != 0);
 
 	// vertex
-	_position = glGetAttribLocation(_prog, "position");
-	assert(_position == 0 && "we are expecting position location ID is set to 0");
+	_position = glGetAttribLocation(_prog, "position");  // -1 for vertex pulling variant (no vertex attributes)
+	assert((pulls_vertices(variant) || _position == 0) && "we are expecting position location ID is set to 0");
+	_quad_resolution = glGetUniformLocation(_prog, "quad_resolution");
 
 	_heights = glGetUniformLocation(_prog, "heights");
 	_elevation_scale = glGetUniformLocation(_prog, "elevation_scale");
 	_height_scale = glGetUniformLocation(_prog, "height_scale");
+	_top_down_rows = glGetUniformLocation(_prog, "top_down_rows");
 
 	// geometry
 	_local_to_screen = glGetUniformLocation(_prog, "local_to_screen");
@@ -36,10 +38,18 @@ above_terrain_outline_shader_program::above_terrain_outline_shader_program() {
 
 	// check uniforms are active
 	assert(_heights != -1);
-	assert(_elevation_scale!= -1);
-	assert(_height_scale!= -1);
-	assert(_local_to_screen != -1);
 	assert(_fill_color != -1);
+
+	assert((!pulls_vertices(variant) || _quad_resolution != -1) && "quad resolution expected for vertex pulling");
+
+	if (has_loose_uniforms(variant)) {  // otherwise in terrain uniform blocks
+		assert(_elevation_scale!= -1);
+		assert(_height_scale!= -1);
+		assert(_top_down_rows != -1);
+		assert(_local_to_screen != -1);
+	}
+	else
+		bind_terrain_uniform_blocks(_prog);
 }
 
 above_terrain_outline_shader_program::~above_terrain_outline_shader_program() {
@@ -70,6 +80,14 @@ void above_terrain_outline_shader_program::fill_color(glm::vec3 const & color) {
 	set_uniform(_fill_color, color);
 }
 
+void above_terrain_outline_shader_program::top_down_rows(bool value) {
+	set_uniform(_top_down_rows, value);
+}
+
+void above_terrain_outline_shader_program::quad_resolution(int n) {
+	set_uniform(_quad_resolution, n);
+}
+
 GLint above_terrain_outline_shader_program::position_location() const {
 	return _position;
 }
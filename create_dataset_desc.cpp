@@ -0,0 +1,237 @@
+/* Creates `dataset.json` dataset description file for dataset directory with elevation and satellite
+tiles (see `script/create_dataset_desc.py`). Elevation tiles are scanned (in parallel) with vectorized
+min/max kernels (see `raster_stats.hpp`), elevation and satellite pixel size is read from GeoTIFF tags.
+
+Usage: create_dataset_desc [--elevation-prefix PREFIX] [--satellite-prefix PREFIX] [--elevation-codec CODEC]
+	[--histogram] [--threads N] DATASET_DIR GRID_SIZE
+
+CODEC is elevation tile codec used by `pack_tiles` ("raw" or "dem"). */
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include "tiff.hpp"
+#include "geotiff.hpp"
+#include "raster_stats.hpp"
+
+using std::vector, std::map, std::string, std::size, std::empty;
+using std::filesystem::path, std::filesystem::directory_iterator;
+using std::ofstream, std::cerr;
+using std::jthread, std::atomic;
+using fmt::print, fmt::format;
+
+struct desc_options {
+	path dataset_directory;
+	int grid_size = 0;
+	string elevation_tile_prefix = "plzen_elev_",
+		satellite_tile_prefix = "plzen_rgb_",
+		elevation_codec = "raw";  //!< tile pack elevation codec (see `pack_tiles`)
+	bool histogram = false;  //!< store elevation histogram for each tile
+	unsigned thread_count = std::thread::hardware_concurrency();
+};
+
+struct tile_stats {
+	raster_stats stats;
+	raster_histogram histogram = {};
+};
+
+struct tile_info {
+	size_t tile_size = 0;
+	double pixel_size = 0.0;
+};
+
+vector<path> list_tiles(path const & dataset_directory, string const & prefix);
+tile_info read_tile_info(path const & tile);
+tile_stats compute_tile_stats(path const & tile, bool histogram);
+void write_dataset_desc(path const & fname, desc_options const & opts, tile_info const & elevation,
+	tile_info const & satellite, map<string, tile_stats> const & files);
+void parse_commandline(int argc, char * argv[], desc_options & opts);
+
+int main(int argc, char * argv[]) {
+	desc_options opts;
+	try {
+		parse_commandline(argc, argv, opts);
+	}
+	catch (std::exception const & e) {
+		cerr << e.what() << "\n"
+			<< "usage: create_dataset_desc [--elevation-prefix PREFIX] [--satellite-prefix PREFIX] [--elevation-codec CODEC] [--histogram] [--threads N] DATASET_DIR GRID_SIZE\n";
+		return 1;
+	}
+
+	TIFFSetWarningHandler(nullptr);  // e.g. unknown GDAL tags
+	register_geotiff_tags();
+
+	vector<path> const elevation_tiles = list_tiles(opts.dataset_directory, opts.elevation_tile_prefix),
+		satellite_tiles = list_tiles(opts.dataset_directory, opts.satellite_tile_prefix);
+
+	if (empty(elevation_tiles) || empty(satellite_tiles)) {
+		cerr << format("no elevation or satellite tiles found in '{}' directory\n", opts.dataset_directory.c_str());
+		return 1;
+	}
+
+	tile_info const elevation = read_tile_info(elevation_tiles[0]),
+		satellite = read_tile_info(satellite_tiles[0]);
+
+	if (elevation.pixel_size <= 0.0 || satellite.pixel_size <= 0.0) {
+		cerr << "GeoTIFF pixel size (ModelPixelScaleTag) expected for elevation and satellite tiles\n";
+		return 1;
+	}
+
+	// compute elevation statistics, each worker takes the next not processed tile
+	vector<tile_stats> stats(size(elevation_tiles));
+	vector<std::exception_ptr> errors(opts.thread_count);
+	atomic<size_t> next_tile = 0;
+
+	auto worker_fn = [&](unsigned worker){
+		try {
+			for (size_t i = next_tile++; i < size(elevation_tiles); i = next_tile++)
+				stats[i] = compute_tile_stats(elevation_tiles[i], opts.histogram);
+		}
+		catch (...) {
+			errors[worker] = std::current_exception();
+		}
+	};
+
+	{
+		vector<jthread> workers;
+		for (unsigned worker = 1; worker < opts.thread_count; ++worker)
+			workers.emplace_back(worker_fn, worker);
+		worker_fn(0);
+	}  // join workers
+
+	for (std::exception_ptr const & e : errors)
+		if (e)
+			std::rethrow_exception(e);
+
+	map<string, tile_stats> files;
+	for (size_t i = 0; i < size(elevation_tiles); ++i)
+		files[elevation_tiles[i].filename().string()] = stats[i];
+
+	path const dataset_path = opts.dataset_directory/"dataset.json";
+	write_dataset_desc(dataset_path, opts, elevation, satellite, files);
+
+	print("{} created ({} elevation tiles, {} kernel)!\n", dataset_path.c_str(), size(files), stats_kernel_name());
+	return 0;
+}
+
+vector<path> list_tiles(path const & dataset_directory, string const & prefix) {
+	vector<path> tiles;
+	for (auto const & entry : directory_iterator{dataset_directory}) {
+		string const filename = entry.path().filename().string();
+		if (filename.starts_with(prefix) && entry.path().extension() == ".tif")
+			tiles.push_back(entry.path());
+	}
+	return tiles;
+}
+
+tile_info read_tile_info(path const & tile) {
+	geotiff_tags const tags = read_geotiff_tags(tile);
+	tiff_row_reader const image{tile};  // pixels are not read
+	return {
+		.tile_size = image.desc().width,
+		.pixel_size = empty(tags.pixel_scale) ? 0.0 : tags.pixel_scale[0]
+	};
+}
+
+tile_stats compute_tile_stats(path const & tile, bool histogram) {
+	mapped_tiff const image{tile};
+	tiff_data_desc const & desc = image.desc();
+	if (desc.bytes_per_sample != 2 || !is_grayscale(desc))
+		throw std::runtime_error{format("16bit grayscale elevation tile expected ('{}')", tile.c_str())};
+
+	// note: samples are treated as unsigned the same way renderer does (GL_R16UI textures)
+	tile_stats result;
+	for (mapped_tiff::block const & b : image.blocks()) {
+		for (size_t r = 0; r < b.h; ++r) {
+			uint16_t const * row = reinterpret_cast<uint16_t const *>(b.pixels) + r*b.row_length;
+			result.stats.merge(compute_stats(row, b.w));
+			if (histogram)
+				add_to_histogram(row, b.w, result.histogram);
+		}
+	}
+
+	return result;
+}
+
+void write_dataset_desc(path const & fname, desc_options const & opts, tile_info const & elevation,
+	tile_info const & satellite, map<string, tile_stats> const & files) {
+
+	ofstream fout{fname};
+	if (!fout.is_open())
+		throw std::runtime_error{format("can't create '{}' file", fname.c_str())};
+
+	fout << "{\n"
+		<< "  \"// Describes dataset directory\": \"\",\n"
+		<< format("  \"grid_size\": {},\n", opts.grid_size)
+		<< "  \"elevation\": {\n"
+		<< format("    \"tile_prefix\": \"{}\",\n", opts.elevation_tile_prefix)
+		<< format("    \"pixel_size\": {},\n", elevation.pixel_size)
+		<< format("    \"tile_size\": {},\n", elevation.tile_size)
+		<< format("    \"codec\": \"{}\"\n", opts.elevation_codec)
+		<< "  },\n"
+		<< "  \"satellite\": {\n"
+		<< format("    \"tile_prefix\": \"{}\",\n", opts.satellite_tile_prefix)
+		<< format("    \"tile_size\": {},\n", satellite.tile_size)
+		<< format("    \"pixel_size\": {}\n", satellite.pixel_size)
+		<< "  },\n"
+		<< "  \"// file specific data\": \"\",\n"
+		<< "  \"files\": {";
+
+	char const * separator = "\n";
+	for (auto const & [filename, tile] : files) {
+		fout << separator
+			<< format("    \"{}\": {{\n", filename)
+			<< format("      \"maxval\": {},\n", tile.stats.max)
+			<< format("      \"minval\": {},\n", tile.stats.min)
+			<< format("      \"meanval\": {:.3f}", tile.stats.mean());
+
+		if (opts.histogram)
+			fout << format(",\n      \"histogram\": [{}]", fmt::join(tile.histogram, ", "));
+
+		fout << "\n    }";
+		separator = ",\n";
+	}
+
+	fout << "\n  }\n}\n";
+}
+
+void parse_commandline(int argc, char * argv[], desc_options & opts) {
+	vector<string> positional;
+	for (int i = 1; i < argc; ++i) {
+		string const arg = argv[i];
+		auto value = [&]() -> string {
+			if (i+1 >= argc)
+				throw std::runtime_error{format("missing '{}' option value", arg)};
+			return argv[++i];
+		};
+
+		if (arg == "--elevation-prefix")
+			opts.elevation_tile_prefix = value();
+		else if (arg == "--satellite-prefix")
+			opts.satellite_tile_prefix = value();
+		else if (arg == "--elevation-codec")
+			opts.elevation_codec = value();
+		else if (arg == "--histogram")
+			opts.histogram = true;
+		else if (arg == "--threads")
+			opts.thread_count = stoul(value());
+		else if (arg.starts_with("--"))
+			throw std::runtime_error{format("unknown '{}' option", arg)};
+		else
+			positional.push_back(arg);
+	}
+
+	if (size(positional) != 2)
+		throw std::runtime_error{"we expect dataset directory path and grid size as command line arguments"};
+
+	opts.dataset_directory = positional[0];
+	opts.grid_size = stoi(positional[1]);
+	opts.thread_count = std::max(opts.thread_count, 1u);
+}
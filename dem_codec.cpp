@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+#include <cstring>
+#if defined(__x86_64__)
+	#include <emmintrin.h>
+#elif defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+#include "dem_codec.hpp"
+
+using std::vector, std::byte, std::size;
+
+namespace {
+
+//! Packed block is stored as `bit_width` 64bit words.
+constexpr size_t block_bytes(unsigned bit_width) {return bit_width*dem_codec_block_size/8;}
+
+static_assert(dem_codec_block_size == 64, "block needs to be bit_width 64bit words long");
+
+inline uint16_t zigzag(uint16_t residual) {
+	return uint16_t(residual << 1) ^ uint16_t(int16_t(residual) >> 15);
+}
+
+inline uint16_t unzigzag(uint16_t value) {
+	return (value >> 1) ^ uint16_t(-(value & 1));
+}
+
+void pack_block(uint16_t const * values, unsigned bit_width, vector<byte> & out) {
+	out.push_back(byte(bit_width));
+
+	uint64_t words[16] = {};
+	for (size_t i = 0, bit = 0; i < dem_codec_block_size; ++i, bit += bit_width) {
+		size_t const word = bit / 64,
+			offset = bit % 64;
+		words[word] |= uint64_t{values[i]} << offset;
+		if (offset + bit_width > 64)
+			words[word+1] |= uint64_t{values[i]} >> (64 - offset);
+	}
+
+	size_t const pos = size(out);
+	out.resize(pos + block_bytes(bit_width));
+	memcpy(out.data() + pos, words, block_bytes(bit_width));  // little endian
+}
+
+template <unsigned BitWidth>
+void unpack_block(uint64_t const * words, uint16_t * values) {
+	constexpr uint64_t mask = (uint64_t{1} << BitWidth) - 1;
+	#pragma GCC unroll 64  // bit positions and word indices are compile time constants after unroll
+	for (size_t i = 0; i < dem_codec_block_size; ++i) {
+		size_t const bit = i*BitWidth,
+			word = bit / 64,
+			offset = bit % 64;
+		uint64_t v = words[word] >> offset;
+		if (offset + BitWidth > 64)
+			v |= words[word+1] << (64 - offset);
+		values[i] = uint16_t(v & mask);
+	}
+}
+
+template <>
+void unpack_block<0>(uint64_t const *, uint16_t * values) {
+	std::fill_n(values, dem_codec_block_size, 0);
+}
+
+using unpack_function = void (*)(uint64_t const *, uint16_t *);
+
+template <size_t ... BitWidth>
+constexpr std::array<unpack_function, sizeof...(BitWidth)> make_unpack_table(std::index_sequence<BitWidth...>) {
+	return {&unpack_block<BitWidth>...};
+}
+
+//! Block unpack function for each (0-16) bit width.
+constexpr auto unpack_table = make_unpack_table(std::make_index_sequence<17>{});
+
+void unpack_block(byte const * data, unsigned bit_width, uint16_t * values) {
+	uint64_t words[16];
+	memcpy(words, data, block_bytes(bit_width));  // little endian
+	unpack_table[bit_width](words, values);
+}
+
+//! row[i] = unzigzag(row[i]) + prev[i]
+void reconstruct_row_scalar(uint16_t * row, uint16_t const * prev, size_t width) {
+	for (size_t i = 0; i < width; ++i)
+		row[i] = unzigzag(row[i]) + prev[i];
+}
+
+#if defined(__x86_64__)
+
+void reconstruct_row_sse2(uint16_t * row, uint16_t const * prev, size_t width) {
+	__m128i const one = _mm_set1_epi16(1),
+		zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 8 <= width; i += 8) {
+		__m128i const z = _mm_loadu_si128(reinterpret_cast<__m128i const *>(row + i)),
+			p = _mm_loadu_si128(reinterpret_cast<__m128i const *>(prev + i));
+		__m128i const d = _mm_xor_si128(_mm_srli_epi16(z, 1), _mm_sub_epi16(zero, _mm_and_si128(z, one)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(row + i), _mm_add_epi16(d, p));
+	}
+
+	reconstruct_row_scalar(row + i, prev + i, width - i);  // tail
+}
+
+#elif defined(__aarch64__)
+
+void reconstruct_row_neon(uint16_t * row, uint16_t const * prev, size_t width) {
+	uint16x8_t const one = vdupq_n_u16(1);
+
+	size_t i = 0;
+	for (; i + 8 <= width; i += 8) {
+		uint16x8_t const z = vld1q_u16(row + i);
+		int16x8_t const sign = vnegq_s16(vreinterpretq_s16_u16(vandq_u16(z, one)));
+		uint16x8_t const d = veorq_u16(vshrq_n_u16(z, 1), vreinterpretq_u16_s16(sign));
+		vst1q_u16(row + i, vaddq_u16(d, vld1q_u16(prev + i)));
+	}
+
+	reconstruct_row_scalar(row + i, prev + i, width - i);  // tail
+}
+
+#endif
+
+void reconstruct_row(uint16_t * row, uint16_t const * prev, size_t width) {
+#if defined(__x86_64__)
+	reconstruct_row_sse2(row, prev, width);  // SSE2 is part of x86-64 baseline
+#elif defined(__aarch64__)
+	reconstruct_row_neon(row, prev, width);
+#else
+	reconstruct_row_scalar(row, prev, width);
+#endif
+}
+
+}  // namespace
+
+vector<byte> encode_dem(uint16_t const * samples, size_t width, size_t height) {
+	size_t const count = width*height;
+
+	vector<byte> out;
+	out.reserve(count);  // 8 bits per sample guess
+
+	uint16_t block[dem_codec_block_size];
+	for (size_t first = 0; first < count; first += dem_codec_block_size) {
+		size_t const n = std::min(dem_codec_block_size, count - first);
+
+		uint16_t max_value = 0;
+		for (size_t i = 0; i < n; ++i) {
+			size_t const idx = first + i;
+			uint16_t const prediction = (idx >= width) ? samples[idx - width]  // above
+				: (idx > 0 ? samples[idx - 1] : 0);  // left for the first row
+
+			block[i] = zigzag(uint16_t(samples[idx] - prediction));
+			max_value = std::max(max_value, block[i]);
+		}
+		std::fill(block + n, block + dem_codec_block_size, 0);
+
+		pack_block(block, std::bit_width(max_value), out);
+	}
+
+	return out;
+}
+
+void decode_dem(byte const * data, size_t size, size_t width, size_t height, uint16_t * samples) {
+	size_t const count = width*height;
+
+	// unpack residuals
+	byte const * const data_end = data + size;
+	uint16_t block[dem_codec_block_size];
+	for (size_t first = 0; first < count; first += dem_codec_block_size) {
+		if (data == data_end)
+			throw std::runtime_error{"truncated DEM codec data"};
+
+		unsigned const bit_width = unsigned(*data++);
+		if (bit_width > 16 || size_t(data_end - data) < block_bytes(bit_width))
+			throw std::runtime_error{"corrupted DEM codec data"};
+
+		size_t const n = std::min(dem_codec_block_size, count - first);
+		if (n == dem_codec_block_size)
+			unpack_block(data, bit_width, samples + first);
+		else {  // last block
+			unpack_block(data, bit_width, block);
+			std::copy_n(block, n, samples + first);
+		}
+
+		data += block_bytes(bit_width);
+	}
+
+	if (count == 0)
+		return;
+
+	// reconstruct the first row from the left neighbour, the rest from the previous row
+	uint16_t left = 0;
+	for (size_t i = 0; i < width; ++i)
+		left = samples[i] = unzigzag(samples[i]) + left;
+
+	for (size_t r = 1; r < height; ++r)
+		reconstruct_row(samples + r*width, samples + (r-1)*width, width);
+}
+
+char const * dem_decode_kernel_name() {
+#if defined(__x86_64__)
+	return "sse2";
+#elif defined(__aarch64__)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,24 @@
+/*! \file
+Lossless 16bit elevation (DEM) codec.
+
+Samples are predicted from the sample above (the first row from the left neighbour), prediction
+residuals are zigzag mapped to unsigned values and bit packed in blocks of `dem_codec_block_size`
+residuals. Each block is stored as one byte bit width (0-16) followed by `8*bit_width` bytes of LSB
+first packed residuals (the last block is zero padded). Smooth (SRTM like) elevation data needs just a
+few bits per sample. Rows are reconstructed with SSE2 (x86-64) or NEON (aarch64) kernels. */
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t dem_codec_block_size = 64;  //!< residuals per bit packed block
+
+//! Encodes width x height (top-down rows) \c samples image.
+std::vector<std::byte> encode_dem(uint16_t const * samples, size_t width, size_t height);
+
+/*! Decodes \c data (see encode_dem()) into width x height \c samples buffer.
+\throw std::runtime_error In case of corrupted data. */
+void decode_dem(std::byte const * data, size_t size, size_t width, size_t height, uint16_t * samples);
+
+//! \returns Name of the row reconstruction kernel used by decode_dem() e.g. "sse2".
+char const * dem_decode_kernel_name();
@@ -0,0 +1,195 @@
+/* Compares DEM codec (see `dem_codec.hpp`) against TIFF elevation tiles. For each elevation tile reports
+input (as stored), deflate and LZW (both with horizontal predictor, as GDAL writes them) TIFF sizes and DEM
+codec encoded size. Decode times are all measured from memory (TIFF file content read into a buffer,
+DEM payload as read straight from a mapped tile pack file), so file I/O is not part of any result.
+Decoded tiles are checked against TIFF samples.
+
+Usage: dem_codec_bench [--repeat N] ELEVATION_TILE [ELEVATION_TILE ...] */
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fmt/core.h>
+#include <tiffio.h>
+#include "tiff.hpp"
+#include "dem_codec.hpp"
+
+using std::vector, std::string, std::size, std::byte;
+using std::filesystem::path, std::filesystem::file_size, std::filesystem::temp_directory_path;
+using std::chrono::steady_clock, std::chrono::duration;
+using std::cerr;
+using fmt::print;
+
+//! \returns Best (minimal) time of \c repeat runs in milliseconds.
+template <typename F>
+double best_time(unsigned repeat, F && f) {
+	double best = std::numeric_limits<double>::max();
+	for (unsigned i = 0; i < repeat; ++i) {
+		auto const t0 = steady_clock::now();
+		f();
+		best = std::min(best, duration<double, std::milli>{steady_clock::now() - t0}.count());
+	}
+	return best;
+}
+
+vector<byte> read_content(path const & fname) {
+	std::ifstream fin{fname, std::ios::binary};
+	if (!fin.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' file", fname.c_str())};
+
+	vector<byte> content(file_size(fname));
+	fin.read(reinterpret_cast<char *>(content.data()), size(content));
+	return content;
+}
+
+//! \returns 16bit grayscale TIFF file content with \c compression (e.g. COMPRESSION_ADOBE_DEFLATE).
+vector<byte> compressed_tiff(uint16_t const * samples, tiff_data_desc const & desc, uint16_t compression) {
+	path const fname = temp_directory_path()/"dem_codec_bench.tif";
+	TIFF * tiff = TIFFOpen(fname.c_str(), "w");
+	if (!tiff)
+		throw std::runtime_error{fmt::format("can't create '{}' file", fname.c_str())};
+
+	TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, uint32_t(desc.width));
+	TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, uint32_t(desc.height));
+	TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, uint16_t(16));
+	TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, uint16_t(1));
+	TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, uint16_t(SAMPLEFORMAT_UINT));
+	TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, uint16_t(PHOTOMETRIC_MINISBLACK));
+	TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, uint16_t(PLANARCONFIG_CONTIG));
+	TIFFSetField(tiff, TIFFTAG_COMPRESSION, compression);
+	TIFFSetField(tiff, TIFFTAG_PREDICTOR, uint16_t(PREDICTOR_HORIZONTAL));
+	TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tiff, 0));
+
+	vector<uint16_t> row(desc.width);  // libtiff modifies scanline buffer (predictor)
+	for (size_t y = 0; y < desc.height; ++y) {
+		std::copy_n(samples + y*desc.width, desc.width, row.data());
+		if (TIFFWriteScanline(tiff, row.data(), y, 0) != 1) {
+			TIFFClose(tiff);
+			throw std::runtime_error{fmt::format("unable to write '{}' file", fname.c_str())};
+		}
+	}
+	TIFFClose(tiff);
+
+	vector<byte> content = read_content(fname);
+	std::filesystem::remove(fname);
+	return content;
+}
+
+//! \returns Best TIFF \c content decode time in milliseconds, decoded samples are checked against \c expected.
+double tiff_decode_time(unsigned repeat, vector<byte> const & content, uint16_t const * expected, size_t raw_size,
+	path const & tile, char const * variant) {
+
+	double const ms = best_time(repeat, [&content]{
+		auto result = load_tiff_memory(content.data(), size(content));
+	});
+
+	auto const [pixels, desc] = load_tiff_memory(content.data(), size(content));
+	if (memcmp(pixels.get(), expected, raw_size) != 0)
+		throw std::runtime_error{fmt::format("'{}' {} TIFF round trip failed", tile.c_str(), variant)};
+
+	return ms;
+}
+
+struct codec_totals {
+	size_t bytes = 0;
+	double ms = 0.0;
+};
+
+int main(int argc, char * argv[]) {
+	unsigned repeat = 10;
+	vector<path> tiles;
+	for (int i = 1; i < argc; ++i) {
+		string const arg = argv[i];
+		if (arg == "--repeat" && i+1 < argc)
+			repeat = std::max(std::stoul(argv[++i]), 1ul);
+		else
+			tiles.push_back(arg);
+	}
+
+	if (empty(tiles)) {
+		cerr << "usage: dem_codec_bench [--repeat N] ELEVATION_TILE [ELEVATION_TILE ...]\n";
+		return 1;
+	}
+
+	TIFFSetWarningHandler(nullptr);  // e.g. unknown GeoTIFF tags
+
+	print("{:<32} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12}\n", "tile", "raw [B]",
+		"input [B]", "deflate [B]", "lzw [B]", "dem [B]", "input [ms]", "deflate [ms]", "lzw [ms]", "dem [ms]");
+
+	size_t total_raw = 0;
+	codec_totals tiff_total, deflate_total, lzw_total, dem_total;
+
+	try {
+		for (path const & tile : tiles) {
+			auto const [pixels, desc] = load_tiff_desc(tile);
+			if (desc.bytes_per_sample != 2 || !is_grayscale(desc)) {
+				cerr << fmt::format("'{}' skipped, 16bit grayscale elevation tile expected\n", tile.c_str());
+				continue;
+			}
+
+			size_t const raw_size = desc.width*desc.height*sizeof(uint16_t);
+			uint16_t const * samples = reinterpret_cast<uint16_t const *>(pixels.get());
+
+			// TIFF variants, all decoded from memory
+			vector<byte> const tiff = read_content(tile),
+				deflate = compressed_tiff(samples, desc, COMPRESSION_ADOBE_DEFLATE),
+				lzw = compressed_tiff(samples, desc, COMPRESSION_LZW);
+
+			double const tiff_ms = tiff_decode_time(repeat, tiff, samples, raw_size, tile, "uncompressed"),
+				deflate_ms = tiff_decode_time(repeat, deflate, samples, raw_size, tile, "deflate"),
+				lzw_ms = tiff_decode_time(repeat, lzw, samples, raw_size, tile, "LZW");
+
+			vector<byte> const encoded = encode_dem(samples, desc.width, desc.height);
+
+			vector<uint16_t> decoded(desc.width*desc.height);
+			double const dem_ms = best_time(repeat, [&]{
+				decode_dem(encoded.data(), size(encoded), desc.width, desc.height, decoded.data());
+			});
+
+			if (memcmp(decoded.data(), samples, raw_size) != 0)
+				throw std::runtime_error{fmt::format("'{}' DEM codec round trip failed", tile.c_str())};
+
+			print("{:<32} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12.3f} {:>12.3f} {:>12.3f} {:>12.3f}\n",
+				tile.filename().c_str(), raw_size, size(tiff), size(deflate), size(lzw), size(encoded),
+				tiff_ms, deflate_ms, lzw_ms, dem_ms);
+
+			total_raw += raw_size;
+			tiff_total.bytes += size(tiff);
+			tiff_total.ms += tiff_ms;
+			deflate_total.bytes += size(deflate);
+			deflate_total.ms += deflate_ms;
+			lzw_total.bytes += size(lzw);
+			lzw_total.ms += lzw_ms;
+			dem_total.bytes += size(encoded);
+			dem_total.ms += dem_ms;
+		}
+	}
+	catch (std::exception const & e) {
+		cerr << e.what() << "\n";
+		return 1;
+	}
+
+	if (dem_total.bytes == 0)
+		return 1;
+
+	print("{:<32} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12.3f} {:>12.3f} {:>12.3f} {:>12.3f}\n", "total", total_raw,
+		tiff_total.bytes, deflate_total.bytes, lzw_total.bytes, dem_total.bytes,
+		tiff_total.ms, deflate_total.ms, lzw_total.ms, dem_total.ms);
+
+	print("\nDEM codec ({} kernel, {:.0f} MB/s decode):\n", dem_decode_kernel_name(), total_raw/(dem_total.ms*1e3));
+	auto compare = [&dem_total](char const * name, codec_totals const & t){
+		print("  vs {:<14} size ratio {:.2f} (TIFF/DEM), decode {:.2f}x faster\n", name,
+			double(t.bytes)/dem_total.bytes, t.ms/dem_total.ms);
+	};
+	compare("deflate TIFF", deflate_total);
+	compare("LZW TIFF", lzw_total);
+	compare("input TIFF", tiff_total);
+
+	return 0;
+}
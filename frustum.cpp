@@ -0,0 +1,54 @@
+#include <glm/geometric.hpp>
+#include "terrain_camera.hpp"
+#include "free_camera.hpp"
+#include "frustum.hpp"
+
+using glm::vec4, glm::vec3, glm::mat4, glm::transpose;
+
+frustum view_frustum(mat4 const & world_to_screen) {
+	mat4 const M = transpose(world_to_screen);  // M[i] is i-th row of world_to_screen
+
+	frustum f = {.planes = {
+		M[3] + M[0],  // -x (left)
+		M[3] - M[0],  // +x (right)
+		M[3] + M[1],  // -y (bottom)
+		M[3] - M[1],  // +y (top)
+		M[3] + M[2],  // -z (near)
+		M[3] - M[2]  // +z (far)
+	}};
+
+	for (vec4 & plane : f.planes)  // normalize, so distance is in world units
+		plane /= length(vec3{plane});
+
+	return f;
+}
+
+frustum view_frustum(terrain_camera const & cam, mat4 const & projection) {
+	return view_frustum(projection * cam.view());
+}
+
+frustum view_frustum(free_camera const & cam) {
+	return view_frustum(cam.projection() * cam.view());
+}
+
+containment classify(frustum const & f, geom::box3 const & box) {
+	vec3 const & lo = box.min_corner(),
+		& hi = box.max_corner();
+
+	containment result = containment::inside;
+	for (vec4 const & plane : f.planes) {
+		vec3 const n = vec3{plane};
+
+		// the most positive (p) and the most negative (n) box corner in a plane normal direction
+		vec3 const p_vertex = {n.x >= 0 ? hi.x : lo.x, n.y >= 0 ? hi.y : lo.y, n.z >= 0 ? hi.z : lo.z},
+			n_vertex = {n.x >= 0 ? lo.x : hi.x, n.y >= 0 ? lo.y : hi.y, n.z >= 0 ? lo.z : hi.z};
+
+		if (dot(n, p_vertex) + plane.w < 0)
+			return containment::outside;
+
+		if (dot(n, n_vertex) + plane.w < 0)
+			result = containment::intersects;
+	}
+
+	return result;
+}
@@ -0,0 +1,36 @@
+/*! \file
+View frustum extraction from a world to screen (projection*view) transformation and axis aligned
+box classification against the frustum (e.g. for hierarchical culling).
+\code
+frustum const view = view_frustum(cam_detail);  // or view_frustum(cam, P) for terrain_camera
+if (classify(view, bounds) == containment::outside)
+	return;  // box is not visible
+\endcode */
+#pragma once
+#include <array>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include "geometry/box3.hpp"
+
+struct terrain_camera;
+struct free_camera;
+
+//! View frustum clip planes (-x, +x, -y, +y, -z, +z) in world space, normals point inside.
+struct frustum {
+	std::array<glm::vec4, 6> planes;  //!< (normal, distance), point p is inside for dot(normal, p) + distance >= 0
+};
+
+enum class containment {
+	outside,  //!< box is fully outside of the frustum
+	intersects,  //!< box is partially inside (or test is not conclusive)
+	inside  //!< box is fully inside of the frustum
+};
+
+//! Extracts frustum planes from \c world_to_screen transformation (Gribb/Hartmann method).
+frustum view_frustum(glm::mat4 const & world_to_screen);
+frustum view_frustum(terrain_camera const & cam, glm::mat4 const & projection);
+frustum view_frustum(free_camera const & cam);
+
+/*! Classifies axis aligned box against the frustum, the test is conservative (box near a frustum
+corner can be classified as intersecting even if it is outside). */
+containment classify(frustum const & f, geom::box3 const & box);
@@ -0,0 +1,114 @@
+#include <array>
+#include <exception>
+#include <cassert>
+#include <fmt/format.h>
+#include "geotiff.hpp"
+
+using std::vector, std::string, std::array, std::size, std::empty;
+using std::filesystem::path;
+
+namespace {
+
+constexpr uint32_t TIFFTAG_MODEL_PIXEL_SCALE = 33550,
+	TIFFTAG_MODEL_TIEPOINT = 33922,
+	TIFFTAG_GEO_KEY_DIRECTORY = 34735,
+	TIFFTAG_GEO_DOUBLE_PARAMS = 34736,
+	TIFFTAG_GEO_ASCII_PARAMS = 34737;
+
+array<TIFFFieldInfo, 5> const geotiff_field_info = {{
+	{TIFFTAG_MODEL_PIXEL_SCALE, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1, const_cast<char *>("ModelPixelScaleTag")},
+	{TIFFTAG_MODEL_TIEPOINT, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1, const_cast<char *>("ModelTiepointTag")},
+	{TIFFTAG_GEO_KEY_DIRECTORY, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_SHORT, FIELD_CUSTOM, 1, 1, const_cast<char *>("GeoKeyDirectoryTag")},
+	{TIFFTAG_GEO_DOUBLE_PARAMS, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1, const_cast<char *>("GeoDoubleParamsTag")},
+	{TIFFTAG_GEO_ASCII_PARAMS, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_ASCII, FIELD_CUSTOM, 1, 0, const_cast<char *>("GeoAsciiParamsTag")}
+}};
+
+TIFFExtendProc parent_extender = nullptr;
+
+void geotiff_tag_extender(TIFF * tiff) {
+	TIFFMergeFieldInfo(tiff, geotiff_field_info.data(), size(geotiff_field_info));
+	if (parent_extender)
+		parent_extender(tiff);
+}
+
+template <typename T>
+vector<T> get_array_field(TIFF * tiff, uint32_t tag) {
+	uint16_t count = 0;
+	T * values = nullptr;
+	if (!TIFFGetField(tiff, tag, &count, &values) || !values)
+		return {};
+	return vector<T>(values, values + count);
+}
+
+template <typename T>
+void set_array_field(TIFF * tiff, uint32_t tag, vector<T> const & values) {
+	if (!empty(values))
+		TIFFSetField(tiff, tag, static_cast<uint16_t>(size(values)), values.data());
+}
+
+}  // namespace
+
+void register_geotiff_tags() {
+	// function local static is initialized only once even if called from more threads at the same time
+	[[maybe_unused]] static bool const registered = []{
+		parent_extender = TIFFSetTagExtender(geotiff_tag_extender);
+		return true;
+	}();
+}
+
+geotiff_tags read_geotiff_tags(TIFF * tiff) {
+	geotiff_tags tags = {
+		.pixel_scale = get_array_field<double>(tiff, TIFFTAG_MODEL_PIXEL_SCALE),
+		.tiepoints = get_array_field<double>(tiff, TIFFTAG_MODEL_TIEPOINT),
+		.geo_keys = get_array_field<uint16_t>(tiff, TIFFTAG_GEO_KEY_DIRECTORY),
+		.geo_doubles = get_array_field<double>(tiff, TIFFTAG_GEO_DOUBLE_PARAMS),
+		.geo_ascii = {}
+	};
+
+	char * ascii = nullptr;
+	if (TIFFGetField(tiff, TIFFTAG_GEO_ASCII_PARAMS, &ascii) && ascii)
+		tags.geo_ascii = ascii;
+
+	return tags;
+}
+
+geotiff_tags read_geotiff_tags(path const & tiff_file) {
+	register_geotiff_tags();
+
+	TIFF * tiff = TIFFOpen(tiff_file.c_str(), "r");
+	if (!tiff)
+		throw std::runtime_error{fmt::format("can't open '{}' file", tiff_file.c_str())};
+
+	geotiff_tags tags = read_geotiff_tags(tiff);
+	TIFFClose(tiff);
+	return tags;
+}
+
+void write_geotiff_tags(TIFF * tiff, geotiff_tags const & tags) {
+	set_array_field(tiff, TIFFTAG_MODEL_PIXEL_SCALE, tags.pixel_scale);
+	set_array_field(tiff, TIFFTAG_MODEL_TIEPOINT, tags.tiepoints);
+	set_array_field(tiff, TIFFTAG_GEO_KEY_DIRECTORY, tags.geo_keys);
+	set_array_field(tiff, TIFFTAG_GEO_DOUBLE_PARAMS, tags.geo_doubles);
+	if (!empty(tags.geo_ascii))
+		TIFFSetField(tiff, TIFFTAG_GEO_ASCII_PARAMS, tags.geo_ascii.c_str());
+}
+
+geotiff_tags subimage_tags(geotiff_tags const & tags, size_t x, size_t y) {
+	geotiff_tags result = tags;
+
+	// tiepoint (i, j, k, X, Y, Z) maps (i, j) raster position to (X, Y) model position
+	if (size(tags.tiepoints) == 6 && size(tags.pixel_scale) >= 2) {  // moves tiepoint to subimage origin
+		vector<double> & tp = result.tiepoints;
+		tp[3] += (double(x) - tp[0]) * tags.pixel_scale[0];
+		tp[4] -= (double(y) - tp[1]) * tags.pixel_scale[1];  // raster y axis goes against model y axis
+		tp[0] = tp[1] = 0.0;
+	}
+	else {  // just shift raster positions of all tiepoints
+		for (size_t i = 0; i + 5 < size(result.tiepoints); i += 6) {
+			result.tiepoints[i] -= double(x);
+			result.tiepoints[i+1] -= double(y);
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,30 @@
+/*! \file
+GeoTIFF (georeferencing) tags support for TIFF files.
+Dependencies: libtiff */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+#include <tiffio.h>
+
+//! GeoTIFF georeferencing tags, tags not available in a file are empty.
+struct geotiff_tags {
+	std::vector<double> pixel_scale,  //!< ModelPixelScaleTag as (sx, sy, sz)
+		tiepoints;  //!< ModelTiepointTag as (i, j, k, x, y, z) tiepoint list
+	std::vector<uint16_t> geo_keys;  //!< GeoKeyDirectoryTag
+	std::vector<double> geo_doubles;  //!< GeoDoubleParamsTag
+	std::string geo_ascii;  //!< GeoAsciiParamsTag
+};
+
+/*! Registers GeoTIFF tags in libtiff (libtiff can't write unknown tags), needs to be called before
+TIFF files are opened. Tags are registered only once, the function can be called from more threads. */
+void register_geotiff_tags();
+
+geotiff_tags read_geotiff_tags(TIFF * tiff);
+geotiff_tags read_geotiff_tags(std::filesystem::path const & tiff_file);
+void write_geotiff_tags(TIFF * tiff, geotiff_tags const & tags);
+
+/*! \returns Tags for a subimage (e.g. tile) of the image starting at (x, y) pixel position. */
+geotiff_tags subimage_tags(geotiff_tags const & tags, size_t x, size_t y);
@@ -0,0 +1,164 @@
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <spdlog/spdlog.h>
+#include "gl_upload_thread.hpp"
+
+using std::lock_guard, std::unique_lock;
+using std::function, std::stop_token;
+using std::string;
+
+gl_upload_thread::gl_upload_thread(SDL_Window * window, SDL_GLContext render_context) {
+	// upload context gets its own (hidden) surface, a surface can not be current in two threads
+	_window = SDL_CreateWindow("upload thread", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1, 1,
+		SDL_WINDOW_OPENGL|SDL_WINDOW_HIDDEN);
+	if (!_window) {
+		spdlog::warn("unable to create upload thread window ({}), uploads are done by render thread", SDL_GetError());
+		return;
+	}
+
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	_context = SDL_GL_CreateContext(_window);  // note: makes the new context current
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+	SDL_GL_MakeCurrent(window, render_context);
+
+	if (!_context) {
+		spdlog::warn("unable to create shared OpenGL context ({}), uploads are done by render thread", SDL_GetError());
+		SDL_DestroyWindow(_window);
+		_window = nullptr;
+		return;
+	}
+
+	std::promise<bool> current;  // upload context made current by upload thread
+	std::future<bool> made_current = current.get_future();
+	_thread = std::jthread{[this, current = std::move(current)](stop_token stop) mutable {
+		bool const ok = SDL_GL_MakeCurrent(_window, _context) == 0;
+		current.set_value(ok);
+		if (ok)
+			upload_loop(stop);
+	}};
+
+	if (!made_current.get()) {
+		spdlog::warn("unable to make shared OpenGL context current ({}), uploads are done by render thread", SDL_GetError());
+		_thread.join();
+		SDL_GL_DeleteContext(_context);
+		_context = nullptr;
+		SDL_DestroyWindow(_window);
+		_window = nullptr;
+	}
+}
+
+gl_upload_thread::~gl_upload_thread() {
+	cancel();
+
+	if (_thread.joinable()) {
+		_thread.request_stop();
+		_thread.join();
+	}
+
+	if (_context)
+		SDL_GL_DeleteContext(_context);
+
+	if (_window)
+		SDL_DestroyWindow(_window);
+}
+
+void gl_upload_thread::post(function<void()> upload, function<void(string const &)> ready, function<void()> discard) {
+	job j{.upload=std::move(upload), .ready=std::move(ready), .discard=std::move(discard)};
+
+	if (!running()) {  // synchronous upload
+		run(j);
+		j.ready(j.error);
+		return;
+	}
+
+	{
+		lock_guard lock{_mutex};
+		_jobs.push_back(std::move(j));
+	}
+	_job_ready.notify_one();
+}
+
+void gl_upload_thread::cancel() {
+	std::deque<job> finished;
+	{
+		unique_lock lock{_mutex};
+		_jobs.clear();  // not yet uploaded
+		_job_done.wait(lock, [this]{return !_uploading;});
+		finished.swap(_finished);
+	}
+
+	for (job & j : finished) {  // uploaded, release uploaded objects
+		glDeleteSync(j.fence);
+		if (j.discard)
+			j.discard();
+	}
+}
+
+size_t gl_upload_thread::poll() {
+	size_t count = 0;
+	while (true) {
+		job finished;
+		{
+			lock_guard lock{_mutex};
+			if (empty(_finished))
+				break;
+
+			// jobs are finished in order so it is enough to check the first one
+			GLenum const status = glClientWaitSync(_finished.front().fence, 0, 0);  // no wait
+			if (status == GL_TIMEOUT_EXPIRED)
+				break;
+
+			finished = std::move(_finished.front());
+			_finished.pop_front();
+		}
+
+		glDeleteSync(finished.fence);
+		finished.ready(finished.error);  // out of the lock, ready can post next job
+		++count;
+	}
+	return count;
+}
+
+size_t gl_upload_thread::pending() const {
+	lock_guard lock{_mutex};
+	return std::size(_jobs) + std::size(_finished) + (_uploading ? 1 : 0);
+}
+
+void gl_upload_thread::upload_loop(stop_token stop) {
+	while (true) {
+		job j;
+		{
+			unique_lock lock{_mutex};
+			if (!_job_ready.wait(lock, stop, [this]{return !empty(_jobs);}))
+				break;  // stop requested
+
+			j = std::move(_jobs.front());
+			_jobs.pop_front();
+			_uploading = true;
+		}
+
+		run(j);
+		j.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();  // fence needs to be flushed to be signaled for the render thread
+
+		{
+			lock_guard lock{_mutex};
+			_finished.push_back(std::move(j));
+			_uploading = false;
+		}
+		_job_done.notify_all();
+	}
+
+	SDL_GL_MakeCurrent(_window, nullptr);
+}
+
+void gl_upload_thread::run(job & j) {
+	try {
+		j.upload();
+	}
+	catch (std::exception const & e) {
+		j.error = e.what();
+	}
+}
@@ -0,0 +1,80 @@
+/*! \file
+OpenGL upload thread with its own (shared) OpenGL context. Upload jobs (texture and buffer creation)
+run in the upload thread, the render thread is notified about finished jobs only after GPU completed
+the job commands (fence), so the render loop only binds ready objects.
+\note Shared contexts share textures, buffers, shaders and programs, but not container objects
+(vertex arrays, framebuffers), these needs to be created in the render thread (e.g. in `ready`).
+\note Upload context is bound to its own hidden window, one window surface can not be current in two
+threads (e.g. EGL_BAD_ACCESS with EGL).
+\code
+gl_upload_thread uploader{window, context};
+uploader.post(
+	[pixels, desc, &texture]{texture = create_texture_16b(pixels, desc, row_order::top_down);},  // upload thread
+	[&texture](std::string const & error){use(texture);},  // render thread, called by poll()
+	[&texture]{glDeleteTextures(1, &texture);});  // render thread, job dropped by cancel()
+// ...
+uploader.poll();  // once per frame in the render thread
+\endcode */
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <SDL.h>
+#include <GLES3/gl32.h>
+
+class gl_upload_thread {
+public:
+	/*! Creates upload thread OpenGL context shared with \c render_context, needs to be called from the
+	render thread with current \c render_context. In case shared context can not be created (or made
+	current in the upload thread), jobs are executed synchronously by post() (see running()). */
+	gl_upload_thread(SDL_Window * window, SDL_GLContext render_context);
+	~gl_upload_thread();  //!< Not finished jobs are dropped (see cancel()), needs to be called from the render thread.
+
+	gl_upload_thread(gl_upload_thread const &) = delete;
+	gl_upload_thread & operator=(gl_upload_thread const &) = delete;
+
+	/*! Queues \c upload job for the upload thread, \c ready is called by poll() from the render thread
+	after GPU finished upload job commands. In case \c upload throws, \c ready is called with the exception
+	message as \c error (objects created by the failed upload needs to be released by \c ready).
+	\param discard Called from the render thread instead of \c ready for uploaded jobs dropped by cancel()
+	to release uploaded objects (e.g. delete textures). */
+	void post(std::function<void()> upload, std::function<void(std::string const & error)> ready,
+		std::function<void()> discard = nullptr);
+
+	/*! Drops all posted jobs (waits for the running one), not yet uploaded jobs are dropped without any call
+	and \c discard is called for uploaded ones. Needs to be called from the render thread before objects
+	used by upload jobs are released (e.g. mapped tile pack payloads or texture arrays). */
+	void cancel();
+
+	/*! Calls ready functions of finished jobs (never waits), needs to be called from the render thread.
+	\returns Number of finished jobs. */
+	size_t poll();
+
+	[[nodiscard]] bool running() const {return _context != nullptr;}  //!< \returns False in case of synchronous upload.
+	[[nodiscard]] size_t pending() const;  //!< \returns Number of not finished jobs.
+
+private:
+	struct job {
+		std::function<void()> upload;
+		std::function<void(std::string const &)> ready;
+		std::function<void()> discard;
+		std::string error = {};  //!< upload exception message
+		GLsync fence = nullptr;
+	};
+
+	void upload_loop(std::stop_token stop);
+	static void run(job & j);  //!< Runs upload function, exception is stored as job error.
+
+	SDL_Window * _window = nullptr;  //!< hidden upload thread window
+	SDL_GLContext _context = nullptr;  //!< upload thread context
+	mutable std::mutex _mutex;
+	std::condition_variable_any _job_ready,
+		_job_done;
+	bool _uploading = false;  //!< upload thread runs a job (out of the lock)
+	std::deque<job> _jobs,
+		_finished;  //!< jobs with fence, waiting for GPU
+	std::jthread _thread;  //!< \note needs to be the last member (joined first)
+};
@@ -1,5 +1,8 @@
 /* OpenGL ES 3.2, terrain with heights from height map texture and proper scaling.
 Usage: terrain_quad [DEM_FILE]
+--upload-thread (after dataset and overview arguments): tile textures are created by an upload thread with shared OpenGL context
+--texture-arrays: tiles are stored as layers of shared texture arrays, uniforms are uploaded as uniform buffers
+--instanced: whole grid is drawn by one instanced draw call per pass (implies --texture-arrays)
 o: show/hide outline
 c: reset view
 p: set camera to predefined position (so we can compare render result)
@@ -13,12 +16,14 @@ f: map/free camera switch, move camera with "wsad" keys
 	a: go left
 	d: go right
 i: print transformations info */
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <tuple>
 #include <utility>
@@ -41,6 +46,7 @@ i: print transformations info */
 #include "color.hpp"
 #include "free_camera.hpp"
 #include "texture.hpp"
+#include "gl_upload_thread.hpp"
 #include "shader.hpp"
 #include "io.hpp"
 #include "terrain_scale_ui.hpp"
@@ -51,9 +57,11 @@ i: print transformations info */
 #include "above_terrain_outline_shader_program.hpp"
 #include "grid_of_terrains_lightdir_shader_program.hpp"
 #include "terrain_grid.hpp"
+#include "terrain_instance_buffer.hpp"
+#include "terrain_uniform_buffers.hpp"
 #include "terrain_camera.hpp"
 
-using std::vector, std::string, std::pair, std::byte, std::size;
+using std::vector, std::string, std::string_view, std::pair, std::byte, std::size;
 using std::tuple, std::get;
 using std::unique_ptr;
 using std::filesystem::path, std::filesystem::exists;
@@ -80,6 +88,7 @@ constexpr float TERRAIN_HEIGHT_SCALE = 10.0f;
 
 constexpr unsigned DEFAULT_QUAD_RESOLOTION = 100;  // for 100x100 vertices quad
 
+
 path const LIGHTDIR_VERTEX_SHADER_FILE = "height_map_lightdir.vs",
 	LIGHTDIR_GEOMETRY_SHADER_FILE = "to_line.gs",
 	LIGHTDIR_FRAGMENT_SHADER_FILE = "colored.fs";
@@ -147,6 +156,7 @@ void draw_terrain(height_overlap_shader_program & shader,
 	unsigned int element_count,  // number of quad mesh triengle elements to draw
 	mat4 const & local_to_screen,
 	size_t elevation_width, size_t elevation_height,
+	float terrain_size,  //!< terrain size in meters
 	float height_scale, float elevation_scale,
 	render_features const & features);
 
@@ -168,6 +178,20 @@ void draw_terrain_light_directions(grid_of_terrains_lightdir_shader_program & sh
 	float elevation_scale,
 	mat4 local_to_screen);
 
+/*! Draws \c count visible terrains with \c shader texture array program variant, terrain texture
+arrays and terrain uniform blocks are expected to be updated and bound. Instanced variant draws all
+terrains by one draw call (see `terrain_instance_buffer.hpp`), texture array variant binds terrain
+block range for each draw (see `terrain_uniform_buffers.hpp`). */
+template <typename Shader>
+void draw_visible_terrains(Shader & shader, terrain_uniform_buffers const & blocks,
+	GLsizei count,
+	unsigned int element_count,  // number of quad mesh triengle elements to draw
+	bool instanced);
+
+/*! \returns False in case terrain quad box ([0,1]^2 quad with elevations up to `height`) is outside of
+the view frustum. The test is conservative, box is outside if all box corners are outside of one clip plane. */
+bool is_in_view(mat4 const & local_to_screen, float height);
+
 
 // three lines
 constexpr float axis_verts[] = {
@@ -197,6 +221,17 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 
 	// process arguments
 	string const title = string{path{argv[0]}.stem()} + " (OpenGL ES 3.2)"s;
+	path const tiles_path = (argc > 1) ? path{argv[1]} : data_path;  // dataset directory or tile pack file
+	unsigned const tiles_overview = (argc > 2) ? std::stoul(argv[2]) : 0;  // e.g. 2 to load 1/16 size tiles
+	auto has_option = [argc, argv](string_view option){  // options after dataset and overview arguments
+		return std::find(argv + std::min(argc, 3), argv + argc, option) != argv + argc;
+	};
+	bool const use_upload_thread = has_option("--upload-thread"),
+		use_instancing = has_option("--instanced"),
+		use_texture_arrays = use_instancing || has_option("--texture-arrays");
+
+	terrain_shader_variant const shader_variant = use_instancing ? terrain_shader_variant::instanced
+		: use_texture_arrays ? terrain_shader_variant::texture_array : terrain_shader_variant::textures;
 
 	SDL_Init(SDL_INIT_VIDEO);
 	SDL_Window * window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED,
@@ -212,6 +247,11 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 		<< "GL_VERSION: " << glGetString(GL_VERSION) << "\n"
 		<< "GL_RENDERER: " << glGetString(GL_RENDERER) << "\n"
 		<< "GLSL_VERSION: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+
+	// upload thread needs to be created with current context and needs to outlive terrains
+	std::unique_ptr<gl_upload_thread> uploader;
+	if (use_upload_thread)
+		uploader = std::make_unique<gl_upload_thread>(window, context);
 	
 	terrain_scale_ui ui;
 	ui.height_scale = TERRAIN_HEIGHT_SCALE;
@@ -225,16 +265,30 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
 
-	height_overlap_shader_program shader;
+	height_overlap_shader_program shader{shader_variant};
 
 	// load shader program to visualize light direction
-	grid_of_terrains_lightdir_shader_program lightdir_shader;
+	grid_of_terrains_lightdir_shader_program lightdir_shader{shader_variant};
 	assert(shader.position_location() == lightdir_shader.position_location() && "we expect the same position attribute locations (=0)");
 
 	// load shader program for wirefraame rendering
-	above_terrain_outline_shader_program outline_shader;
+	above_terrain_outline_shader_program outline_shader{shader_variant};
 	assert(shader.position_location() == outline_shader.position_location() && "we expect the same position attribute locations (=0)");
 
+	if (use_texture_arrays) {  // sampler units and colors never change, per frame data are in uniform blocks
+		shader.use();
+		shader.heights(0);  // elevation texture array is bound to texture unit 0
+		shader.satellite_map(1);  // satellite texture array is bound to texture unit 1
+
+		lightdir_shader.use();
+		lightdir_shader.elevation_map(0);
+		lightdir_shader.fill_color(rgb::yellow);
+
+		outline_shader.use();
+		outline_shader.elevation_map(0);
+		outline_shader.fill_color(rgb::blue);
+	}
+
 	string const flat_vs = read_file("flat_shader.vs"),
 		flat_fs = read_file("flat_shader.fs");
 	GLuint const flat_shader_program_id = get_shader_program(flat_vs.c_str(), flat_fs.c_str());
@@ -252,6 +306,14 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 	constexpr float quad_size = 1.0f;
 	auto [vao, vbo, ibo, element_count] = create_quad_mesh(shader.position_location(), ui.quad_resolution);
 
+	// visible terrains instance data (instanced rendering)
+	terrain_instance_buffer instances;
+	instances.attach(vao);
+	vector<terrain_instance> visible_terrains;
+
+	// per frame and per terrain uniform blocks (texture array shader variants)
+	terrain_uniform_buffers terrain_blocks;
+
 	// camera related stuff
 	terrain_camera cam{20.0f};
 	cam.look_at = vec2{0, 0};
@@ -274,8 +336,11 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 
 	// create grid of terrains (load textures, ...)
 	terrain_grid terrains;
-	terrains.load_tiles(data_path);
-	spdlog::info("we have {} terrains loaded", terrains.size());
+	terrains.overview = tiles_overview;
+	terrains.upload_thread = uploader.get();
+	terrains.texture_arrays = use_texture_arrays;
+	terrains.load_tiles(tiles_path);  // visible terrain tiles are loaded in background and uploaded in the loop
+	spdlog::info("we have {} terrains", terrains.size());
 
 	auto t_prev = steady_clock::now();
 
@@ -284,6 +349,8 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 	terrain const * camera_terrain = nullptr;
 
 	while (true) {  // the loop
+		terrains.upload_loaded_tiles();  // bounded upload, terrains become renderable as they arrive
+
 		// compute dt
 		auto t_now = steady_clock::now();
 		float const dt = duration_cast<milliseconds>(t_now - t_prev).count() / 1000.0f;
@@ -323,6 +390,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 			assert(ui.quad_resolution > 1);
 			destroy_quad_mesh(vao, vbo, ibo);
 			std::tie(vao, vbo, ibo, element_count) = create_quad_mesh(shader.position_location(), ui.quad_resolution);
+			instances.attach(vao);
 			quad_resolution = ui.quad_resolution;
 		}
 
@@ -343,9 +411,20 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 			for (terrain const & t : terrains.iterate())
 				cout << "(" <<  t.grid_c << "," << t.grid_r << ") -> " << t.position * model_scale << " ";
 			cout << "\n";
-		}
 
-		assert(size(terrains) > 0 && "we expect at least one terrain to render something");
+			cout << "terrain residency: " << terrains.resident_count() << "/" << terrains.size() << " terrains, "
+				<< terrains.resident_bytes() << "B/" << terrains.gpu_budget << "B";
+			if (terrains.texture_arrays)
+				cout << ", " << terrains.used_layers() << " texture array layers used";
+			cout << "\n";
+
+			cout << "upload queue: " << terrains.upload_queue_depth() << " textures, " << terrains.loading()
+				<< " terrains loading\n";
+
+			tile_cache::statistics const cache = terrains.cache_stats();
+			cout << "tile_cache: hits=" << cache.hits << ", misses=" << cache.misses << ", evictions=" << cache.evictions
+				<< ", size=" << cache.size << "B (" << cache.count << " images)\n";
+		}
 
 		int const texture_width = terrains.elevation_tile_size(),  //= 716
 			texture_height = terrains.elevation_tile_size();  //!< we should introduce texture_size
@@ -367,17 +446,54 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 			prev_cam_pos = cam.position();
 		}
 
+		if (terrains.texture_arrays) {  // all terrain textures are layers of two texture arrays, bind them once per frame
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, terrains.elevation_array());
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, terrains.satellite_array());
+
+			// all per frame uniforms are uploaded once, instead of setting them for each terrain and pass
+			assert(texture_width == texture_height && "we expect square elevation tiles");
+			terrain_blocks.update_frame(terrain_frame_uniforms{
+				.world_to_screen = P*V,
+				.light_direction = vec4{0, 0, 1, 0},
+				.elevation_scale = elevation_scale,
+				.height_scale = ui.height_scale,
+				.terrain_size = float(terrains.elevation_pixel_size() * texture_width),
+				.elevation_tile_size = float(texture_width),
+				.normal_tile_size = float(texture_width - 2*elevation_tile_border),  // no normals for border pixels
+				.use_satellite_map = features.show_satellite,
+				.use_shading = features.calculate_shades,
+				.top_down_rows = true  // terrain grid textures are not flipped while uploaded
+			});
+		}
+
+		visible_terrains.clear();
+
 		// TODO: we want to implement terrrain_grid_draw() to draw grid
 		for (terrain const & t : terrains.iterate()) {  // draw terrain grid
 			vec2 const model_pos = t.position * model_scale;
 			mat4 const M = scale(translate(mat4{1}, vec3{model_pos,0}), vec3{model_scale, model_scale, 1});  // T*S
 			mat4 const local_to_screen = P*V*M;
 
+			if (!is_in_view(local_to_screen, t.elevation_min * elevation_scale * ui.height_scale))
+				continue;
+
+			terrains.mark_visible(t);  // requests not resident terrain tiles
+			if (!t.resident())
+				continue;  // not yet loaded
+
+			if (terrains.texture_arrays) {  // drawn after the loop
+				visible_terrains.push_back(terrain_instance{.offset=model_pos, .scale=model_scale, .layer=float(t.layer)});
+				continue;
+			}
+
 			if (features.show_terrain) {  // render terrain
 				draw_terrain(shader, t,
 					element_count,
 					local_to_screen,
 					texture_width, texture_height,
+					terrains.elevation_pixel_size() * texture_width,
 					ui.height_scale, elevation_scale, features);
 			}
 
@@ -396,6 +512,25 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 			}
 		}  // for (t ...
 
+		if (terrains.texture_arrays && !empty(visible_terrains)) {  // terrains with uniform blocks
+			GLsizei const count = static_cast<GLsizei>(size(visible_terrains));
+			if (use_instancing)
+				instances.update(visible_terrains);  // one draw call per pass for all visible terrains
+			else
+				terrain_blocks.update_tiles(visible_terrains);  // one block range bind per terrain draw
+
+			if (features.show_terrain)
+				draw_visible_terrains(shader, terrain_blocks, count, element_count, use_instancing);
+
+			if (features.show_lightdir)
+				draw_visible_terrains(lightdir_shader, terrain_blocks, count, element_count, use_instancing);
+
+			if (features.show_outline)
+				draw_visible_terrains(outline_shader, terrain_blocks, count, element_count, use_instancing);
+		}
+
+		terrains.update_residency();  // evicts least recently visible terrains over GPU memory budget
+
 		glBindVertexArray(0);  // unbind VAO
 
 		// render axis
@@ -432,6 +567,7 @@ void draw_terrain(height_overlap_shader_program & shader,
 	unsigned int element_count,  // number of quad mesh triengle elements to draw
 	mat4 const & local_to_screen,
 	size_t elevation_width, size_t elevation_height,  // TODO: we only need size not w and h
+	float terrain_size,
 	float height_scale, float elevation_scale,
 	render_features const & features) {
 
@@ -456,13 +592,12 @@ void draw_terrain(height_overlap_shader_program & shader,
 	else
 		shader.use_shading(false);
 
-	constexpr float elevation_tile_pixel_size = 26.063200588611451;  // see gdalinfo
-
 	assert(elevation_width == elevation_height && "we expect square elevation tiles");
-	shader.terrain_size(elevation_width * elevation_tile_pixel_size);
+	shader.terrain_size(terrain_size);
 	shader.elevation_tile_size(elevation_width);
-	shader.normal_tile_size(elevation_width - 4);  // 2px border
+	shader.normal_tile_size(elevation_width - 2*elevation_tile_border);  // no normals for border pixels
 	shader.height_scale(height_scale);
+	shader.top_down_rows(true);  // terrain grid textures are not flipped while uploaded
 	shader.elevation_scale(elevation_scale);
 	shader.local_to_screen(local_to_screen);
 
@@ -489,6 +624,7 @@ void draw_terrain_outlines(above_terrain_outline_shader_program & shader,
 
 	shader.elevation_scale(elevation_scale);
 	shader.height_scale(height_scale);
+	shader.top_down_rows(true);  // terrain grid textures are not flipped while uploaded
 	shader.local_to_screen(local_to_screen);
 
 	glDrawElements(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0);
@@ -511,12 +647,32 @@ void draw_terrain_light_directions(grid_of_terrains_lightdir_shader_program & sh
 
 	shader.elevation_scale(elevation_scale);
 	shader.height_scale(height_scale);
+	shader.top_down_rows(true);  // terrain grid textures are not flipped while uploaded
 	shader.local_to_screen(local_to_screen);
 
 	glDrawElements(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0);
 }
 
 
+template <typename Shader>
+void draw_visible_terrains(Shader & shader, terrain_uniform_buffers const & blocks,
+	GLsizei count,
+	unsigned int element_count,
+	bool instanced) {
+
+	shader.use();
+
+	if (instanced) {
+		glDrawElementsInstanced(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0, count);
+		return;
+	}
+
+	for (GLsizei i = 0; i < count; ++i) {
+		blocks.bind_tile(i);
+		glDrawElements(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0);
+	}
+}
+
 // handling render features
 void input_render_features(SDL_Event const & event, render_features & features) {
 	if (event.type == SDL_KEYDOWN) {
@@ -750,3 +906,18 @@ void verbose_signal_handler(int signal) {
 
 	exit(signal);
 }
+
+bool is_in_view(mat4 const & local_to_screen, float height) {
+	int outside[6] = {};  // number of box corners outside of -x, +x, -y, +y, -z and +z clip plane
+	for (int i = 0; i < 8; ++i) {
+		vec4 const p = local_to_screen * vec4{float(i & 1), float((i >> 1) & 1), (i & 4) ? height : 0.0f, 1.0f};
+		outside[0] += p.x < -p.w;
+		outside[1] += p.x > p.w;
+		outside[2] += p.y < -p.w;
+		outside[3] += p.y > p.w;
+		outside[4] += p.z < -p.w;
+		outside[5] += p.z > p.w;
+	}
+
+	return std::ranges::none_of(outside, [](int n){return n == 8;});
+}
@@ -4,20 +4,60 @@
 
 precision mediump usampler2D;
 
+#ifdef VERTEX_PULLING  // no vertex attributes, position is calculated from vertex index (see main)
+uniform int quad_resolution;  // NxN quad mesh vertices
+vec3 position;
+#else
 layout(location = 0) in vec3 position;  // expected to be in a range of [0,1]^2 square
+#endif
 out vec3 d;  // direction output for geometry shader
 
+#ifdef TEXTURE_ARRAY  // terrain tiles stored as texture array layers
+precision mediump usampler2DArray;
+uniform usampler2DArray heights;  // 16bit UI height texture array [0, 65535]
+#ifdef INSTANCED  // instance (offset.x, offset.y, scale, texture array layer), otherwise tile from terrain_tile block
+layout(location = 1) in highp vec4 tile;
+#endif
+#define HEIGHT(uv) texture(heights, vec3(uv, tile.w))
+#else
 uniform usampler2D heights;  // 16bit UI height texture [0, 65535]
+#define HEIGHT(uv) texture(heights, uv)
+#endif
+
+#ifndef UNIFORM_BLOCKS  // otherwise uniforms in terrain uniform blocks
 uniform float elevation_scale;  // terrain elevation scale factor calculated from elevation pixel resolution (e.g. = 0.000107174)
 uniform float height_scale;  // e.g. 1 for PNG files or 100 for TIFF (elevation) files
+uniform bool top_down_rows;  // textures stored with the first image row at t=0 (not flipped while uploaded)
+#endif
 
+#ifdef UNIFORM_BLOCKS
+#define LIGHT_DIRECTION light_direction.xyz  // shading light direction from terrain_frame block
+#else
 const vec3 light_direction = vec3(0.86, 0.14, 0.49);  // TODO: Is this in word coordinate system?
+#define LIGHT_DIRECTION light_direction
+#endif
+
+// elevation texture coordinate, top-down rows are flipped in texel space to read the same texel as bottom-up rows
+vec2 elevation_uv(vec2 p) {
+	if (!top_down_rows)
+		return p;
+	float rows = float(textureSize(heights, 0).y);
+	return vec2(p.x, 1.0 - (floor(p.y * rows) + 0.5) / rows);
+}
 
 void main() {
-	d = light_direction;  // pass light direction to a geometry shader
+#ifdef VERTEX_PULLING
+	position = vec3(gl_VertexID % quad_resolution, gl_VertexID / quad_resolution, 0) / float(quad_resolution - 1);
+#endif
+	d = LIGHT_DIRECTION;  // pass light direction to a geometry shader
 
    // read h value from height map
-	float h = float(texture(heights, position.xy).r) * elevation_scale * height_scale;
+	vec2 uv = elevation_uv(position.xy);
+	float h = float(HEIGHT(uv).r) * elevation_scale * height_scale;
 
+#ifdef UNIFORM_BLOCKS
+	gl_Position = vec4(tile.xy + position.xy * tile.z, h, 1);  // position in a world coordinate system
+#else
 	gl_Position = vec4(position.xy, h, 1);  // position in a local coordinate system
+#endif
 }
@@ -3,11 +3,13 @@
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <GLES3/gl32.h>
+#include "terrain_shader_variant.hpp"
 
 /* TODO: there are four shader program implementations there flat_shader_program, ...
 we should think to reuse common code. */
 struct grid_of_terrains_lightdir_shader_program {
-	grid_of_terrains_lightdir_shader_program();
+	//! \param variant Program variant, e.g. for terrain tiles stored as texture array layers (see terrain_uniform_buffers).
+	explicit grid_of_terrains_lightdir_shader_program(terrain_shader_variant variant = terrain_shader_variant::textures);
 	~grid_of_terrains_lightdir_shader_program();
 	void use() const;
 	void local_to_screen(glm::mat4 const & T);
@@ -15,6 +17,8 @@ struct grid_of_terrains_lightdir_shader_program {
 	void elevation_scale(float scale);
 	void height_scale(float scale);  // TODO: what is difference between elevation_sace and height_sacel?
 	void fill_color(glm::vec3 const & color);
+	void top_down_rows(bool value);  //!< Elevation texture is stored with the first image row at t=0.
+	void quad_resolution(int n);  //!< Quad mesh (NxN) resolution for terrain_shader_variant::vertex_pulling variant.
 	GLint position_location() const;
 
 private:
@@ -24,5 +28,7 @@ private:
 		_elevation_scale,
 		_height_scale,
 		_local_to_screen,
-		_fill_color;
+		_fill_color,
+		_top_down_rows,
+		_quad_resolution;
 };
@@ -6,20 +6,47 @@ precision mediump float;
 precision mediump sampler2D;
 precision mediump usampler2D;  // TODO: there is also `highp` (32bit float) precision there
 
+#ifdef TEXTURE_ARRAY  // terrain tiles stored as texture array layers
+precision mediump sampler2DArray;
+precision mediump usampler2DArray;
+uniform usampler2DArray heights;  // 16bit INT height texture array
+uniform sampler2DArray satellite_map;  // 8bit UINT texture array
+#ifdef INSTANCED
+flat in highp int tile_layer;  // instance texture array layer
+#define LAYER float(tile_layer)
+#else
+#define LAYER tile.w
+#endif
+#define HEIGHT(uv) texture(heights, vec3(uv, LAYER))
+#define SATELLITE(uv) texture(satellite_map, vec3(uv, LAYER))
+#else
 uniform usampler2D heights;  // 16bit INT height texture
 uniform sampler2D satellite_map;  // 8bit UINT texture
+#define HEIGHT(uv) texture(heights, uv)
+#define SATELLITE(uv) texture(satellite_map, uv)
+#endif
 
+#ifdef UNIFORM_BLOCKS  // uniforms in terrain uniform blocks
+#define LIGHT_DIRECTION light_direction.xyz
+#else
 uniform bool use_satellite_map;
 uniform bool use_shading;
 uniform float elevation_tile_size;  // size of elevation tile in px (e.g. 734)
 uniform float terrain_size;  // terrain saze in real world units e.g. meters
 uniform float normal_tile_size;  // size of normal tile in px (e.g. 730)
-
-in vec2 st;  // normal texture coordinate in pixels [0, S_normal_size]^2
-out vec4 frag_color;
+uniform bool top_down_rows;  // textures stored with the first image row at t=0 (not flipped while uploaded)
 
 //const vec3 light_direction = vec3(0.86, 0.14, 0.49);
 const vec3 light_direction = vec3(0.0, 0.0, 1.0);
+#define LIGHT_DIRECTION light_direction
+#endif
+
+#ifdef NORMAL_MAP
+uniform sampler2D normal_map;  // RG8_SNORM octahedral encoded normals baked while tile loaded (see normal_map.hpp)
+#endif
+
+in vec2 st;  // normal texture coordinate in pixels [0, S_normal_size]^2
+out vec4 frag_color;
 
 const vec2 terrain_offset = vec2(0.0, 0.0);
 
@@ -29,8 +56,22 @@ vec3 to_word(vec2 uv_p, float h) {
 	return vec3(terrain_offset.xy + uv * terrain_size, h);
 }
 
-vec3 calculate_normal(vec2 st, usampler2D heights) {
-	vec2 elevation_tile_offset = vec2((2.0 + 0.25)/elevation_tile_size, (2.0 + 0.25)/elevation_tile_size);
+#ifdef NORMAL_MAP
+vec3 octahedral_decode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+// single fetch, normal map texel matches normal tile pixel
+vec3 calculate_normal(vec2 st) {
+	ivec2 texel = clamp(ivec2(st), ivec2(0), textureSize(normal_map, 0) - 1);
+	return octahedral_decode(texelFetch(normal_map, texel, 0).rg);
+}
+#else
+vec3 calculate_normal(vec2 st) {
+	vec2 elevation_tile_offset = vec2((2.0 + 0.25)/elevation_tile_size, (2.0 + 0.25)/elevation_tile_size);  // 2px border (see elevation_tile_border)
 
 	// calculate heights of neighboring points
 	vec2 left = (st + vec2(-1.0, 0.0))/elevation_tile_size + elevation_tile_offset.xy;
@@ -38,10 +79,10 @@ vec3 calculate_normal(vec2 st, usampler2D heights) {
 	vec2 up = (st + vec2(0.0, -1.0))/elevation_tile_size + elevation_tile_offset.xy;
 	vec2 down = (st + vec2(0.0, 1.0))/elevation_tile_size + elevation_tile_offset.xy;
 
-	float height_left = float(texture(heights, left).r);
-	float height_right = float(texture(heights, right).r);
-	float height_up = float(texture(heights, up).r);
-	float height_down = float(texture(heights, down).r);
+	float height_left = float(HEIGHT(left).r);
+	float height_right = float(HEIGHT(right).r);
+	float height_up = float(HEIGHT(up).r);
+	float height_down = float(HEIGHT(down).r);
 
    // calculate uv point normal from neighbort points
 	vec3 p0 = to_word(st + vec2(-1.0, 0.0), height_left);
@@ -53,18 +94,23 @@ vec3 calculate_normal(vec2 st, usampler2D heights) {
 	vec3 n = normalize(cross(dx, dy));  // TODO: it looks like normal is in a world space, shoul not be rather that in a view/camera space?
 	return n;
 }
+#endif
 
 void main() {
 	vec2 uv_p = floor(st);
-   vec3 n = calculate_normal(uv_p, heights);
+	if (top_down_rows)
+		uv_p.y = normal_tile_size - 1.0 - uv_p.y;  // flip in texel space (the same texel as for bottom-up rows)
+   vec3 n = calculate_normal(uv_p);
+	if (top_down_rows)
+		n.y = -n.y;  // texture t axis goes against word y axis
 
-	vec3 satellite_color = vec3(texture(satellite_map, uv_p / normal_tile_size).rgb);
+	vec3 satellite_color = vec3(SATELLITE(uv_p / normal_tile_size).rgb);
 	if (!use_satellite_map)
 		satellite_color = vec3(0.8, 0.8, 0.8);
 
 	vec3 color = satellite_color;
 	if (use_shading)
-		color *= max(0.2, dot(n, light_direction));
+		color *= max(0.2, dot(n, LIGHT_DIRECTION));
 
    frag_color = vec4(color, 1.0);
 }
@@ -5,21 +5,61 @@
 precision mediump float;
 precision mediump usampler2D;
 
+#ifdef VERTEX_PULLING  // no vertex attributes, position is calculated from vertex index (see main)
+uniform int quad_resolution;  // NxN quad mesh vertices
+vec3 position;
+#else
 layout(location = 0) in vec3 position;  // expected to be in a range of [0,1]^2 square
+#endif
 out vec2 st;  // normal texture coordinate in pixels [0, S_normal_size]^2
 
-uniform mat4 local_to_screen;
+#ifdef TEXTURE_ARRAY  // terrain tiles stored as texture array layers
+precision mediump usampler2DArray;
+uniform usampler2DArray heights;  // 16bit UI height texture array
+#ifdef INSTANCED
+layout(location = 1) in highp vec4 tile;  // instance (offset.x, offset.y, scale, texture array layer)
+flat out highp int tile_layer;  // texture array layer for fragment shader
+#endif
+#define HEIGHT(uv) texture(heights, vec3(uv, tile.w))
+#else
 uniform usampler2D heights;  // 16bit UI height texture
+#define HEIGHT(uv) texture(heights, uv)
+#endif
+
+#ifndef UNIFORM_BLOCKS  // otherwise uniforms in terrain uniform blocks
+uniform mat4 local_to_screen;
 uniform float elevation_scale;  // terrain elevation scale factor calculated from elevation pixel resolution
 uniform float height_scale;  // e.g. 10.0
 uniform float normal_tile_size;  // size of normal tile in px (e.g. 730)
+uniform bool top_down_rows;  // textures stored with the first image row at t=0 (not flipped while uploaded)
+#endif
+
+// elevation texture coordinate, top-down rows are flipped in texel space to read the same texel as bottom-up rows
+vec2 elevation_uv(vec2 p) {
+	if (!top_down_rows)
+		return p;
+	float rows = float(textureSize(heights, 0).y);
+	return vec2(p.x, 1.0 - (floor(p.y * rows) + 0.5) / rows);
+}
 
 void main() {
-	st = floor(position.xy * normal_tile_size);  // st \in [0, S_normal_tile]^2 in pixels
+#ifdef VERTEX_PULLING
+	position = vec3(gl_VertexID % quad_resolution, gl_VertexID / quad_resolution, 0) / float(quad_resolution - 1);
+#endif
+	vec2 uv = elevation_uv(position.xy);
+	st = floor(position.xy * normal_tile_size);  // st \in [0, S_normal_tile]^2 in pixels (top-down rows flipped by fragment shader)
 
 	// read h value from elevation tile
-	float h = float(texture(heights, position.xy).r) * elevation_scale * height_scale;
+	float h = float(HEIGHT(uv).r) * elevation_scale * height_scale;
 
-	vec3 pos = vec3(position.xy, h);
+	highp vec3 pos = vec3(position.xy, h);  // highp for world positions of uniform block variants
+#ifdef UNIFORM_BLOCKS
+	pos.xy = tile.xy + pos.xy * tile.z;  // terrain to world position
+#ifdef INSTANCED
+	tile_layer = int(tile.w);
+#endif
+	gl_Position = world_to_screen * vec4(pos, 1.0);
+#else
 	gl_Position = local_to_screen * vec4(pos, 1.0);
+#endif
 }
@@ -16,13 +16,15 @@ using glm::mat4,
 path const VERTEX_SHADER_FILE = "height_overlap.vs",
 	FRAGMENT_SHADER_FILE = "height_overlap.fs";
 
-height_overlap_shader_program::height_overlap_shader_program() {
-	string const vertex_shader = read_file(VERTEX_SHADER_FILE),
-		fragment_shader = read_file(FRAGMENT_SHADER_FILE);
+height_overlap_shader_program::height_overlap_shader_program(terrain_shader_variant variant) {
+	string const vertex_shader = with_variant_defines(read_file(VERTEX_SHADER_FILE), variant),
+		fragment_shader = with_variant_defines(read_file(FRAGMENT_SHADER_FILE), variant);
+
 	_prog = get_shader_program(vertex_shader.c_str(), fragment_shader.c_str());
 
-	_position = glGetAttribLocation(_prog, "position");
-	assert(_position == 0 && "we are expecting position location ID is set to 0");
+	_position = glGetAttribLocation(_prog, "position");  // -1 for vertex pulling variant (no vertex attributes)
+	assert((pulls_vertices(variant) || _position == 0) && "we are expecting position location ID is set to 0");
+	_quad_resolution = glGetUniformLocation(_prog, "quad_resolution");
 
 	// vertex
 	_local_to_screen = glGetUniformLocation(_prog, "local_to_screen");
@@ -30,24 +32,35 @@ height_overlap_shader_program::height_overlap_shader_program() {
 	_elevation_scale = glGetUniformLocation(_prog, "elevation_scale");
 	_height_scale = glGetUniformLocation(_prog, "height_scale");
 	_normal_tile_size = glGetUniformLocation(_prog, "normal_tile_size");
+	_top_down_rows = glGetUniformLocation(_prog, "top_down_rows");
 
 	// fragment
 	_satellite_map = glGetUniformLocation(_prog, "satellite_map");
 	_use_satellite_map = glGetUniformLocation(_prog, "use_satellite_map");
 	_use_shading = glGetUniformLocation(_prog, "use_shading");
 	_terrain_size = glGetUniformLocation(_prog, "terrain_size");
-	_elevation_tile_size = glGetUniformLocation(_prog, "elevation_tile_size");
+	_elevation_tile_size = glGetUniformLocation(_prog, "elevation_tile_size");  // -1 for baked normals variant
+	_normal_map = glGetUniformLocation(_prog, "normal_map");
 
 	// check uniforms are active
-	assert(_local_to_screen != -1);
 	assert(_heights != -1);
-	assert(_elevation_scale != -1);
-	assert(_height_scale != -1);
 	assert(_satellite_map != -1);
-	assert(_use_satellite_map != -1);
-	assert(_use_shading != -1);
-	assert(_elevation_tile_size != -1);
-	assert(_normal_tile_size != -1);
+
+	assert((!pulls_vertices(variant) || _quad_resolution != -1) && "quad resolution expected for vertex pulling");
+	assert((variant != terrain_shader_variant::baked_normals || _normal_map != -1) && "normal map expected for baked normals");
+
+	if (has_loose_uniforms(variant)) {  // otherwise in terrain uniform blocks
+		assert(_local_to_screen != -1);
+		assert(_use_satellite_map != -1);
+		assert(_elevation_scale != -1);
+		assert(_height_scale != -1);
+		assert(_use_shading != -1);
+		assert(_elevation_tile_size != -1);
+		assert(_normal_tile_size != -1);
+		assert(_top_down_rows != -1);
+	}
+	else
+		bind_terrain_uniform_blocks(_prog);
 }
 
 height_overlap_shader_program::~height_overlap_shader_program() {
@@ -101,3 +114,15 @@ void height_overlap_shader_program::elevation_tile_size(float size) {
 void height_overlap_shader_program::normal_tile_size(float size) {
 	set_uniform(_normal_tile_size, size);
 }
+
+void height_overlap_shader_program::top_down_rows(bool value) {
+	set_uniform(_top_down_rows, value);
+}
+
+void height_overlap_shader_program::quad_resolution(int n) {
+	set_uniform(_quad_resolution, n);
+}
+
+void height_overlap_shader_program::normal_map(int texture_unit_id) {
+	set_uniform(_normal_map, texture_unit_id);
+}
@@ -3,10 +3,12 @@
 #include <glm/vec2.hpp>
 #include <glm/mat4x4.hpp>
 #include <GLES3/gl32.h>
+#include "terrain_shader_variant.hpp"
 
 class height_overlap_shader_program {
 public:
-	height_overlap_shader_program();
+	//! \param variant Program variant, e.g. for terrain tiles stored as texture array layers (see terrain_uniform_buffers).
+	explicit height_overlap_shader_program(terrain_shader_variant variant = terrain_shader_variant::textures);
 	~height_overlap_shader_program();
 	void use();
 	void local_to_screen(glm::mat4 const & T);
@@ -19,6 +21,9 @@ public:
 	void terrain_size(float size);  //!< terrain size in real world units e.g. meters
 	void elevation_tile_size(float size);
 	void normal_tile_size(float size);
+	void top_down_rows(bool value);  //!< Elevation and satellite textures are stored with the first image row at t=0.
+	void quad_resolution(int n);  //!< Quad mesh (NxN) resolution for terrain_shader_variant::vertex_pulling variant.
+	void normal_map(int texture_unit_id);  //!< Set baked normal map for terrain_shader_variant::baked_normals variant.
 	GLint position_location() const;
 
 private:
@@ -34,5 +39,8 @@ private:
 		_use_satellite_map,
 		_use_shading,
 		_terrain_size,
-		_elevation_tile_size;
+		_elevation_tile_size,
+		_top_down_rows,
+		_quad_resolution,
+		_normal_map;
 };
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+#include "horizon_culling.hpp"
+
+using std::min, std::max;
+using glm::vec2, glm::vec3;
+
+namespace {
+
+constexpr float lowest_slope = -std::numeric_limits<float>::max(),
+	no_distance = std::numeric_limits<float>::max();
+
+}  // namespace
+
+horizon_culling::horizon_culling(unsigned sector_count)
+	: _sectors(sector_count), _eye{0, 0, 0} {
+	assert(sector_count > 0);
+	reset(_eye);
+}
+
+void horizon_culling::reset(vec3 const & eye) {
+	_eye = eye;
+	std::ranges::fill(_sectors, sector{.slope=lowest_slope, .distance=no_distance});
+}
+
+bool horizon_culling::occluded(geom::box3 const & box) const {
+	int first, last;
+	if (!sector_range(box, first, last, false))
+		return false;  // camera is above the box
+
+	// the highest line of sight to any box point
+	float const d_min = distance(box),
+		dz = box.max_corner().z - _eye.z,
+		box_slope = dz >= 0 ? dz / d_min : dz / max_distance(box);
+
+	for (int i = first; i <= last; ++i) {
+		sector const & s = at(i);
+		if (d_min < s.distance || box_slope >= s.slope)
+			return false;  // box is visible at least in one sector
+	}
+
+	return true;
+}
+
+void horizon_culling::add_occluder(geom::box3 const & box) {
+	int first, last;
+	if (!sector_range(box, first, last, true))
+		return;  // box under the camera or too narrow to cover a sector
+
+	// the lowest line of sight to the box ground (terrain is at least min z high in the whole box)
+	float const d_max = max_distance(box),
+		dz = box.min_corner().z - _eye.z,
+		box_slope = dz >= 0 ? dz / d_max : dz / distance(box);
+
+	for (int i = first; i <= last; ++i) {
+		sector & s = _sectors[i % int(std::size(_sectors))];
+		if (box_slope > s.slope) {
+			s.slope = box_slope;
+			s.distance = (s.distance == no_distance) ? d_max : max(s.distance, d_max);
+		}
+	}
+}
+
+float horizon_culling::distance(geom::box3 const & box) const {
+	vec2 const lo = vec2{box.min_corner()},
+		hi = vec2{box.max_corner()},
+		eye = vec2{_eye};
+	vec2 const closest = clamp(eye, lo, hi);
+	return length(closest - eye);
+}
+
+float horizon_culling::max_distance(geom::box3 const & box) const {
+	vec2 const lo = vec2{box.min_corner()},
+		hi = vec2{box.max_corner()},
+		eye = vec2{_eye};
+	vec2 const farthest = {
+		(eye.x - lo.x > hi.x - eye.x) ? lo.x : hi.x,
+		(eye.y - lo.y > hi.y - eye.y) ? lo.y : hi.y};
+	return length(farthest - eye);
+}
+
+bool horizon_culling::sector_range(geom::box3 const & box, int & first, int & last, bool covered_only) const {
+	if (distance(box) <= 0.0f)
+		return false;  // camera is above the box, box covers all directions
+
+	constexpr float two_pi = glm::two_pi<float>();
+	float const sector_angle = two_pi / std::size(_sectors);
+
+	// azimuth range of box corners relative to the box center direction (box is not under the camera so range < pi)
+	vec2 const lo = vec2{box.min_corner()},
+		hi = vec2{box.max_corner()},
+		eye = vec2{_eye};
+	vec2 const center = (lo + hi) * 0.5f - eye;
+	float const center_angle = std::atan2(center.y, center.x);
+
+	float from = 0, to = 0;
+	for (vec2 const & corner : {lo, hi, vec2{lo.x, hi.y}, vec2{hi.x, lo.y}}) {
+		vec2 const d = corner - eye;
+		float delta = std::atan2(d.y, d.x) - center_angle;
+		if (delta > glm::pi<float>())
+			delta -= two_pi;
+		else if (delta < -glm::pi<float>())
+			delta += two_pi;
+		from = min(from, delta);
+		to = max(to, delta);
+	}
+
+	float start = center_angle + from;
+	if (start < 0)
+		start += two_pi;
+	float const end = start + (to - from);
+
+	if (covered_only) {  // sectors fully inside of the range
+		first = int(std::ceil(start / sector_angle));
+		last = int(std::floor(end / sector_angle)) - 1;
+		return first <= last;
+	}
+
+	first = int(std::floor(start / sector_angle));  // sectors touching the range
+	last = int(std::floor(end / sector_angle));
+	return true;
+}
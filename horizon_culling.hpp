@@ -0,0 +1,50 @@
+/*! \file
+Horizon culling for terrain tiles seen from a low altitude (e.g. terrain_camera just above the ground).
+Camera surroundings are split into azimuth sectors and each sector keeps the horizon (elevation angle
+tangent) raised by already processed nearer tiles. Tiles needs to be processed front to back, a tile
+with all its points bellow the horizon is hidden behind nearer tiles.
+\code
+horizon_culling horizon;
+horizon.reset(eye);
+for (geom::box3 const & tile : front_to_back_tiles) {  // z range is tile (min, max) elevation
+	if (horizon.occluded(tile))
+		continue;  // hidden
+	horizon.add_occluder(tile);
+	// draw tile
+}
+\endcode */
+#pragma once
+#include <vector>
+#include <glm/vec3.hpp>
+#include "geometry/box3.hpp"
+
+class horizon_culling {
+public:
+	explicit horizon_culling(unsigned sector_count = 256);
+
+	void reset(glm::vec3 const & eye);  //!< Clears the horizon for a new camera position (e.g. each frame).
+
+	/*! \returns True in case whole \c box (world space tile bounds) is bellow the horizon in all
+	sectors the box covers, false otherwise (also for boxes under the camera). */
+	[[nodiscard]] bool occluded(geom::box3 const & box) const;
+
+	/*! Raises the horizon behind \c box using its lowest point (min z) as a conservative occluder height,
+	only sectors fully covered by the box are raised. */
+	void add_occluder(geom::box3 const & box);
+
+	[[nodiscard]] float distance(geom::box3 const & box) const;  //!< \returns Horizontal distance from the camera to \c box (for front to back sorting).
+
+private:
+	struct sector {
+		float slope,  //!< horizon elevation angle tangent
+			distance;  //!< the horizon is valid beyond the distance (all occluders are nearer)
+	};
+
+	//! Box azimuth range [first, last] in sectors (last can be bigger than sector count), false for box under the camera.
+	bool sector_range(geom::box3 const & box, int & first, int & last, bool covered_only) const;
+	float max_distance(geom::box3 const & box) const;  //!< \returns Horizontal distance of the farthest box corner.
+	sector const & at(int i) const {return _sectors[i % int(std::size(_sectors))];}
+
+	std::vector<sector> _sectors;
+	glm::vec3 _eye;
+};
@@ -0,0 +1,31 @@
+#include <algorithm>
+#include <functional>
+#include <cassert>
+#include "layer_allocator.hpp"
+
+using std::optional, std::greater;
+
+layer_allocator::layer_allocator(unsigned capacity)
+	: _capacity{capacity} {
+	_free.reserve(_capacity);
+	for (unsigned i = 0; i < _capacity; ++i)
+		_free.push_back(_capacity-1 - i);
+	std::ranges::make_heap(_free, greater{});
+}
+
+optional<GLint> layer_allocator::allocate() {
+	if (empty(_free))
+		return std::nullopt;
+
+	std::ranges::pop_heap(_free, greater{});
+	GLint const layer = _free.back();
+	_free.pop_back();
+	return layer;
+}
+
+void layer_allocator::release(GLint layer) {
+	assert(layer >= 0 && unsigned(layer) < _capacity && "layer out of range");
+	assert(std::ranges::find(_free, layer) == end(_free) && "layer already released");
+	_free.push_back(layer);
+	std::ranges::push_heap(_free, greater{});
+}
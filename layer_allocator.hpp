@@ -0,0 +1,35 @@
+/*! \file
+Texture array layer (slot) allocator. Same size tiles are stored as layers of shared texture arrays
+(see create_texture_array_storage_16b()) so all tiles can be drawn with the same bound textures and
+only the layer index changes per draw.
+\code
+texture_storage const elevation_array = create_texture_array_storage_16b(desc, 64);
+layer_allocator layers{64};
+if (std::optional<GLint> layer = layers.allocate()) {
+	texture_storage elevation = elevation_array;
+	elevation.layer = *layer;
+	upload_texture(elevation, pixels, desc);
+}
+// ...
+layers.release(layer);  // tile evicted, layer can be reused
+\endcode */
+#pragma once
+#include <optional>
+#include <vector>
+#include <GLES3/gl32.h>
+
+class layer_allocator {
+public:
+	explicit layer_allocator(unsigned capacity);
+
+	//! \returns Free layer index (lowest released layer first) or nothing in case all layers are in use.
+	[[nodiscard]] std::optional<GLint> allocate();
+	void release(GLint layer);  //!< Returns layer back to the allocator.
+
+	[[nodiscard]] unsigned capacity() const {return _capacity;}
+	[[nodiscard]] unsigned used() const {return _capacity - std::size(_free);}  //!< \returns Number of allocated layers.
+
+private:
+	unsigned const _capacity;
+	std::vector<GLint> _free;  //!< free layers (heap with the lowest layer on top)
+};
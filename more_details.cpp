@@ -1,11 +1,14 @@
 /* OpenGL ES 3.2, terrain with heights from height map texture and proper scaling.
 Usage: terrain_quad [DEM_FILE]
+--upload-thread (third argument): tile textures are created by an upload thread with shared OpenGL context
 o: show/hide outline
 c: reset view
 p: set camera to predefined position (so we can compare render result)
 t: show/hide terain render (to more focus on outline or normals)
 s: show/hide satellite texture
 a: toggle shading calculations
+h: toggle horizon culling
+m: switch terrain mesh index order (see quad_index_order)
 l: show hide light direction
 f: map/free camera switch, move camera with "wsad" keys
 	w: go forward
@@ -13,11 +16,13 @@ f: map/free camera switch, move camera with "wsad" keys
 	a: go left
 	d: go right
 i: print transformations info */
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <set>
 #include <string>
 #include <memory>
 #include <tuple>
@@ -41,6 +46,7 @@ i: print transformations info */
 #include "color.hpp"
 #include "free_camera.hpp"
 #include "texture.hpp"
+#include "gl_upload_thread.hpp"
 #include "shader.hpp"
 #include "io.hpp"
 #include "terrain_scale_ui.hpp"
@@ -51,7 +57,10 @@ i: print transformations info */
 #include "above_terrain_outline_shader_program.hpp"
 #include "grid_of_terrains_lightdir_shader_program.hpp"
 #include "more_details_terrain_grid.hpp"
+#include "terrain_uniform_buffers.hpp"
 #include "terrain_camera.hpp"
+#include "frustum.hpp"
+#include "horizon_culling.hpp"
 
 using std::vector, std::string, std::pair, std::byte, std::size;
 using std::tuple, std::get;
@@ -78,7 +87,8 @@ constexpr GLuint WIDTH = 800,
 constexpr float TERRAIN_SIZE_SCALE = 2.0f;
 constexpr float TERRAIN_HEIGHT_SCALE = 10.0f;
 
-constexpr unsigned DEFAULT_QUAD_RESOLOTION = 10;  // for 10x10 vertices quad
+constexpr unsigned DEFAULT_QUAD_RESOLOTION = 11;  // for 11x11 vertices quad (stitched quad needs odd resolution)
+constexpr float DEFAULT_PIXEL_ERROR = 4.0f;  // LOD screen space error threshold in pixels
 
 path const LIGHTDIR_VERTEX_SHADER_FILE = "height_map_lightdir.vs",
 	LIGHTDIR_GEOMETRY_SHADER_FILE = "to_line.gs",
@@ -120,7 +130,9 @@ struct render_features {  // list of selected rendering features
 		show_lightdir,
 		show_outline,
 		show_satellite,
-		calculate_shades;
+		calculate_shades,
+		horizon_culling;
+	quad_index_order index_order;  //!< terrain mesh index buffer layout
 };
 
 /*! Process user input.
@@ -139,34 +151,36 @@ void input_camera(SDL_Event const & event, free_camera & cam, input_mode const &
 
 void update(free_camera & cam, input_mode const & mode, float dt);
 
+/*! Removes terrains hidden behind nearer terrains seen from \c eye (see `horizon_culling.hpp`).
+\param scale Grid to world scale (see terrain_grid::collect_visible()).
+\returns Number of removed terrains. */
+size_t remove_bellow_horizon(horizon_culling & horizon, vec3 const & eye, terrain_grid const & terrains,
+	vec3 const & scale, vector<terrain const *> & visible);
+
 // Draw helpers
 
+/*! Draw helpers expect terrain uniform blocks to be updated and terrain block to be bound (see
+`terrain_uniform_buffers.hpp`), terrain textures are bound by helpers. */
+
 //! Draws terrain quad with elevations and sattelite texture.
 void draw_terrain(height_overlap_shader_program & shader,
 	terrain const & trn,
-	unsigned int element_count,  //!< number of quad mesh triengle elements to draw
-	mat4 const & local_to_screen,
-	size_t elevation_size,  //!< elevaation texture size in pixels
-	float height_scale, float elevation_scale,
+	stitched_quad_mesh const & mesh,
+	unsigned edges,  //!< stitched mesh edges (see quad_edge)
 	render_features const & features);
 
 //! Draws terrain quad as mesh.
 void draw_terrain_outlines(above_terrain_outline_shader_program & shader,
 	terrain const & trn,
-	unsigned int element_count,  // number of quad mesh triengle elements to draw
-	vec3 color,
-	float height_scale,
-	float elevation_scale,
-	mat4 local_to_screen,
-	render_features const & features);
+	stitched_quad_mesh const & mesh,
+	unsigned edges,
+	vec3 color);
 
 //! Draws terrain light directions.
 void draw_terrain_light_directions(grid_of_terrains_lightdir_shader_program & shader,
 	terrain const & trn,
-	unsigned int element_count,
-	float height_scale,
-	float elevation_scale,
-	mat4 local_to_screen);
+	stitched_quad_mesh const & mesh,
+	unsigned edges);
 
 
 // three lines
@@ -197,6 +211,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 
 	// process arguments
 	string const title = string{path{argv[0]}.stem()} + " (OpenGL ES 3.2)"s;
+	path const tiles_path = (argc > 1) ? path{argv[1]} : data_path;  // dataset directory or tile pack file
+	unsigned const tiles_overview = (argc > 2) ? std::stoul(argv[2]) : 0;  // e.g. 2 to load 1/16 size tiles
+	bool const use_upload_thread = (argc > 3) && argv[3] == "--upload-thread"s;
 
 	SDL_Init(SDL_INIT_VIDEO);
 	SDL_Window * window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED,
@@ -212,11 +229,17 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 		<< "GL_VERSION: " << glGetString(GL_VERSION) << "\n"
 		<< "GL_RENDERER: " << glGetString(GL_RENDERER) << "\n"
 		<< "GLSL_VERSION: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+
+	// upload thread needs to be created with current context and needs to outlive terrains
+	std::unique_ptr<gl_upload_thread> uploader;
+	if (use_upload_thread)
+		uploader = std::make_unique<gl_upload_thread>(window, context);
 	
 	terrain_scale_ui ui;
 	ui.height_scale = TERRAIN_HEIGHT_SCALE;
 	ui.quad_scale = TERRAIN_SIZE_SCALE;
 	ui.quad_resolution = DEFAULT_QUAD_RESOLOTION;
+	ui.pixel_error = DEFAULT_PIXEL_ERROR;
 	ui.init(config_file_path);
 	ui.setup(window, context);
 
@@ -224,15 +247,17 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 	glCullFace(GL_BACK);
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);  // for quad_index_order::strips meshes
 
-	height_overlap_shader_program shader;
+	// terrain quad mesh vertices are calculated in vertex shaders (no vertex buffer, see quad_meshes)
+	height_overlap_shader_program shader{terrain_shader_variant::baked_normals};  // normals baked while tiles are loaded
 
 	// load shader program to visualize light direction
-	grid_of_terrains_lightdir_shader_program lightdir_shader;
+	grid_of_terrains_lightdir_shader_program lightdir_shader{terrain_shader_variant::vertex_pulling};
 	assert(shader.position_location() == lightdir_shader.position_location() && "we expect the same position attribute locations (=0)");
 
 	// load shader program for wirefraame rendering
-	above_terrain_outline_shader_program outline_shader;
+	above_terrain_outline_shader_program outline_shader{terrain_shader_variant::vertex_pulling};
 	assert(shader.position_location() == outline_shader.position_location() && "we expect the same position attribute locations (=0)");
 
 	string const flat_vs = read_file("flat_shader.vs"),
@@ -241,6 +266,10 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 
 	flat_shader_program flat_shader{flat_shader_program_id};
 
+	// per frame and per terrain uniform blocks (terrain shader variants uniforms)
+	terrain_uniform_buffers terrain_blocks;
+	vector<terrain_tile_uniforms> visible_blocks;
+
 	// load axes model
 	GLuint const axes_position_vbo = push_axes();
 	axes_model axes{axes_position_vbo};
@@ -248,9 +277,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glViewport(0, 0, WIDTH, HEIGHT);
 
-	// create terrain mash
+	// create terrain mash (with stitched edges variants for neighbours of a lower level), only index buffers for vertex pulling
 	constexpr float quad_size = 1.0f;
-	auto [vao, vbo, ibo, element_count] = create_quad_mesh(shader.position_location(), ui.quad_resolution);
+	quad_mesh_cache quad_meshes{shader.position_location()};  // position_location() = -1
 
 	// camera related stuff
 	terrain_camera cam{20.0f};
@@ -267,15 +296,22 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 		.show_lightdir = false,
 		.show_outline = true,
 		.show_satellite = true,
-		.calculate_shades = true
+		.calculate_shades = true,
+		.horizon_culling = true,
+		.index_order = quad_index_order::z_order
 	};
 
-	unsigned quad_resolution = ui.quad_resolution;  // save quad resolution to detect resolution changes
+	vector<terrain const *> visible_terrains;  // terrains passed view frustum culling
+	std::set<tile_id> selected_tiles;  // LOD selected terrains (before horizon culling) to stitch terrain edges
+	horizon_culling horizon;
 
 	// create grid of terrains (load textures, ...)
 	terrain_grid terrains;
-	terrains.load_tiles(data_path);
-	spdlog::info("we have {} terrains loaded", terrains.size());
+	terrains.overview = tiles_overview;
+	terrains.upload_thread = uploader.get();
+	terrains.normal_maps = true;  // for baked normals shader variant
+	terrains.load_tiles(tiles_path);  // tiles are loaded in background and uploaded in the loop
+	spdlog::info("{} terrains requested", terrains.loading());
 
 	auto t_prev = steady_clock::now();
 
@@ -284,6 +320,8 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 	terrain const * camera_terrain = nullptr;
 
 	while (true) {  // the loop
+		terrains.upload_loaded_tiles();  // bounded upload, terrains become renderable as they arrive
+
 		// compute dt
 		auto t_now = steady_clock::now();
 		float const dt = duration_cast<milliseconds>(t_now - t_prev).count() / 1000.0f;
@@ -318,18 +356,15 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 
 		ui.create();
 
-		// detect quad resolution change
-		if (quad_resolution != static_cast<unsigned>(ui.quad_resolution)) {
-			assert(ui.quad_resolution > 1);
-			destroy_quad_mesh(vao, vbo, ibo);
-			std::tie(vao, vbo, ibo, element_count) = create_quad_mesh(shader.position_location(), ui.quad_resolution);
-			quad_resolution = ui.quad_resolution;
-		}
+		// quad resolution changes are handled by the mesh cache, stitching needs odd resolution
+		assert(ui.quad_resolution > 1);
+		unsigned const quad_resolution = static_cast<unsigned>(ui.quad_resolution) | 1u;
+		stitched_quad_mesh const & quad_mesh = quad_meshes.get(quad_resolution, features.index_order);
 
 		// render
 		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);  // clear buffer
 
-		glBindVertexArray(vao);  // VAO is independent of used program
+		glBindVertexArray(quad_mesh.vao);  // VAO is independent of used program
 
 		float const model_scale = ui.quad_scale;
 
@@ -343,17 +378,23 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 			for (terrain const & t : terrains.iterate())
 				cout << "(" <<  t.grid_c << "," << t.grid_r << ") -> " << t.position * model_scale << " ";
 			cout << "\n";
-		}
 
-		assert(size(terrains) > 0 && "we expect at least one terrain to render something");
+			cout << "upload queue: " << terrains.upload_queue_depth() << " textures, " << terrains.loading()
+				<< " terrains loading\n";
+
+			tile_cache::statistics const cache = terrains.cache_stats();
+			cout << "tile_cache: hits=" << cache.hits << ", misses=" << cache.misses << ", evictions=" << cache.evictions
+				<< ", size=" << cache.size << "B (" << cache.count << " images)\n";
+		}
 
 		if (prev_cam_pos != cam.position()) {  // on camera move
 			for (terrain const & trn : terrains.iterate()) {  // find terrain under camera and set ground_height
-				if (is_above(trn, quad_size, model_scale, cam.position())) {
+				float const level_scale = terrains.level_quad_size(trn.level);
+				if (is_above(trn, quad_size*level_scale, model_scale, cam.position())) {
 					if (&trn != camera_terrain) {  // we want to change only when we are over new terrain
 						int const texture_width = terrains.elevation_tile_size(trn.level),  //= 716
 							texture_height = terrains.elevation_tile_size(trn.level);  //!< we should introduce texture_size
-						float const elevation_scale = model_scale / (terrains.elevation_pixel_size(trn.level) * texture_width);  //= 0.000107174
+						float const elevation_scale = (model_scale*level_scale) / (terrains.elevation_pixel_size(trn.level) * texture_width);  //= 0.000107174
 
 						terrain_grid::camera_ground_height = trn.elevation_min * elevation_scale * ui.height_scale;
 						camera_terrain = &trn;  // save for later comparison
@@ -365,40 +406,85 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 			prev_cam_pos = cam.position();
 		}
 
-		int rendered_tile_count = 0;
+		// hierarchical view frustum culling (terrain heights are scaled by model and height scale)
+		frustum const view = mode.detail_camera ? view_frustum(cam_detail) : view_frustum(cam, P);
+		visible_terrains.clear();
+		lod_selection const lod = {
+			.eye = mode.detail_camera ? cam_detail.position : cam.position(),
+			.screen_factor = HEIGHT * P[1][1] / 2.0f,  // P[1][1] = 1/tan(fovy/2)
+			.pixel_error = ui.pixel_error,
+			.mesh_resolution = static_cast<int>(quad_resolution)
+		};
+
+		size_t const tested_nodes = terrains.collect_visible(view,
+			vec3{model_scale, model_scale, model_scale*ui.height_scale}, lod, visible_terrains);
+
+		selected_tiles.clear();
+		for (terrain const * trn : visible_terrains)
+			selected_tiles.insert(tile_id{.level=trn->level, .column=trn->grid_c, .row=trn->grid_r});
+
+		// remove terrains hidden behind nearer terrains (low altitude views)
+		size_t horizon_culled = 0;
+		if (features.horizon_culling) {
+			horizon_culled = remove_bellow_horizon(horizon, lod.eye, terrains,
+				vec3{model_scale, model_scale, model_scale*ui.height_scale}, visible_terrains);
+		}
 
-		for (terrain const & trn : terrains.iterate()) {  // draw terrain grid
-			rendered_tile_count += 1;
+		if (events.info_request) {
+			cout << "culling: " << size(visible_terrains) << "/" << terrains.size() << " terrains visible, "
+				<< tested_nodes << " quadtree nodes tested, " << horizon_culled << " terrains bellow horizon, quadtree depth "
+				<< terrains.depth() << "\n";
 
-			float const level_scale = 1.0f / (pow(2.0f, trn.level - 1.0f) / 2.0f);  // this works only for level 2 and 3
-			vec2 const model_pos = trn.position * model_scale;
-			mat4 const M = scale(translate(mat4{1}, vec3{model_pos,0}), vec3{model_scale*level_scale, model_scale*level_scale, 1});  // T*S
-			mat4 const local_to_screen = P*V*M;
+			cout << "terrain mesh: " << quad_mesh.resolution << "x" << quad_mesh.resolution << ", " << to_string(quad_mesh.order)
+				<< " order, " << (quad_mesh.index_type == GL_UNSIGNED_SHORT ? 16 : 32) << "bit indices, ACMR="
+				<< quad_mesh.acmr << " (" << vertex_cache_size << " vertices FIFO cache)\n";
+		}
 
+		// per frame uniforms are uploaded once, tile sizes depends on terrain level so they are per terrain
+		terrain_blocks.update_frame(terrain_frame_uniforms{
+			.world_to_screen = P*V,
+			.light_direction = vec4{0, 0, 1, 0},
+			.elevation_scale = 0,  // per terrain (see terrain_tile_uniforms)
+			.height_scale = ui.height_scale,
+			.terrain_size = 0,
+			.elevation_tile_size = 0,
+			.normal_tile_size = 0,
+			.use_satellite_map = features.show_satellite,
+			.use_shading = features.calculate_shades,
+			.top_down_rows = true  // terrain grid textures are not flipped while uploaded
+		});
+
+		visible_blocks.clear();
+		for (terrain const * visible : visible_terrains) {
+			terrain const & trn = *visible;
+			float const level_scale = terrains.level_quad_size(trn.level);  // level terrain size in grid units
 			int const elevation_size = terrains.elevation_tile_size(trn.level);  //= 716
-			float const elevation_scale = (model_scale*level_scale) / (terrains.elevation_pixel_size(trn.level) * elevation_size);  //= 0.000107174
-
-			if (features.show_terrain) {  // render terrain
-				draw_terrain(shader, trn,
-					element_count,
-					local_to_screen,
-					elevation_size,
-					ui.height_scale, elevation_scale, features);
-			}
+			float const terrain_size = terrains.elevation_pixel_size(trn.level) * elevation_size;  // in meters
+
+			visible_blocks.push_back(terrain_tile_uniforms{
+				.tile = {.offset=trn.position * model_scale, .scale=model_scale*level_scale, .layer=0},
+				.elevation_scale = (model_scale*level_scale) / terrain_size,  //= 0.000107174
+				.terrain_size = terrain_size,
+				.elevation_tile_size = float(elevation_size),
+				.normal_tile_size = float(elevation_size - 2*elevation_tile_border)  // no normals for border pixels
+			});
+		}
+		terrain_blocks.update_tiles(visible_blocks);  // one block range bind per terrain draw
 
-			if (features.show_lightdir) {  // render light directions
-				draw_terrain_light_directions(lightdir_shader, trn,
-					element_count,
-					ui.height_scale, elevation_scale, local_to_screen);
-			}
+		for (size_t i = 0; i < size(visible_terrains); ++i) {  // draw visible terrains
+			terrain const & trn = *visible_terrains[i];
+			unsigned const edges = coarser_neighbour_edges(trn, selected_tiles);  // mesh variant without T-junctions
+
+			terrain_blocks.bind_tile(i);
+
+			if (features.show_terrain)  // render terrain
+				draw_terrain(shader, trn, quad_mesh, edges, features);
+
+			if (features.show_lightdir)  // render light directions
+				draw_terrain_light_directions(lightdir_shader, trn, quad_mesh, edges);
 
-			if (features.show_outline) {  // render wireframe
-				draw_terrain_outlines(outline_shader, trn,
-					element_count,
-					rgb::blue,
-					ui.height_scale, elevation_scale, local_to_screen,
-					features);
-			}			
+			if (features.show_outline)  // render wireframe
+				draw_terrain_outlines(outline_shader, trn, quad_mesh, edges, rgb::blue);
 		}  // for (trn ...
 
 		glBindVertexArray(0);  // unbind VAO
@@ -420,8 +506,6 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 		SDL_GL_SwapWindow(window);
 	}  // while
 	
-	destroy_quad_mesh(vao, vbo, ibo);
-
 	ui.shutdown();
 
 	SDL_GL_DeleteContext(context);
@@ -433,10 +517,8 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char * argv[]) {
 
 void draw_terrain(height_overlap_shader_program & shader,
 	terrain const & trn,
-	unsigned int element_count,
-	mat4 const & local_to_screen,
-	size_t elevation_size,
-	float height_scale, float elevation_scale,
+	stitched_quad_mesh const & mesh,
+	unsigned edges,
 	render_features const & features) {
 
 	shader.use();
@@ -447,39 +529,25 @@ void draw_terrain(height_overlap_shader_program & shader,
 	glBindTexture(GL_TEXTURE_2D, trn.elevation_map);  // bind a height texture to active texture unit (0)
 
 	if (features.show_satellite) {
-		shader.use_satellite_map(true);
 		shader.satellite_map(1);  // set satellite map sampler to use texture unit 1
 		glActiveTexture(GL_TEXTURE1);  // activate texture unit 1
 		glBindTexture(GL_TEXTURE_2D, trn.satellite_map);  // bind a satellite texture to active texture unit (1)
 	}
-	else
-		shader.use_satellite_map(false);
-
-	if (features.calculate_shades)
-		shader.use_shading(true);
-	else
-		shader.use_shading(false);
 
-	constexpr float elevation_tile_pixel_size = 26.063200588611451;  // see gdalinfo
+	shader.normal_map(2);  // set normal map sampler to use texture unit 2
+	glActiveTexture(GL_TEXTURE2);  // activate texture unit 2
+	glBindTexture(GL_TEXTURE_2D, trn.normal_map);  // bind a normal texture to active texture unit (2)
 
-	shader.terrain_size(elevation_size * elevation_tile_pixel_size);
-	shader.elevation_tile_size(elevation_size);
-	shader.normal_tile_size(elevation_size - 4);  // 2px border
-	shader.height_scale(height_scale);
-	shader.elevation_scale(elevation_scale);
-	shader.local_to_screen(local_to_screen);
+	shader.quad_resolution(mesh.resolution);  // vertex pulling
 
-	glDrawElements(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0);
+	mesh.draw(edges);
 }
 
 void draw_terrain_outlines(above_terrain_outline_shader_program & shader,
 	terrain const & trn,
-	unsigned int element_count,  // number of quad mesh triengle elements to draw
-	vec3 color,
-	float height_scale,
-	float elevation_scale,
-	mat4 local_to_screen,
-	render_features const & features) {
+	stitched_quad_mesh const & mesh,
+	unsigned edges,
+	vec3 color) {
 
 	shader.use();
 
@@ -490,19 +558,15 @@ void draw_terrain_outlines(above_terrain_outline_shader_program & shader,
 	glActiveTexture(GL_TEXTURE0);  // activate texture unit 0
 	glBindTexture(GL_TEXTURE_2D, trn.elevation_map);  // bind a texture to active texture unit (0)
 
-	shader.elevation_scale(elevation_scale);
-	shader.height_scale(height_scale);
-	shader.local_to_screen(local_to_screen);
+	shader.quad_resolution(mesh.resolution);  // vertex pulling
 
-	glDrawElements(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0);
+	mesh.draw(edges);
 }
 
 void draw_terrain_light_directions(grid_of_terrains_lightdir_shader_program & shader,
 	terrain const & trn,
-	unsigned int element_count,
-	float height_scale,
-	float elevation_scale,
-	mat4 local_to_screen) {
+	stitched_quad_mesh const & mesh,
+	unsigned edges) {
 
 	shader.use();
 	shader.fill_color(rgb::yellow);
@@ -512,14 +576,11 @@ void draw_terrain_light_directions(grid_of_terrains_lightdir_shader_program & sh
 	glActiveTexture(GL_TEXTURE0);  // activate texture unit 0
 	glBindTexture(GL_TEXTURE_2D, trn.elevation_map);  // bind a texture to active texture unit (0)
 
-	shader.elevation_scale(elevation_scale);
-	shader.height_scale(height_scale);
-	shader.local_to_screen(local_to_screen);
+	shader.quad_resolution(mesh.resolution);  // vertex pulling
 
-	glDrawElements(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0);
+	mesh.draw(edges);
 }
 
-
 // handling render features
 void input_render_features(SDL_Event const & event, render_features & features) {
 	if (event.type == SDL_KEYDOWN) {
@@ -544,6 +605,16 @@ void input_render_features(SDL_Event const & event, render_features & features)
 			features.calculate_shades = !features.calculate_shades;
 			spdlog::info("calculate_shadess={}", features.calculate_shades);
 			break;
+		case SDLK_h:
+			features.horizon_culling = !features.horizon_culling;
+			spdlog::info("horizon_culling={}", features.horizon_culling);
+			break;
+		case SDLK_m: {
+			auto it = std::ranges::find(quad_index_orders, features.index_order);
+			features.index_order = (it + 1 == std::end(quad_index_orders)) ? quad_index_orders[0] : *(it + 1);
+			spdlog::info("index_order={}", to_string(features.index_order));
+			break;
+		}
 		}
 	}
 }
@@ -753,3 +824,36 @@ void verbose_signal_handler(int signal) {
 
 	exit(signal);
 }
+
+size_t remove_bellow_horizon(horizon_culling & horizon, vec3 const & eye, terrain_grid const & terrains,
+	vec3 const & scale, vector<terrain const *> & visible) {
+
+	struct candidate {
+		terrain const * trn;
+		geom::box3 bounds;  //!< world space terrain bounds
+		float distance;
+	};
+
+	horizon.reset(eye);
+
+	vector<candidate> candidates;
+	candidates.reserve(size(visible));
+	for (terrain const * trn : visible) {
+		geom::box3 const grid_bounds = terrains.terrain_bounds(*trn);
+		geom::box3 const bounds{grid_bounds.min_corner() * scale, grid_bounds.max_corner() * scale};
+		candidates.push_back(candidate{.trn=trn, .bounds=bounds, .distance=horizon.distance(bounds)});
+	}
+
+	std::ranges::sort(candidates, {}, &candidate::distance);  // front to back
+
+	visible.clear();
+	for (candidate const & c : candidates) {
+		if (horizon.occluded(c.bounds))
+			continue;
+
+		horizon.add_occluder(c.bounds);
+		visible.push_back(c.trn);
+	}
+
+	return size(candidates) - size(visible);
+}
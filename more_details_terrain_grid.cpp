@@ -1,17 +1,31 @@
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <regex>
+#include <sstream>
 #include <string>
-#include <tuple>
 #include <utility>
+#include <cassert>
 #include <spdlog/spdlog.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
 #include "geometry/glmprint.hpp"
 #include "texture.hpp"
+#include "tile_pack.hpp"
+#include "normal_map.hpp"
+#include "quad.hpp"
 #include "more_details_terrain_grid.hpp"
 
 // to implement is_above()
 #include <boost/geometry/algorithms/intersects.hpp>
 #include "geometry/box2.hpp"
 
+// to calculate quadtree bounds
+#include <boost/geometry/algorithms/expand.hpp>
+#include <boost/geometry/algorithms/make.hpp>
+
 // to load dataset description file
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -21,7 +35,6 @@ using std::string, std::to_string;
 using std::filesystem::path;
 using std::pair;
 using std::unique_ptr, std::make_unique;
-using std::tuple, std::get;
 using glm::vec2, glm::vec3;
 
 namespace {  //!< Helper functions.
@@ -29,13 +42,23 @@ namespace {  //!< Helper functions.
 //! Helper function to calculate word position from grid (coumn, row) position.
 vec2 to_word_position(int column, int row, int level, float quad_size);
 
-bool is_square(tuple<GLuint, size_t, size_t> const & tile) {
-	return get<1>(tile) == get<2>(tile);
-}
+//! \returns Parent tile in a previous (quadtree) level, level 1 is the quadtree root.
+tile_id parent_of(tile_id const & id);
 
-GLuint get_tid(tuple<GLuint, size_t, size_t> const & tile) {  //!< get OpenGL texture ID
-	return get<0>(tile);
-}
+tile_id id_of(terrain const & trn);
+
+//! \returns Index of \c column, \c row tile within its parent children.
+int child_index(int column, int row);
+
+//! Updates inner nodes bounds from children bounds (leaf bounds are expected to be set).
+void update_bounds(terrain_quad & node);
+
+//! \returns True for \c id tile within \c ancestor tile area (or \c ancestor itself).
+bool is_within(tile_id const & id, tile_id const & ancestor);
+
+//! Deletes \c node subtree terrain textures (inner nodes have textures as well).
+void delete_textures(terrain_quad const & node);
+void delete_textures(terrain const & trn);
 
 }  // namespace
 
@@ -52,11 +75,43 @@ bool is_above(terrain const & trn, float quad_size, float model_scale, vec3 cons
 	return bg::intersects(vec2{pos}, tile_area);
 }
 
+unsigned coarser_neighbour_edges(terrain const & trn, std::set<tile_id> const & selected) {
+	struct neighbour {
+		int dc, dr;
+		quad_edge edge;
+	};
+
+	// grid rows goes from north to south (see to_word_position())
+	constexpr neighbour neighbours[] = {
+		{.dc=0, .dr=1, .edge=edge_south},
+		{.dc=1, .dr=0, .edge=edge_east},
+		{.dc=0, .dr=-1, .edge=edge_north},
+		{.dc=-1, .dr=0, .edge=edge_west}
+	};
+
+	unsigned edges = 0;
+	for (neighbour const & n : neighbours) {
+		int const column = trn.grid_c + n.dc,
+			row = trn.grid_r + n.dr;
+
+		// neighbour area is covered by a tile of a lower level (ancestor of the same level neighbour tile)
+		for (int up = 1; up < trn.level; ++up) {
+			if (selected.contains(tile_id{.level=trn.level-up, .column=column >> up, .row=row >> up})) {
+				assert(up == 1 && "neighbour terrains are expected to differ by one level at most");
+				edges |= n.edge;
+				break;
+			}
+		}
+	}
+
+	return edges;
+}
+
 
 float terrain_grid::camera_ground_height = 0.0f;
 
 
-vector<terrain> terrain_grid::load_level_tiles(path const & data_path, int level) const {
+size_t terrain_grid::list_level_tiles(path const & data_path, int level) {
 	// TODO: the implementation produce unordered list of terrains (which can be a performance issue during the rendering because you want to access adjacent terrains).
 	using std::filesystem::directory_iterator;
 	using std::regex, std::smatch, std::regex_match;
@@ -64,10 +119,10 @@ vector<terrain> terrain_grid::load_level_tiles(path const & data_path, int level
 	path const tile_directory = data_path;
 	if (!exists(tile_directory)) {
 		spdlog::error("tile directory '{}' does not exists", tile_directory.c_str());
-		return {};
+		return 0;
 	}
 
-	vector<terrain> terrains;
+	size_t tile_count = 0;
 
 	// - make a list of tiles froom tiles_directory
 	// - we expect `.+_elev_C_R.tif` and `.+_rgb_C_R.tif` tile files there
@@ -95,92 +150,498 @@ vector<terrain> terrain_grid::load_level_tiles(path const & data_path, int level
 			}
 			// TODO: this is super slow implementation, we should search in a list of tile files
 
-			// - calculate terrain word position
-			int const column = stoi(column_str),
-				row = stoi(row_str);
-
-			// TODO: there we need level to proper calculate grid position
-			float const level_quad_size = (2.0f*quad_size) / pow(2, level-1);  // TODO: equation works for level 2 and 3, later we neeed to agree on a leveling
-			vec2 const word_pos = to_word_position(column, row, level, level_quad_size);
-
-			// - load elevation tile
-			auto const elevation_tile = create_texture_16b(file);
-			assert(is_square(elevation_tile) && "we expect square elevation tiles");
-			// TODO: we do noot have level information to check elevation tile size
-			// assert(size_t(_elevation_tile_size) == get<1>(elevation_tile) && "unexpected elevation tile size");
-
-			// - load satellite tile
-			auto const satellite_tile = create_texture_8b(satellite_path);
-			assert(is_square(satellite_tile));
-			// TODO: check satellite tile size
-
-			// - create terrain instance and filll maps and position
-			terrain trn;
-			trn.elevation_map = get_tid(elevation_tile);
-			trn.satellite_map = get_tid(satellite_tile);
-			trn.position = word_pos;
-			trn.grid_c = column;
-			trn.grid_r = row;
-
-			// - calculate elevation max value
-			trn.elevation_min = _elevation_tile_max_value.at(file.filename());  // TODO: can thrrow std::out_of_range
-
-			// - add to the terrain quad tree
-			terrains.push_back(trn);
+			// - elevation and satellite tile can be requested
+			add_available(stoi(column_str), stoi(row_str), level, {.file=file, .level=overview},
+				{.file=satellite_path, .level=overview});
+			++tile_count;
 		}
 	}
 
-	return terrains;
+	return tile_count;
+}
+
+void terrain_grid::add_available(int column, int row, int level, tile_image_source const & elevation,
+	tile_image_source const & satellite) {
+
+	// dataset description refers tiles by the original tile file names
+	path const elevation_file = fmt::format("{}{}_{}.tif", _elevation_tile_prefix, column, row);
+	_available.insert_or_assign(tile_id{.level=level, .column=column, .row=row}, available_tile{
+		.elevation = elevation,
+		.satellite = satellite,
+		.elevation_max = static_cast<float>(_elevation_tile_max_value.at(elevation_file)),  // TODO: can thrrow std::out_of_range
+		.elevation_min = static_cast<float>(_elevation_tile_min_value.at(elevation_file))
+	});
+}
+
+void terrain_grid::request_tile(tile_id const & id) {
+	auto node = _available.extract(id);
+	assert(node && "available tile expected");
+	available_tile const & tile = node.mapped();
+
+	if (!_loader) {
+		_cache = make_unique<tile_cache>(cache_budget);
+		_streamer = make_unique<texture_streamer>();
+		_loader = make_unique<tile_loader>(0, _cache.get());
+	}
+
+	terrain trn;
+	trn.elevation_map = trn.satellite_map = trn.normal_map = 0;  // created by upload_loaded_tiles()
+	trn.position = to_word_position(id.column, id.row, id.level, level_quad_size(id.level));
+	trn.grid_c = id.column;
+	trn.grid_r = id.row;
+	trn.level = id.level;
+	trn.elevation_min = tile.elevation_max;
+	trn.elevation_lowest = tile.elevation_min;
+
+	_requested.insert_or_assign(id, trn);
+	// overview pixel is filtered from 2^overview tile pixels (elevation_pixel_size() keeps tile area instead)
+	double const normal_map_pixel_size = _data_desc.at(id.level).elevation_pixel_size * (1u << overview);
+	_loader->request({.id=id, .dataset=_dataset, .elevation=tile.elevation, .satellite=tile.satellite,
+		.normal_map_pixel_size=normal_maps ? static_cast<float>(normal_map_pixel_size) : 0.0f});
+}
+
+void terrain_grid::request_children(tile_id const & parent) {
+	if (_refining.contains(parent) || _unrefinable.contains(parent))
+		return;  // already requested or can not be refined
+
+	if (!_data_desc.contains(parent.level+1))
+		return;  // the deepest dataset level
+
+	tile_id const children[4] = {
+		{.level=parent.level+1, .column=2*parent.column, .row=2*parent.row},
+		{.level=parent.level+1, .column=2*parent.column+1, .row=2*parent.row},
+		{.level=parent.level+1, .column=2*parent.column, .row=2*parent.row+1},
+		{.level=parent.level+1, .column=2*parent.column+1, .row=2*parent.row+1}
+	};
+
+	// children are attached all at once, terrains with children missing in the dataset can not be refined
+	if (!std::ranges::all_of(children, [this](tile_id const & id){return _available.contains(id);})) {
+		mark_unrefinable(parent);
+		return;
+	}
+
+	for (tile_id const & id : children)
+		request_tile(id);
+
+	_refining.insert(parent);
 }
 
 size_t terrain_grid::size() const {
 	return _terrain_count;
 }
 
+size_t terrain_grid::collect_visible(frustum const & view, vec3 const & scale, lod_selection const & lod,
+	vector<terrain const *> & visible) {
+
+	if (_root.is_leaf())
+		return 0;  // nothing uploaded yet
+
+	size_t tested = 0;
+	vector<terrain_quad const *> nodes;
+	vector<tile_id> refinable;
+	select(_root, view, scale, lod, false, nodes, refinable, tested);
+
+	// finer terrains are loaded only for visible terrains with not enough details
+	for (tile_id const & id : refinable)
+		request_children(id);
+
+	// stitched terrain meshes match one level difference (see coarser_neighbour_edges())
+	map<tile_id, terrain_quad const *> selected;
+	for (terrain_quad const * node : nodes)
+		selected.emplace(id_of(node->data), node);
+	restrict_levels(view, scale, selected);
+
+	for (auto const & [id, node] : selected)
+		visible.push_back(&node->data);
+
+	return tested;
+}
+
+void terrain_grid::select(terrain_quad const & node, frustum const & view, vec3 const & scale, lod_selection const & lod,
+	bool inside, vector<terrain_quad const *> & selected, vector<tile_id> & refinable, size_t & tested) const {
+
+	geom::box3 const world_bounds{node.bounds.min_corner() * scale, node.bounds.max_corner() * scale};
+
+	if (!inside) {  // subtree fully inside of the view does not need to be tested
+		containment const result = classify(view, world_bounds);
+		++tested;
+		if (result == containment::outside)
+			return;  // skip whole subtree
+		inside = result == containment::inside;
+	}
+
+	bool refine = true;  // root has no terrain, it is always refined
+	if (&node != &_root) {
+		// projected error, camera inside of the bounds needs the most detailed terrains
+		vec3 const closest = glm::clamp(lod.eye, world_bounds.min_corner(), world_bounds.max_corner());
+		float const distance = glm::length(closest - lod.eye),
+			pixels = geometric_error(node, scale, lod.mesh_resolution) * lod.screen_factor / distance;
+		refine = distance == 0.0f || pixels > lod.pixel_error;
+	}
+
+	if (refine && node.is_leaf() && &node != &_root) {  // children not loaded yet
+		refinable.push_back(id_of(node.data));
+		refine = false;
+	}
+
+	if (!refine) {
+		selected.push_back(&node);
+		return;
+	}
+
+	for (auto const & child : node.children)
+		select(*child, view, scale, lod, inside, selected, refinable, tested);
+}
+
+void terrain_grid::restrict_levels(frustum const & view, vec3 const & scale,
+	map<tile_id, terrain_quad const *> & selected) const {
+
+	constexpr int neighbours[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};  // (column, row) offsets
+
+	std::set<tile_id> coarsened;  // terrains selected instead of their subtree, they are not refined again
+	vector<tile_id> pending;  // terrains to check
+	for (auto const & [id, node] : selected)
+		pending.push_back(id);
+
+	while (!empty(pending)) {
+		tile_id const id = pending.back();
+		pending.pop_back();
+		if (!selected.contains(id))
+			continue;  // refined or coarsened meanwhile
+
+		for (auto const [dc, dr] : neighbours) {
+			// neighbour area covered by a terrain two or more levels coarser
+			auto coarse = end(selected);
+			for (int up = 2; up < id.level && coarse == end(selected); ++up)
+				coarse = selected.find(tile_id{.level=id.level-up, .column=(id.column + dc) >> up, .row=(id.row + dr) >> up});
+
+			if (coarse == end(selected))
+				continue;
+
+			auto const [coarse_id, coarse_node] = *coarse;
+			if (!coarse_node->is_leaf() && !coarsened.contains(coarse_id)) {  // refine coarse neighbour
+				selected.erase(coarse);
+				for (auto const & child : coarse_node->children) {
+					geom::box3 const world_bounds{child->bounds.min_corner() * scale, child->bounds.max_corner() * scale};
+					if (classify(view, world_bounds) == containment::outside)
+						continue;
+
+					selected.emplace(id_of(child->data), child.get());
+					pending.push_back(id_of(child->data));
+				}
+			}
+			else {  // neighbour can not be refined (e.g. sparse dataset), select terrain ancestor one level finer instead
+				int const shift = id.level - (coarse_id.level + 1);
+				tile_id const ancestor = {.level=coarse_id.level + 1, .column=id.column >> shift, .row=id.row >> shift};
+				std::erase_if(selected, [&ancestor](auto const & kv){return is_within(kv.first, ancestor);});
+				terrain_quad const * ancestor_node = find_node(ancestor);
+				assert(ancestor_node && "ancestor of a selected terrain expected in the quadtree");
+				selected.emplace(ancestor, ancestor_node);
+				coarsened.insert(ancestor);
+
+				// finer neighbours of the ancestor needs to be checked again
+				for (auto const & [selected_id, node] : selected)
+					pending.push_back(selected_id);
+			}
+
+			pending.push_back(id);  // check the terrain again
+			break;
+		}
+	}
+}
+
+float terrain_grid::geometric_error(terrain_quad const & node, vec3 const & scale, int mesh_resolution) const {
+	assert(mesh_resolution > 1);
+
+	/* Terrain is rendered as NxN vertex mesh regardless of a level, vertex spacing halves with each level. Mesh
+	can miss elevation changes up to (elevation range / mesh cells) and can not show more details than an elevation
+	texel. */
+	float const height_error = geom::depth(node.bounds) * scale.z / (mesh_resolution - 1),
+		texel_error = geom::width(node.bounds) * scale.x / elevation_tile_size(node.data.level);
+
+	return std::max(height_error, texel_error);
+}
+
 void terrain_grid::load_tiles(path const & data_path) {
-	// load terrains, for now let's assume level 2 and 3 only
-	auto const data_l2_path = data_path/"level2";
+	_dataset = data_path.string();
+
+	if (is_regular_file(data_path))  // levels are stored in a single tile pack file instead of level directories
+		_pack = make_unique<tile_pack>(data_path);  // tiles are loaded (streamed) from the mapped pack
+
+	// reads level dataset description file first and then lists level tiles
+	auto list_level = [&](int level) -> size_t {
+		if (_pack) {
+			pack_level const content = read_pack_level(*_pack, level, overview);
+			std::istringstream desc{string{content.description}};
+			load_description(desc, level);
+			for (pack_terrain_tile const & tile : content.tiles)
+				add_available(tile.column, tile.row, level, tile.elevation, tile.satellite);
+			return std::size(content.tiles);
+		}
+
+		path const level_path = data_path/fmt::format("level{}", level);
+		load_description(level_path, level);
+		return list_level_tiles(level_path, level);
+	};
+
+	auto level_available = [&](int level) {
+		return _pack ? !empty(_pack->description(level)) : exists(data_path/fmt::format("level{}", level));
+	};
+
+	/* only descriptions and tile lists are read for all levels, tile data of deeper levels are requested
+	on demand by collect_visible() */
+	int level = 2;  // the first level under the quadtree root
+	for (; level_available(level); ++level) {
+		// level description data are keyed by tile file names, which are the same for all levels
+		_elevation_tile_max_value.clear();  // TODO: here we do not realy want to free resources there (this is sloow, we only want to set map size to 0)
+		_elevation_tile_min_value.clear();
+
+		size_t const count = list_level(level);
+		spdlog::info("level {} {} tiles available", level, count);
+	}
+
+	if (level == 2)
+		throw std::runtime_error{fmt::format("no dataset levels found in '{}'", data_path.c_str())};
+
+	// level 2 terrains are always rendered (quadtree is constructed by upload_loaded_tiles())
+	tile_id const root = {.level=1, .column=0, .row=0};
+	request_children(root);
+	if (_unrefinable.contains(root))
+		throw std::runtime_error{fmt::format("level 2 tiles are missing in '{}' dataset", data_path.c_str())};
+}
+
+size_t terrain_grid::upload_loaded_tiles(size_t byte_budget) {
+	if (!_loader)
+		return 0;
+
+	// start streaming of loaded tiles (keep about one call budget in the upload queue)
+	while (_streamer->queued_bytes() + _posted_bytes < byte_budget) {
+		std::optional<loaded_tile> tile = _loader->poll();
+		if (!tile)
+			break;
+
+		if (!empty(tile->error)) {
+			spdlog::error("level {} tile ({}, {}) loading failed: {}", tile->id.level, tile->id.column, tile->id.row,
+				tile->error);
+			_requested.erase(tile->id);
+			mark_unrefinable(parent_of(tile->id));  // siblings can not be attached without the tile
+			continue;
+		}
+
+		if (!attachable(tile->id)) {  // e.g. sibling failed to load, do not upload
+			_requested.erase(tile->id);
+			continue;
+		}
+
+		int const level = tile->id.level;
+		tiff_data_desc const & elevation_desc = tile->elevation.desc,
+			& satellite_desc = tile->satellite.desc;
+		assert(elevation_desc.width == elevation_desc.height && "we expect square elevation tiles");
+		assert(size_t(elevation_tile_size(level)) == elevation_desc.width && "unexpected elevation tile size");
+		assert(satellite_desc.width == satellite_desc.height);
+
+		if (upload_thread) {
+			post_upload(*tile);
+			continue;
+		}
+
+		// images are top-down rows, shaders flip t coordinate (see top_down_rows uniform)
+		texture_storage const elevation = create_texture_storage_16b(elevation_desc),
+			satellite = create_texture_storage_8b(satellite_desc);
+		_streamer->push(elevation, tile->elevation);
+
+		terrain & trn = _requested.at(tile->id);
+		if (tile->normals.data()) {  // baked normal map
+			texture_storage const normals = create_normal_map_storage(tile->normals.desc);
+			_streamer->push(normals, tile->normals);
+			trn.normal_map = normals.texture;
+		}
+
+		_streamer->push(satellite, tile->satellite);  // the last one, tile is uploaded with satellite texture
+
+		trn.elevation_map = elevation.texture;
+		trn.satellite_map = satellite.texture;
+		_streamed[satellite.texture] = tile->id;
+	}
+
+	size_t uploaded = upload_thread ? upload_thread->poll() : 0;  // terrains uploaded by the upload thread
+	for (texture_storage const & texture : _streamer->upload(byte_budget)) {
+		auto streamed = _streamed.extract(texture.texture);
+		if (!streamed)
+			continue;  // elevation texture, tile is uploaded with satellite texture
+
+		auto node = _requested.extract(streamed.mapped());
+		assert(node && "unexpected tile");
+		add_uploaded(node.key(), node.mapped());
+		++uploaded;
+	}
+
+	if (uploaded > 0)
+		attach_uploaded_terrains();
 
-	load_description(data_l2_path, 2);  // read dataset description file for level 2 tiles
+	return uploaded;
+}
 
-	vector<terrain> terrains_l2 = load_level_tiles(data_l2_path, 2);
+void terrain_grid::post_upload(loaded_tile const & tile) {
+	struct textures {
+		GLuint elevation_map = 0,
+			satellite_map = 0,
+			normal_map = 0;
+	};
+
+	auto uploaded = std::make_shared<textures>();  // written by upload thread, read by ready function
+	size_t const tile_bytes = tile.elevation.size() + tile.satellite.size() + (tile.normals.data() ? tile.normals.size() : 0);
+
+	// images are top-down rows, shaders flip t coordinate (see top_down_rows uniform)
+	upload_thread->post(
+		[uploaded, elevation = tile.elevation, satellite = tile.satellite, normals = tile.normals]{  // upload thread
+			uploaded->elevation_map = create_texture_16b(elevation.data(), elevation.desc, row_order::top_down);
+			uploaded->satellite_map = create_texture_8b(satellite.data(), satellite.desc, row_order::top_down);
+			if (normals.data())
+				uploaded->normal_map = create_normal_map_texture(normals.data(), normals.desc);
+		},
+		[this, uploaded, id = tile.id, tile_bytes](string const & error){  // render thread, textures are ready
+			_posted_bytes -= tile_bytes;
+			if (!empty(error)) {
+				spdlog::error("level {} tile ({}, {}) upload failed: {}", id.level, id.column, id.row, error);
+				glDeleteTextures(1, &uploaded->elevation_map);
+				glDeleteTextures(1, &uploaded->satellite_map);
+				glDeleteTextures(1, &uploaded->normal_map);
+				_requested.erase(id);
+				mark_unrefinable(parent_of(id));  // siblings can not be attached without the tile
+				return;
+			}
 
-	// construct level 2 quad tree
-	assert(std::size(terrains_l2) == 4 && "this sample expect 4 level 2 quadtree tiles");
-	for (terrain & trn : terrains_l2) {
-		int const idx = trn.grid_c + trn.grid_r * 2;
-		assert(idx <= 4 && "four terrains are expected, not more");
-		trn.level = 2;
-		unique_ptr<terrain_quad> quad = make_unique<terrain_quad>();
-		quad->data = trn;
-		_root.children[idx] = std::move(quad);
+			auto node = _requested.extract(id);
+			assert(node && "unexpected tile");
+			terrain & trn = node.mapped();
+			trn.elevation_map = uploaded->elevation_map;
+			trn.satellite_map = uploaded->satellite_map;
+			trn.normal_map = uploaded->normal_map;
+			add_uploaded(id, trn);
+		},
+		[uploaded]{  // render thread, dropped job (see gl_upload_thread::cancel())
+			glDeleteTextures(1, &uploaded->elevation_map);
+			glDeleteTextures(1, &uploaded->satellite_map);
+			glDeleteTextures(1, &uploaded->normal_map);
+		});
+
+	_posted_bytes += tile_bytes;
+}
+
+void terrain_grid::attach_uploaded_terrains() {
+	auto attach = [this](terrain_quad & parent, vector<terrain> const & siblings) {
+		for (terrain const & trn : siblings) {
+			int const idx = child_index(trn.grid_c, trn.grid_r);
+			assert(!parent.children[idx] && "four different siblings expected");
+			unique_ptr<terrain_quad> quad = make_unique<terrain_quad>();
+			quad->data = trn;
+			quad->bounds = terrain_bounds(trn);
+			parent.children[idx] = std::move(quad);
+			_depth = std::max(_depth, trn.level);
+		}
+		_terrain_count += std::size(siblings);
+	};
+
+	// siblings are attached at once so quadtree leaves always cover the whole parent terrain, attaching
+	// terrains can make their (already uploaded) children attachable
+	bool attached = true;
+	while (attached) {
+		attached = false;
+		for (auto it = begin(_uploaded); it != end(_uploaded);) {
+			auto const & [parent_id, siblings] = *it;
+			terrain_quad * parent = find_node(parent_id);
+			if (std::size(siblings) < 4 || !parent || !parent->is_leaf()) {
+				++it;
+				continue;
+			}
+
+			assert(std::size(siblings) == 4 && "four siblings expected, not more");
+			attach(*parent, siblings);
+			spdlog::info("level {} terrains ({}, {}) attached", parent_id.level + 1, parent_id.column, parent_id.row);
+			it = _uploaded.erase(it);
+			attached = true;
+		}
 	}
-	_terrain_count += std::size(terrains_l2);
-	// TODO: cheeck all children are assigned (we need to do that, becaause grid_c or grid_r can goes wrong
 
-	// TODO: before we can load next level we somehow need to deal with description data from previous level stored as _elevation_tile_size, _satellite_tile_size, ...
-	_elevation_tile_max_value.clear();  // TODO: here we do not realy want to free resources there (this is sloow, we only want to set map size to 0)
+	if (!_root.is_leaf())
+		update_bounds(_root);
+}
+
+void terrain_grid::add_uploaded(tile_id const & id, terrain const & trn) {
+	if (attachable(id))
+		_uploaded[parent_of(id)].push_back(trn);
+	else  // sibling failed to load while the terrain was uploaded
+		delete_textures(trn);
+}
 
-	auto const data_l3_path = data_path/"level3";
-	load_description(data_l3_path, 3);
+void terrain_grid::mark_unrefinable(tile_id const & parent) {
+	if (!_unrefinable.insert(parent).second)
+		return;  // already marked
 
-	// construct level 3 quad tree
-	vector<terrain> terrains_l3 = load_level_tiles(data_l3_path, 3);
-	assert(std::size(terrains_l3) == 4 && "this saample expect 4 level 3 quadtree tiles");
-	auto & root = _root.children[0];
-	for (terrain & trn : terrains_l3) {
-		int const idx = trn.grid_c + trn.grid_r * 2;
-		assert(idx <= 4 && "four terrains are expected, not more");
-		trn.level = 3;
-		unique_ptr<terrain_quad> quad = make_unique<terrain_quad>();
-		quad->data = trn;
-		root->children[idx] = std::move(quad);
+	spdlog::warn("level {} terrain ({}, {}) can not be refined, some of its children are not available", parent.level,
+		parent.column, parent.row);
+
+	// subtree terrains waiting for siblings would never be attached
+	for (auto it = begin(_uploaded); it != end(_uploaded);) {
+		if (!is_within(it->first, parent)) {
+			++it;
+			continue;
+		}
+
+		for (terrain const & trn : it->second)
+			delete_textures(trn);
+		it = _uploaded.erase(it);
 	}
 }
 
+bool terrain_grid::attachable(tile_id const & id) const {
+	for (tile_id parent = parent_of(id); parent.level >= 1; parent = parent_of(parent))
+		if (_unrefinable.contains(parent))
+			return false;
+	return true;
+}
+
+terrain_quad * terrain_grid::find_node(tile_id const & id) {
+	return const_cast<terrain_quad *>(std::as_const(*this).find_node(id));
+}
+
+terrain_quad const * terrain_grid::find_node(tile_id const & id) const {
+	terrain_quad const * node = &_root;  // level 1
+	for (int level = 2; level <= id.level; ++level) {
+		if (node->is_leaf())
+			return nullptr;  // level not yet attached
+
+		int const shift = id.level - level;
+		node = node->children[child_index(id.column >> shift, id.row >> shift)].get();
+	}
+	return node;
+}
+
+float terrain_grid::level_quad_size(int level) const {
+	return (2.0f*quad_size) / pow(2, level-1);  // level grid covers 2*quad_size area
+}
+
+geom::box3 terrain_grid::terrain_bounds(terrain const & trn) const {
+	// elevations are in meters, tile covers elevation_tile_size pixels of elevation_pixel_size meters
+	float const size = level_quad_size(trn.level),
+		meters_to_grid = size / (elevation_pixel_size(trn.level) * elevation_tile_size(trn.level)),
+		lowest = trn.elevation_lowest * meters_to_grid,
+		height = trn.elevation_min * meters_to_grid;  // elevation_min is tile max elevation
+
+	return geom::box3{vec3{trn.position, lowest}, vec3{trn.position + size, height}};
+}
+
 void terrain_grid::load_description(path const & data_path, int level) {
+	std::ifstream in{data_path/"dataset.json"};
+	if (!in.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' dataset description file", (data_path/"dataset.json").c_str())};
+	load_description(in, level);
+}
+
+void terrain_grid::load_description(std::istream & in, int level) {
 	boost::property_tree::ptree config;  // TODO: rename to dataset
-	boost::property_tree::read_json(data_path/"dataset.json", config);
+	boost::property_tree::read_json(in, config);
 
 	/* TODO properties are mandatory otherwisee
 	terminate called after throwing an instance of 'boost::wrapexcept<boost::property_tree::ptree_bad_path>'
@@ -196,15 +657,24 @@ void terrain_grid::load_description(path const & data_path, int level) {
 	_data_desc[level] = desc;
 
 	// create list of elevation max values
-	for (auto const & kv : config.get_child("files"))  // TODO: this is work for transsform
+	for (auto const & kv : config.get_child("files")) {  // TODO: this is work for transsform
 		_elevation_tile_max_value.insert(pair{path{kv.first}, kv.second.get<int>("maxval")});  // TODO: emplace?
+		_elevation_tile_min_value.insert(pair{path{kv.first}, kv.second.get<int>("minval", 0)});  // optional (not in older datasets)
+	}
 }
 
 terrain_grid::~terrain_grid() {
-	for (terrain const & trn : leaf_view{_root}) {  // TODO: terrain is now owner of textures so it is terrain responsibility to delete textures
-		glDeleteTextures(1, &trn.elevation_map);
-		glDeleteTextures(1, &trn.satellite_map);
-	}
+	if (upload_thread)
+		upload_thread->cancel();  // posted jobs read pack payloads
+
+	delete_textures(_root);  // TODO: terrain is now owner of textures so it is terrain responsibility to delete textures
+
+	for (auto const & [parent, terrains] : _uploaded)  // uploaded terrains not yet in the quadtree
+		for (terrain const & trn : terrains)
+			delete_textures(trn);
+
+	for (auto const & [id, trn] : _requested)  // streamed terrains (texture 0 is ignored)
+		delete_textures(trn);
 }
 
 
@@ -216,4 +686,49 @@ vec2 to_word_position(int column, int row, int level, float quad_size) {
 	return position;
 }
 
+void update_bounds(terrain_quad & node) {
+	if (node.is_leaf())
+		return;
+
+	node.bounds = geom::make_inverse<geom::box3>();
+	for (auto const & child : node.children) {
+		assert(child && "all four children expected");
+		update_bounds(*child);
+		geom::expand(node.bounds, child->bounds);
+	}
+}
+
+tile_id id_of(terrain const & trn) {
+	return tile_id{.level=trn.level, .column=trn.grid_c, .row=trn.grid_r};
+}
+
+tile_id parent_of(tile_id const & id) {
+	return tile_id{.level=id.level-1, .column=id.column/2, .row=id.row/2};
+}
+
+int child_index(int column, int row) {
+	return (column % 2) + (row % 2) * 2;
+}
+
+bool is_within(tile_id const & id, tile_id const & ancestor) {
+	int const shift = id.level - ancestor.level;
+	return shift >= 0 && (id.column >> shift) == ancestor.column && (id.row >> shift) == ancestor.row;
+}
+
+void delete_textures(terrain_quad const & node) {
+	for (auto const & child : node.children) {
+		if (!child)
+			continue;
+
+		delete_textures(child->data);
+		delete_textures(*child);
+	}
+}
+
+void delete_textures(terrain const & trn) {
+	glDeleteTextures(1, &trn.elevation_map);
+	glDeleteTextures(1, &trn.satellite_map);
+	glDeleteTextures(1, &trn.normal_map);
+}
+
 }  // namespace
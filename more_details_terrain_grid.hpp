@@ -1,18 +1,32 @@
 #include <filesystem>
+#include <istream>
 #include <map>
+#include <memory>
 #include <ranges>
+#include <set>
 #include <stack>
 #include <vector>
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 #include <GLES3/gl32.h>
+#include "geometry/box3.hpp"
+#include "frustum.hpp"
+#include "gl_upload_thread.hpp"
+#include "tiff.hpp"
+#include "texture_streamer.hpp"
+#include "tile_cache.hpp"
+#include "tile_loader.hpp"
+#include "tile_pack.hpp"
 
 /* - we are expecting that all terrains has the same size textures so thre is no reason to store texture w/h
 - grid_size is also the same for all terrain */
 struct terrain {
 	GLuint elevation_map,
-		satellite_map;
+		satellite_map,
+		normal_map;  //!< Baked normal map in case of terrain_grid::normal_maps, otherwise 0.
 	glm::vec2 position;  //!< Terrain word position (within thee grid).
 	float elevation_min;  // TODO: use terrain related value there, TODO: rename to eelevation_max
+	float elevation_lowest = 0;  //!< Tile min elevation (dataset `minval`), 0 in case dataset does not provide it.
 
 	int grid_c, grid_r;  // TODO: grid position for debug
 	int level = -1;  //!< Terrain level of detail (it is actually quadtree level/depth).
@@ -22,12 +36,22 @@ struct terrain {
 E.g. To figure out whether camera is above a terrain. */
 bool is_above(terrain const & trn, float quad_size, float model_scale, glm::vec3 const & pos);
 
+/*! \returns Terrain edges (`quad_edge` flags, see `quad.hpp`) shared with a lower level (coarser) terrain of
+\c selected terrains, these edges needs to be stitched to avoid cracks between terrain meshes.
+\note Stitching matches one level difference, neighbour terrains are expected to differ by one level at
+most (see terrain_grid::collect_visible()). */
+unsigned coarser_neighbour_edges(terrain const & trn, std::set<tile_id> const & selected);
+
 struct terrain_quad {
 	using value_type = terrain;
 
 	std::array<std::unique_ptr<terrain_quad>, 4> children;
 	bool is_leaf() const {return children[0] == nullptr;}
 	value_type data;  // TODO: _data is hard to understand what we are working with, find a bether name
+
+	/*! Node (whole subtree) bounds in grid units, terrain tile from its min up to its max elevation (not
+	scaled by model and height scale, see terrain_grid::collect_visible()). */
+	geom::box3 bounds;
 };
 
 // TODO: we need a projection for terrain_quad -> terrain for leaf_view
@@ -37,6 +61,7 @@ template <typename Node>
 class leaf_view : public std::ranges::view_interface<leaf_view<Node>> {
 public:
 	explicit leaf_view(Node & root) : root(&root) {}
+	explicit leaf_view(Node * root) : root(root) {}  //!< Empty view for nullptr root.
 
 	struct iterator {
 		using value_type = Node::value_type;
@@ -93,6 +118,14 @@ private:
 };
 
 
+//! Screen space error LOD selection parameters (see terrain_grid::collect_visible()).
+struct lod_selection {
+	glm::vec3 eye;  //!< Camera position in world space.
+	float screen_factor;  //!< Distance to pixels factor, viewport height / (2*tan(fovy/2)).
+	float pixel_error = 4.0f;  //!< Max allowed projected geometric error in pixels.
+	int mesh_resolution;  //!< Terrain quad mesh resolution (NxN vertices).
+};
+
 // TODO: elevation_min data are missing during load_tiles in a grid
 struct terrain_grid {
 	/* TODO: should be read_tiles member of terrain_grid? I think in the first step it is easier to
@@ -101,8 +134,28 @@ struct terrain_grid {
 
 	// TODO: check that elevation tiles are all the same (width, height), the same for satellite tiles
 	// TODO: we want to get rid og elevation_tile_prefix and satellite_tile_prefix they should be read from data_path config file
+	/*! Reads dataset levels descriptions and requests level 2 tiles loading (tiles are loaded in background),
+	loaded tiles needs to be uploaded by upload_loaded_tiles() call. Deeper level tiles are requested on demand
+	by collect_visible().
+	\param data_path Dataset directory (with `level2`, `level3`, ... subdirectories) or tile pack file (see `pack_tiles`).
+	Levels are read from level 2 until the first missing level, tile column and row are level grid positions
+	(level N grid has 2^(N-1) x 2^(N-1) tiles, not all of them needs to be available). */
 	void load_tiles(std::filesystem::path const & data_path);
-	[[nodiscard]] size_t size() const;
+
+	/*! Streams loaded tiles into textures (see `texture_streamer.hpp`), uploads at most `byte_budget` bytes
+	per call. Terrains become renderable (are added to the quadtree) once all four siblings are uploaded and
+	their parent terrain is in the quadtree. Expected to be called once per frame from the OpenGL context thread. With `upload_thread`
+	textures are created by the upload thread instead of streaming (at most `byte_budget` bytes are waiting
+	for the upload thread).
+	\returns Number of uploaded tiles. */
+	size_t upload_loaded_tiles(size_t byte_budget = 8*1024*1024);
+
+	[[nodiscard]] size_t size() const;  //!< \returns Number of renderable terrains.
+	[[nodiscard]] size_t loading() const {return std::size(_requested);}  //!< \returns Number of requested not yet uploaded terrains.
+	[[nodiscard]] size_t upload_queue_depth() const {  //!< \returns Number of textures waiting for upload.
+		return (_streamer ? _streamer->queue_depth() : 0) + (upload_thread ? 2*upload_thread->pending() : 0);
+	}
+	[[nodiscard]] tile_cache::statistics cache_stats() const {return _cache ? _cache->stats() : tile_cache::statistics{};}
 
 	/*! \returns Range to iterate through list of terrains.
 	\code
@@ -112,25 +165,102 @@ struct terrain_grid {
 	\endcode */
 	[[nodiscard]] auto iterate() const {
 		//return std::ranges::subrange{std::begin(_terrains), std::end(_terrains)};
-		return leaf_view{_root};
+		return leaf_view<terrain_quad const>{_root.is_leaf() ? nullptr : &_root};  // empty until level 2 is uploaded
 	}
 
+	/*! Selects terrains to render with hierarchical view frustum culling and screen space error LOD
+	selection, adds selected terrains intersecting \c view into \c visible. Subtrees outside of the view
+	are skipped and subtrees fully inside of the view are not tested anymore. Node is refined (its children
+	are selected instead) while its projected geometric error is bigger than `lod.pixel_error`. Selected
+	neighbour terrains differ by one level at most (restricted quadtree, see coarser_neighbour_edges()).
+	Children of selected leaf terrains which needs to be refined are requested for loading (see load_tiles()).
+	\param scale Grid to world scale (model scale for x, y and model scale times height scale for z).
+	\returns Number of tested quadtree nodes. */
+	size_t collect_visible(frustum const & view, glm::vec3 const & scale, lod_selection const & lod,
+		std::vector<terrain const *> & visible);
+
+	[[nodiscard]] geom::box3 terrain_bounds(terrain const & trn) const;  //!< \returns Terrain bounds in grid units.
+	[[nodiscard]] float level_quad_size(int level) const;  //!< \returns Level terrain size in grid units.
+	[[nodiscard]] int depth() const {return _depth;}  //!< \returns The deepest quadtree level with terrains.
+
 	[[nodiscard]] int grid_size(int level) const {return pow(2, level-1);}
-	[[nodiscard]] int elevation_tile_size(int level) const {return _data_desc.at(level).elevation_tile_size;}
-	[[nodiscard]] double elevation_pixel_size(int level) const {return _data_desc.at(level).elevation_pixel_size;}
+	//! \returns Size of loaded elevation tiles (depends on overview, overviews keep elevation tile border).
+	[[nodiscard]] int elevation_tile_size(int level) const {
+		return overview_size(_data_desc.at(level).elevation_tile_size, overview, elevation_tile_border);
+	}
+
+	//! \returns Pixel size of loaded elevation tiles (tile covers the same area for all overviews).
+	[[nodiscard]] double elevation_pixel_size(int level) const {
+		dataset_description const & desc = _data_desc.at(level);
+		return desc.elevation_pixel_size*desc.elevation_tile_size / elevation_tile_size(level);
+	}
 
 	float quad_size = 1.0f;
 
+	/*! Tile overview level loaded by load_tiles(), 0 for full resolution tiles (see `split_tiles --overviews`).
+	TODO: select overview per tile based on a distance from the camera. */
+	unsigned overview = 0;
+
+	/*! Normal maps are baked by tile loader threads (see `normal_map.hpp`) for each loaded tile, needs to be set
+	before load_tiles() call. */
+	bool normal_maps = false;
+
+	size_t cache_budget = 256*1024*1024;  //!< Decoded tile cache (see `tile_cache.hpp`) byte budget used by load_tiles().
+
+	/*! Optional upload thread with shared OpenGL context (see `gl_upload_thread.hpp`) to create tile textures
+	out of the render thread, needs to outlive the grid (posted jobs are canceled by the grid destructor). */
+	gl_upload_thread * upload_thread = nullptr;
+
 	static float camera_ground_height;  //!< Terrain ground height bellow camera. Camera needs to have an access to the property.
 
 	~terrain_grid();
 
 private:
 	void load_description(std::filesystem::path const & data_path, int level);  // TODO: implementation of this needs to be changed
+	void load_description(std::istream & in, int level);
 	int elevation_maxval(std::filesystem::path const & filename) const;
 
-	//! \returns list of loaded terrains (meant to load quadtree level data, e.g. level 2 or 3)
-	std::vector<terrain> load_level_tiles(std::filesystem::path const & data_path, int level) const;
+	//! Adds \c data_path directory level tiles to available tiles. \returns Number of added tiles.
+	size_t list_level_tiles(std::filesystem::path const & data_path, int level);
+
+	//! Adds dataset tile to available tiles (level description needs to be loaded).
+	void add_available(int column, int row, int level, tile_image_source const & elevation, tile_image_source const & satellite);
+
+	void request_tile(tile_id const & id);  //!< Requests available \c id tile loading.
+
+	/*! Requests \c parent terrain children loading, \c parent is marked as unrefinable in case some of
+	its children are not available. */
+	void request_children(tile_id const & parent);
+
+	//! Posts loaded tile textures creation to the upload thread.
+	void post_upload(loaded_tile const & tile);
+
+	//! Adds uploaded terrains to the quadtree (all four siblings at once, parent needs to be in the quadtree).
+	void attach_uploaded_terrains();
+
+	//! Keeps uploaded terrain until its siblings are uploaded (terrain textures are deleted in case it can not be attached).
+	void add_uploaded(tile_id const & id, terrain const & trn);
+
+	/*! Marks \c parent terrain as a leaf for good (e.g. one of its children failed to load), already uploaded
+	terrains of the subtree are deleted and not yet uploaded ones are dropped once loaded. */
+	void mark_unrefinable(tile_id const & parent);
+
+	//! \returns False in case \c id terrain can never be attached (its ancestor is unrefinable).
+	[[nodiscard]] bool attachable(tile_id const & id) const;
+	terrain_quad * find_node(tile_id const & id);  //!< \returns Quadtree node of \c id tile or nullptr.
+	terrain_quad const * find_node(tile_id const & id) const;
+
+	//! \param refinable Selected leaf terrains which needs to be refined (their children are not loaded).
+	void select(terrain_quad const & node, frustum const & view, glm::vec3 const & scale, lod_selection const & lod,
+		bool inside, std::vector<terrain_quad const *> & selected, std::vector<tile_id> & refinable, size_t & tested) const;
+
+	/*! Refines (or coarsens in case of not refinable neighbour) \c selected terrains so that neighbour terrains
+	differ by one level at most, children outside of \c view are not selected. */
+	void restrict_levels(frustum const & view, glm::vec3 const & scale,
+		std::map<tile_id, terrain_quad const *> & selected) const;
+
+	//! \returns Node geometric error estimation in world units.
+	float geometric_error(terrain_quad const & node, glm::vec3 const & scale, int mesh_resolution) const;
 
 	terrain_quad _root;  //!< terrains in a quadtree structure to allow LOD
 
@@ -147,7 +277,30 @@ private:
 
 	size_t _terrain_count = 0;
 
+	struct available_tile {  //!< Dataset tile not yet requested.
+		tile_image_source elevation,
+			satellite;
+		float elevation_max,
+			elevation_min;
+	};
+
+	std::map<tile_id, available_tile> _available;  //!< Dataset tiles which can be requested (see request_children()).
+	std::set<tile_id> _refining;  //!< Terrains with requested children.
+
 	/* TODO: This is how we work with elevations in a vertx shader program
 	float h = float(texture(heights, position.xy).r) * elevation_scale * height_scale; */
 	std::map<std::filesystem::path, int> _elevation_tile_max_value;  // this serves as a temporary variable for load_description function
+	std::map<std::filesystem::path, int> _elevation_tile_min_value;  //!< the same as _elevation_tile_max_value for `minval`
+
+	std::map<tile_id, terrain> _requested;  //!< Requested terrains without textures (or with streamed textures).
+	std::map<GLuint, tile_id> _streamed;  //!< satellite texture (uploaded after elevation texture) to streamed tile
+	size_t _posted_bytes = 0;  //!< tile bytes waiting for upload thread
+	std::map<tile_id, std::vector<terrain>> _uploaded;  //!< Uploaded terrains not yet in the quadtree (by parent tile).
+	std::set<tile_id> _unrefinable;  //!< Terrains with missing (or failing) children.
+	int _depth = 0;
+	std::string _dataset;  //!< Dataset directory or tile pack file.
+	std::unique_ptr<tile_pack> _pack;  //!< Keeps pack mapped while tiles are loaded.
+	std::unique_ptr<tile_cache> _cache;
+	std::unique_ptr<texture_streamer> _streamer;
+	std::unique_ptr<tile_loader> _loader;  //!< \note needs to be destroyed before _pack and _cache
 };  // terrain_grid
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include "normal_map.hpp"
+
+using std::array, std::byte;
+using glm::vec3, glm::vec2;
+
+decoded_image bake_normal_map(decoded_image const & elevation, float pixel_size, unsigned border) {
+	tiff_data_desc const & desc = elevation.desc;
+	if (desc.bytes_per_sample != 2 || desc.samples_per_pixel != 1)
+		throw std::runtime_error{"only 16bit elevation tiles are supported"};
+
+	assert(border > 0 && "neighbour pixels needed");
+	assert(desc.width > 2*border && desc.height > 2*border);
+	assert(pixel_size > 0);
+
+	size_t const width = desc.width - 2*border,
+		height = desc.height - 2*border;
+
+	auto height_at = [&elevation, &desc](size_t x, size_t y) -> float {
+		uint16_t h;  // pixels are not guaranteed to be aligned (mapped tile pack payload)
+		memcpy(&h, elevation.data() + 2*(y*desc.width + x), sizeof(h));
+		return h;
+	};
+
+	std::shared_ptr<byte[]> normals{new byte[2*width*height]};
+	byte * out = normals.get();
+	for (size_t y = 0; y < height; ++y) {
+		size_t const ey = y + border;  // elevation pixel
+		for (size_t x = 0; x < width; ++x) {
+			size_t const ex = x + border;
+
+			// cross((2*pixel_size, 0, dh_x), (0, 2*pixel_size, dh_y)) scaled by 1/(2*pixel_size)
+			float const dh_x = height_at(ex + 1, ey) - height_at(ex - 1, ey),
+				dh_y = height_at(ex, ey + 1) - height_at(ex, ey - 1);
+			vec3 const n = glm::normalize(vec3{-dh_x, -dh_y, 2.0f*pixel_size});
+
+			array<int8_t, 2> const e = octahedral_encode(n);
+			*out++ = static_cast<byte>(e[0]);
+			*out++ = static_cast<byte>(e[1]);
+		}
+	}
+
+	return decoded_image{
+		.desc = tiff_data_desc{.width=width, .height=height, .bytes_per_sample=1, .samples_per_pixel=2},
+		.pixels = std::move(normals),
+		.mapped = false
+	};
+}
+
+array<int8_t, 2> octahedral_encode(vec3 const & n) {
+	vec2 p = vec2{n.x, n.y} / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+	if (n.z < 0.0f) {  // fold lower hemisphere over diagonals
+		vec2 const sign = {p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f};
+		p = (1.0f - glm::abs(vec2{p.y, p.x})) * sign;
+	}
+
+	auto to_snorm = [](float v) {
+		return static_cast<int8_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 127.0f));
+	};
+
+	return {to_snorm(p.x), to_snorm(p.y)};
+}
+
+vec3 octahedral_decode(array<int8_t, 2> const & e) {
+	vec2 const p = glm::max(vec2{e[0], e[1]} / 127.0f, vec2{-1.0f});  // snorm conversion
+	vec3 n = {p, 1.0f - std::abs(p.x) - std::abs(p.y)};
+	float const t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
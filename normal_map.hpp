@@ -0,0 +1,24 @@
+/*! \file
+Terrain normal maps baked from elevation tiles (once, while tiles are loaded) instead of computing normals
+from elevation differences for each fragment. Normals are stored octahedral encoded in two signed bytes
+(GL_RG8_SNORM texture), so terrain shader needs one texture fetch (see `NORMAL_MAP` in `height_overlap.fs`).
+\code
+decoded_image const normals = bake_normal_map(elevation, pixel_size);  // e.g. in a tile loader thread
+// ...
+GLuint const normal_map = create_normal_map_texture(normals.data(), normals.desc);  // OpenGL context thread (see `texture.hpp`)
+\endcode */
+#pragma once
+#include <array>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include "tile_loader.hpp"
+
+/*! Bakes normal map for 16bit \c elevation tile, normal is calculated from neighbour elevation pixels the same
+way as `height_overlap.fs` does. Tile border pixels (overlap) are used by edge normals, so normals are continuous
+across tiles and normal map is `2*border` pixels smaller than the elevation tile.
+\param pixel_size Elevation pixel size in elevation units (e.g. meters).
+\returns Normal map image (top-down rows as elevation tile), x and y axis goes with elevation image columns and rows. */
+decoded_image bake_normal_map(decoded_image const & elevation, float pixel_size, unsigned border = elevation_tile_border);
+
+std::array<int8_t, 2> octahedral_encode(glm::vec3 const & n);  //!< \returns Unit vector \c n octahedral encoded as two snorm bytes.
+glm::vec3 octahedral_decode(std::array<int8_t, 2> const & e);  //!< \returns Unit vector (GLSL version in `height_overlap.fs`).
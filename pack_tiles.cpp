@@ -0,0 +1,129 @@
+/* Packs dataset directories (elevation and satellite tiles with `dataset.json` description, see
+`split_tiles` and `create_dataset_desc`) into a single tile pack file (see `tile_pack.hpp`). Each
+directory is stored as one pack level (e.g. `level2` directory of `more_details` dataset as level 2),
+tile overviews are packed as well.
+Elevation tiles are encoded with `elevation.codec` dataset description codec ("raw" by default, "dem"
+for the DEM codec, see `dem_codec.hpp`).
+
+Usage: pack_tiles OUTPUT_PACK DATASET_DIR[:LEVEL] [DATASET_DIR[:LEVEL] ...] */
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <tiffio.h>
+#include "tiff.hpp"
+#include "tile_pack.hpp"
+
+using std::vector, std::string, std::size;
+using std::filesystem::path, std::filesystem::directory_iterator;
+using std::ifstream, std::istringstream, std::cerr;
+using std::regex, std::smatch, std::regex_match;
+using fmt::print, fmt::format;
+
+struct pack_input {
+	path dataset_directory;
+	unsigned level = 0;
+};
+
+//! \returns Number of tiles added to the pack.
+size_t pack_dataset(tile_pack_writer & pack, pack_input const & input);
+size_t pack_layer(tile_pack_writer & pack, pack_input const & input, tile_layer layer, string const & prefix,
+	tile_codec codec);
+string read_file(path const & fname);
+pack_input parse_input(string const & arg);
+
+int main(int argc, char * argv[]) {
+	if (argc < 3) {
+		cerr << "usage: pack_tiles OUTPUT_PACK DATASET_DIR[:LEVEL] [DATASET_DIR[:LEVEL] ...]\n";
+		return 1;
+	}
+
+	TIFFSetWarningHandler(nullptr);  // e.g. unknown GeoTIFF tags
+
+	path const pack_file = argv[1];
+	tile_pack_writer pack{pack_file};
+
+	size_t tile_count = 0;
+	for (int i = 2; i < argc; ++i)
+		tile_count += pack_dataset(pack, parse_input(argv[i]));
+
+	pack.finish();
+
+	print("{} created ({} tiles)!\n", pack_file.c_str(), tile_count);
+	return 0;
+}
+
+size_t pack_dataset(tile_pack_writer & pack, pack_input const & input) {
+	string const desc = read_file(input.dataset_directory/"dataset.json");
+
+	boost::property_tree::ptree config;
+	istringstream in{desc};
+	boost::property_tree::read_json(in, config);
+
+	string const elevation_codec = config.get<string>("elevation.codec", "raw");
+
+	size_t const tile_count =
+		pack_layer(pack, input, tile_layer::elevation, config.get<string>("elevation.tile_prefix"),
+			to_tile_codec(elevation_codec))
+		+ pack_layer(pack, input, tile_layer::satellite, config.get<string>("satellite.tile_prefix"), tile_codec::raw);
+
+	pack.add_description(input.level, desc);
+
+	print("{} dataset packed as level {} ({} tiles, {} elevation codec)\n", input.dataset_directory.c_str(),
+		input.level, tile_count, elevation_codec);
+	return tile_count;
+}
+
+size_t pack_layer(tile_pack_writer & pack, pack_input const & input, tile_layer layer, string const & prefix,
+	tile_codec codec) {
+	// note: prefix is expected to be regex safe (e.g. `plzen_elev_`)
+	regex const tile_pattern{prefix + R"((\d+)_(\d+)\.tif)"};  // (column), (row)
+
+	size_t tile_count = 0;
+	for (auto const & dir_entry : directory_iterator{input.dataset_directory}) {
+		path const & file = dir_entry.path();
+		string const filename = file.filename().string();
+		smatch what;
+		if (!regex_match(filename, what, tile_pattern))
+			continue;
+
+		unsigned const column = stoul(what[1].str()),
+			row = stoul(what[2].str());
+
+		// tiles are stored upload ready (tightly packed top-down rows) with all TIFF overviews
+		unsigned const overview_count = tiff_level_count(file);
+		for (unsigned overview = 0; overview < overview_count; ++overview) {
+			auto const [pixels, desc] = load_tiff_desc(file, false, 1, overview);
+			pack.add_tile(input.level, layer, column, row, overview, desc, pixels.get(), codec);
+		}
+
+		++tile_count;
+	}
+
+	return tile_count;
+}
+
+string read_file(path const & fname) {
+	ifstream fin{fname};
+	if (!fin.is_open())
+		throw std::runtime_error{format("can't open '{}' file", fname.c_str())};
+	return string{std::istreambuf_iterator<char>{fin}, std::istreambuf_iterator<char>{}};
+}
+
+pack_input parse_input(string const & arg) {
+	size_t const sep = arg.rfind(':');
+	if (sep == string::npos)
+		return {.dataset_directory = arg};
+
+	return {
+		.dataset_directory = arg.substr(0, sep),
+		.level = unsigned(stoul(arg.substr(sep+1)))
+	};
+}
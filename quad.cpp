@@ -1,10 +1,48 @@
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <vector>
 #include <utility>
 #include <tuple>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include "quad.hpp"
 
-using std::vector, std::tuple, std::pair;
+using std::vector, std::tuple, std::pair, std::span, std::string_view;
+
+namespace {
+
+constexpr unsigned strip_restart_index = 0xffffffffu;  //!< 32 bit primitive restart index (narrowed to 0xffff for 16 bit indices)
+
+//! \returns Indices of w x h vertices quad mesh (two triangles per cell, vertices are stored row by row).
+vector<unsigned> make_quad_indices(unsigned w, unsigned h);
+
+//! \returns The same triangles as make_quad_indices() with cells in Z-order (Morton) curve order.
+vector<unsigned> make_z_order_quad_indices(unsigned w, unsigned h);
+
+/*! \returns Triangle strip for each cells row separated by strip_restart_index, strips form the same triangles
+as make_quad_indices(). */
+vector<unsigned> make_strip_quad_indices(unsigned w, unsigned h);
+
+/*! \returns Triangle list \c indices reordered for a post-transform vertex cache (see "Linear-Speed Vertex Cache
+Optimisation" by Tom Forsyth). */
+vector<unsigned> optimize_vertex_cache(vector<unsigned> const & indices, unsigned vertex_count);
+
+/*! \returns Quad mesh vertex with \c edges stitched, vertex at an odd position of stitched edge is moved to
+the previous (even) edge vertex. */
+unsigned stitched_vertex(unsigned vertex, unsigned w, unsigned h, unsigned edges);
+
+/*! \returns Quad mesh indices with \c edges stitched (see quad_edge), triangles collapsed by stitching
+are removed. */
+vector<unsigned> stitch_indices(vector<unsigned> const & indices, unsigned w, unsigned h, unsigned edges);
+
+/*! \returns Quad mesh strip indices with \c edges stitched, triangles collapsed by stitching stays in strips
+as degenerate triangles (they are not rasterized). */
+vector<unsigned> stitch_strip_indices(vector<unsigned> const & indices, unsigned w, unsigned h, unsigned edges);
+
+}  // namespace
 
 /*! Returns unit quad begins in (0,0) and ends in (1,1) point as vector of (position:3, texcoord:2) pair per vertex and array of indices to form a model.
 To create a OpenGL object use code
@@ -19,7 +57,7 @@ pair<vector<float>, vector<unsigned>> make_quad(unsigned w, unsigned h) {
 	// vertices
 	float const dx = 1.0f/(w-1),
 		dy = 1.0f/(h-1);
-	vector<float> verts((3+2+3)*w*h);  // position:3, texcoord:2
+	vector<float> verts((3+2)*w*h);  // position:3, texcoord:2
 
 	float * vdata = verts.data();
 	for (unsigned j = 0; j < h; ++j) {
@@ -34,24 +72,7 @@ pair<vector<float>, vector<unsigned>> make_quad(unsigned w, unsigned h) {
 		}
 	}
 
-	// indices
-	unsigned const nindices = 2*(w-1)*(h-1)*3;
-	vector<unsigned> indices(nindices);
-	unsigned * idata = indices.data();
-	for (unsigned j = 0; j < h-1; ++j) {
-		unsigned yoffset = j*w;
-		for (unsigned i = 0; i < w-1; ++i) {
-			unsigned n = i + yoffset;
-			*(idata++) = n;
-			*(idata++) = n+1;
-			*(idata++) = n+1+w;
-			*(idata++) = n+1+w;
-			*(idata++) = n+w;
-			*(idata++) = n;
-		}
-	}
-
-	return {verts, indices};
+	return {verts, make_quad_indices(w, h)};
 }
 
 tuple<GLuint, GLuint, GLuint, unsigned> create_quad_mesh(GLint position_loc, unsigned n) {
@@ -86,3 +107,363 @@ void destroy_quad_mesh(GLuint vao, GLuint vbo, GLuint ibo) {
 	glDeleteBuffers(1, &vbo);
 	glDeleteVertexArrays(1, &vao);
 }
+
+string_view to_string(quad_index_order order) {
+	switch (order) {
+		case quad_index_order::row_major: return "row_major";
+		case quad_index_order::z_order: return "z_order";
+		case quad_index_order::vertex_cache: return "vertex_cache";
+		case quad_index_order::strips: return "strips";
+		default: return "unknown";
+	}
+}
+
+float average_cache_miss_ratio(span<unsigned const> indices, GLenum mode, unsigned cache_size, unsigned restart) {
+	assert((mode == GL_TRIANGLES || mode == GL_TRIANGLE_STRIP) && "unsupported primitive mode");
+	assert(cache_size > 0);
+
+	std::deque<unsigned> cache;  // FIFO
+	size_t misses = 0,
+		triangles = 0,
+		strip_length = 0;
+
+	for (unsigned index : indices) {
+		if (mode == GL_TRIANGLE_STRIP && index == restart) {
+			triangles += std::max(strip_length, size_t{2}) - 2;
+			strip_length = 0;
+			continue;
+		}
+
+		++strip_length;
+		if (std::ranges::find(cache, index) != end(cache))
+			continue;  // cache hit
+
+		++misses;
+		cache.push_back(index);
+		if (size(cache) > cache_size)
+			cache.pop_front();
+	}
+
+	if (mode == GL_TRIANGLE_STRIP)
+		triangles += std::max(strip_length, size_t{2}) - 2;
+	else
+		triangles = size(indices) / 3;
+
+	return triangles > 0 ? static_cast<float>(misses) / triangles : 0.0f;
+}
+
+stitched_quad_mesh create_stitched_quad_mesh(GLint position_loc, unsigned n, quad_index_order order) {
+	assert(n % 2 == 1 && "odd resolution expected");
+
+	stitched_quad_mesh mesh;
+	mesh.resolution = n;
+	mesh.order = order;
+	mesh.mode = order == quad_index_order::strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+
+	vector<unsigned> indices;
+	switch (order) {
+		case quad_index_order::z_order: indices = make_z_order_quad_indices(n, n); break;
+		case quad_index_order::strips: indices = make_strip_quad_indices(n, n); break;
+		default: indices = make_quad_indices(n, n); break;  // row_major, vertex_cache
+	}
+
+	// all variants in one index buffer
+	vector<unsigned> variant_indices;
+	for (unsigned edges = 0; edges < quad_edge_variant_count; ++edges) {
+		vector<unsigned> stitched = order == quad_index_order::strips ?
+			stitch_strip_indices(indices, n, n, edges) : stitch_indices(indices, n, n, edges);
+
+		if (order == quad_index_order::vertex_cache)  // stitching changes triangles, so every variant is optimized
+			stitched = optimize_vertex_cache(stitched, n*n);
+
+		if (edges == 0)
+			mesh.acmr = average_cache_miss_ratio(stitched, mesh.mode);
+
+		mesh.variants[edges] = quad_mesh_elements{
+			.offset = static_cast<unsigned>(size(variant_indices)),
+			.count = static_cast<unsigned>(size(stitched))};
+		variant_indices.insert(end(variant_indices), begin(stitched), end(stitched));
+	}
+
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+
+	glGenBuffers(1, &mesh.ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+
+	if (n*n <= 0xffff) {  // 16 bit indices (0xffff is reserved for primitive restart)
+		vector<GLushort> short_indices(size(variant_indices));
+		std::ranges::transform(variant_indices, begin(short_indices), [](unsigned index){
+			return index == strip_restart_index ? GLushort{0xffff} : static_cast<GLushort>(index);
+		});
+
+		mesh.index_type = GL_UNSIGNED_SHORT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size(short_indices)*sizeof(GLushort), short_indices.data(), GL_STATIC_DRAW);
+	}
+	else {
+		mesh.index_type = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size(variant_indices)*sizeof(unsigned), variant_indices.data(), GL_STATIC_DRAW);
+	}
+
+	if (position_loc != -1) {  // otherwise vertex pulling, vertex shader calculates position from gl_VertexID
+		auto const [vertices, quad_indices] = make_quad(n, n);
+
+		glGenBuffers(1, &mesh.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+		glBufferData(GL_ARRAY_BUFFER, size(vertices)*sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+		// bind (x,y,z) data
+		constexpr size_t stride = (3+2)*sizeof(float);
+		glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+		glEnableVertexAttribArray(position_loc);
+	}
+
+	glBindVertexArray(0);  // unbind vertex array
+
+	return mesh;
+}
+
+void destroy_quad_mesh(stitched_quad_mesh const & mesh) {
+	destroy_quad_mesh(mesh.vao, mesh.vbo, mesh.ibo);
+}
+
+quad_mesh_cache::~quad_mesh_cache() {
+	for (auto const & [key, mesh] : _meshes)
+		destroy_quad_mesh(mesh);
+}
+
+stitched_quad_mesh const & quad_mesh_cache::get(unsigned n, quad_index_order order) {
+	auto it = _meshes.find(pair{n, order});
+	if (it == end(_meshes))
+		it = _meshes.emplace(pair{n, order}, create_stitched_quad_mesh(_position_loc, n, order)).first;
+	return it->second;
+}
+
+namespace {
+
+vector<unsigned> make_quad_indices(unsigned w, unsigned h) {
+	unsigned const nindices = 2*(w-1)*(h-1)*3;
+	vector<unsigned> indices(nindices);
+	unsigned * idata = indices.data();
+	for (unsigned j = 0; j < h-1; ++j) {
+		unsigned yoffset = j*w;
+		for (unsigned i = 0; i < w-1; ++i) {
+			unsigned n = i + yoffset;
+			*(idata++) = n;
+			*(idata++) = n+1;
+			*(idata++) = n+1+w;
+			*(idata++) = n+1+w;
+			*(idata++) = n+w;
+			*(idata++) = n;
+		}
+	}
+	return indices;
+}
+
+vector<unsigned> make_z_order_quad_indices(unsigned w, unsigned h) {
+	assert(w <= 0x10000 && h <= 0x10000);
+
+	auto morton = [](unsigned i, unsigned j) -> uint64_t {  // interleaves i and j bits
+		uint64_t key = 0;
+		for (unsigned bit = 0; bit < 16; ++bit)
+			key |= (uint64_t{(i >> bit) & 1u} << (2*bit)) | (uint64_t{(j >> bit) & 1u} << (2*bit + 1));
+		return key;
+	};
+
+	vector<pair<uint64_t, unsigned>> cells;  // (morton key, first cell vertex)
+	cells.reserve((w-1)*(h-1));
+	for (unsigned j = 0; j < h-1; ++j)
+		for (unsigned i = 0; i < w-1; ++i)
+			cells.emplace_back(morton(i, j), i + j*w);
+
+	std::ranges::sort(cells);
+
+	vector<unsigned> indices;
+	indices.reserve(6*size(cells));
+	for (auto const & [key, n] : cells)
+		indices.insert(end(indices), {n, n+1, n+1+w, n+1+w, n+w, n});  // the same triangles as make_quad_indices()
+
+	return indices;
+}
+
+vector<unsigned> make_strip_quad_indices(unsigned w, unsigned h) {
+	vector<unsigned> indices;
+	indices.reserve((h-1)*(2*w + 1));
+	for (unsigned j = 0; j < h-1; ++j) {
+		if (j > 0)
+			indices.push_back(strip_restart_index);
+
+		// (top, bottom) vertex pairs, the first triangle diagonal goes the same way as in make_quad_indices()
+		for (unsigned i = 0; i < w; ++i) {
+			indices.push_back(i + (j+1)*w);
+			indices.push_back(i + j*w);
+		}
+	}
+	return indices;
+}
+
+vector<unsigned> optimize_vertex_cache(vector<unsigned> const & indices, unsigned vertex_count) {
+	assert(size(indices) % 3 == 0);
+	constexpr unsigned cache_size = vertex_cache_size;
+	size_t const triangle_count = size(indices) / 3;
+
+	// score tables (vertex score is called for every cached vertex after each emitted triangle)
+	constexpr unsigned max_valence = 32;
+	std::array<float, cache_size> position_score;
+	for (unsigned i = 0; i < cache_size; ++i) {
+		position_score[i] = i < 3 ?
+			0.75f :  // used by the last triangle
+			std::pow(1.0f - float(i - 3) / (cache_size - 3), 1.5f);
+	}
+
+	std::array<float, max_valence> valence_score;  // boost vertices with few triangles left
+	for (unsigned i = 1; i < max_valence; ++i)
+		valence_score[i] = 2.0f * std::pow(float(i), -0.5f);
+
+	auto vertex_score = [&](int cache_position, unsigned remaining_triangles) -> float {
+		if (remaining_triangles == 0)
+			return -1.0f;  // vertex is not used anymore
+
+		return (cache_position >= 0 ? position_score[cache_position] : 0.0f) +
+			(remaining_triangles < max_valence ? valence_score[remaining_triangles] : 2.0f * std::pow(float(remaining_triangles), -0.5f));
+	};
+
+	// vertex to triangles adjacency (not yet emitted triangles are the first `remaining` vertex triangles)
+	vector<unsigned> remaining(vertex_count, 0),
+		adjacency_offset(vertex_count + 1, 0);
+	for (unsigned index : indices)
+		++remaining[index];
+	for (unsigned v = 0; v < vertex_count; ++v)
+		adjacency_offset[v+1] = adjacency_offset[v] + remaining[v];
+
+	vector<unsigned> adjacency(size(indices)),
+		fill(vertex_count, 0);
+	for (size_t t = 0; t < triangle_count; ++t)
+		for (unsigned k = 0; k < 3; ++k) {
+			unsigned const v = indices[3*t + k];
+			adjacency[adjacency_offset[v] + fill[v]++] = t;
+		}
+
+	vector<int> cache_position(vertex_count, -1);
+	vector<float> score(vertex_count);
+	for (unsigned v = 0; v < vertex_count; ++v)
+		score[v] = vertex_score(-1, remaining[v]);
+
+	vector<float> triangle_score(triangle_count);
+	for (size_t t = 0; t < triangle_count; ++t)
+		triangle_score[t] = score[indices[3*t]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+
+	vector<bool> emitted(triangle_count, false);
+	vector<unsigned> cache,  // LRU, most recently used first
+		next_cache,
+		optimized;
+	optimized.reserve(size(indices));
+
+	auto best_not_emitted = [&]() -> size_t {  // full scan, used only in case cache has no candidate
+		size_t best = triangle_count;
+		for (size_t t = 0; t < triangle_count; ++t)
+			if (!emitted[t] && (best == triangle_count || triangle_score[t] > triangle_score[best]))
+				best = t;
+		return best;
+	};
+
+	size_t best = best_not_emitted();
+	while (best != triangle_count) {
+		emitted[best] = true;
+		unsigned const * triangle = indices.data() + 3*best;
+
+		next_cache.clear();
+		for (unsigned k = 0; k < 3; ++k) {
+			unsigned const v = indices[3*best + k];
+			optimized.push_back(v);
+
+			// remove triangle from the vertex remaining triangles
+			unsigned * first = adjacency.data() + adjacency_offset[v];
+			unsigned * last = first + remaining[v];
+			std::iter_swap(std::find(first, last, static_cast<unsigned>(best)), last - 1);
+			--remaining[v];
+
+			next_cache.push_back(v);
+		}
+
+		for (unsigned v : cache)
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				next_cache.push_back(v);
+
+		// update scores of cached (and just evicted) vertices and their triangles
+		for (size_t i = 0; i < size(next_cache); ++i) {
+			unsigned const v = next_cache[i];
+			cache_position[v] = i < cache_size ? static_cast<int>(i) : -1;
+			score[v] = vertex_score(cache_position[v], remaining[v]);
+		}
+
+		for (unsigned v : next_cache)
+			for (unsigned i = 0; i < remaining[v]; ++i) {
+				unsigned const t = adjacency[adjacency_offset[v] + i];
+				triangle_score[t] = score[indices[3*t]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+			}
+
+		if (size(next_cache) > cache_size)
+			next_cache.resize(cache_size);
+		std::swap(cache, next_cache);
+
+		// the best triangle using cached vertices
+		best = triangle_count;
+		for (unsigned v : cache)
+			for (unsigned i = 0; i < remaining[v]; ++i) {
+				unsigned const t = adjacency[adjacency_offset[v] + i];
+				if (best == triangle_count || triangle_score[t] > triangle_score[best])
+					best = t;
+			}
+
+		if (best == triangle_count)
+			best = best_not_emitted();
+	}
+
+	return optimized;
+}
+
+unsigned stitched_vertex(unsigned vertex, unsigned w, unsigned h, unsigned edges) {
+	unsigned const i = vertex % w,
+		j = vertex / w;
+
+	if ((((edges & edge_south) && j == 0) || ((edges & edge_north) && j == h-1)) && i % 2 == 1)
+		return vertex - 1;
+
+	if ((((edges & edge_west) && i == 0) || ((edges & edge_east) && i == w-1)) && j % 2 == 1)
+		return vertex - w;
+
+	return vertex;
+}
+
+vector<unsigned> stitch_indices(vector<unsigned> const & indices, unsigned w, unsigned h, unsigned edges) {
+	assert(size(indices) % 3 == 0);
+
+	/* Moving an odd edge vertex to its even neighbour collapses one triangle of the edge cell pair and the
+	other triangle becomes a fan covering both cells, so the mesh stays hole free with edge vertices matching
+	a coarser neighbour mesh. */
+	vector<unsigned> stitched;
+	stitched.reserve(size(indices));
+	for (size_t k = 0; k < size(indices); k += 3) {
+		unsigned const a = stitched_vertex(indices[k], w, h, edges),
+			b = stitched_vertex(indices[k+1], w, h, edges),
+			c = stitched_vertex(indices[k+2], w, h, edges);
+
+		if (a == b || b == c || c == a)
+			continue;  // collapsed triangle
+
+		stitched.insert(end(stitched), {a, b, c});
+	}
+
+	return stitched;
+}
+
+vector<unsigned> stitch_strip_indices(vector<unsigned> const & indices, unsigned w, unsigned h, unsigned edges) {
+	vector<unsigned> stitched(size(indices));
+	std::ranges::transform(indices, begin(stitched), [w, h, edges](unsigned index){
+		return index == strip_restart_index ? index : stitched_vertex(index, w, h, edges);
+	});
+	return stitched;
+}
+
+}  // namespace
@@ -1,5 +1,11 @@
 #pragma once
+#include <array>
+#include <map>
+#include <cstddef>
+#include <span>
+#include <string_view>
 #include <tuple>
+#include <utility>
 #include <GLES3/gl32.h>
 
 /*! Creates nxn quad mesh on GPU with a size=1.
@@ -7,3 +13,96 @@
 std::tuple<GLuint, GLuint, GLuint, unsigned> create_quad_mesh(GLint position_loc, unsigned n = 100);
 
 void destroy_quad_mesh(GLuint vao, GLuint vbo, GLuint ibo);
+
+/*! Quad mesh edges (bit flags) stitched to a neighbour mesh with twice bigger vertex spacing (one level
+coarser terrain), mesh uses every second edge vertex there. Mesh y axis goes from south to north. */
+enum quad_edge : unsigned {
+	edge_south = 1,  //!< y=0 edge
+	edge_east = 2,  //!< x=1 edge
+	edge_north = 4,  //!< y=1 edge
+	edge_west = 8  //!< x=0 edge
+};
+
+constexpr unsigned quad_edge_variant_count = 16;  //!< All edge_* combinations.
+
+//! Quad mesh triangles order in an index buffer.
+enum class quad_index_order {
+	row_major,  //!< Triangle list, cells row by row.
+	z_order,  //!< Triangle list, cells ordered by Z-order (Morton) curve so near cells share cached vertices.
+	vertex_cache,  //!< Triangle list reordered for post-transform vertex cache (Tom Forsyth's algorithm).
+	strips  //!< Triangle strip for each cells row separated by primitive restart index.
+};
+
+constexpr quad_index_order quad_index_orders[] = {quad_index_order::row_major, quad_index_order::z_order,
+	quad_index_order::vertex_cache, quad_index_order::strips};
+
+std::string_view to_string(quad_index_order order);
+
+constexpr unsigned vertex_cache_size = 32;  //!< Simulated post-transform vertex cache size (FIFO), see average_cache_miss_ratio().
+
+/*! \returns Average cache miss ratio (ACMR), the number of vertex shader runs per triangle with FIFO vertex
+cache of \c cache_size vertices. Triangle list ACMR is from 0.5 (ideal grid) up to 3.
+\param mode GL_TRIANGLES or GL_TRIANGLE_STRIP (strip can contain primitive \c restart indices). */
+float average_cache_miss_ratio(std::span<unsigned const> indices, GLenum mode, unsigned cache_size = vertex_cache_size,
+	unsigned restart = 0xffffffffu);
+
+struct quad_mesh_elements {
+	unsigned offset,  //!< First index (in indices).
+		count;  //!< Number of indices.
+};
+
+/*! Quad mesh with index buffer ranges for all stitched edges combinations (see quad_edge).
+\note GL_PRIMITIVE_RESTART_FIXED_INDEX needs to be enabled to draw quad_index_order::strips mesh. */
+struct stitched_quad_mesh {
+	GLuint vao = 0,
+		vbo = 0,  //!< 0 for vertex pulling mesh
+		ibo = 0;
+	unsigned resolution = 0;  //!< NxN mesh vertices.
+	quad_index_order order = quad_index_order::row_major;
+	GLenum mode = GL_TRIANGLES,  //!< GL_TRIANGLES or GL_TRIANGLE_STRIP
+		index_type = GL_UNSIGNED_INT;  //!< GL_UNSIGNED_SHORT for meshes up to 65535 vertices
+	float acmr = 0;  //!< Not stitched variant average cache miss ratio (see average_cache_miss_ratio()).
+	std::array<quad_mesh_elements, quad_edge_variant_count> variants;  //!< Indexed by quad_edge flags.
+
+	//! Draws \c edges variant of the mesh, mesh VAO needs to be bound.
+	void draw(unsigned edges) const {
+		quad_mesh_elements const & v = variants[edges];
+		size_t const index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		glDrawElements(mode, v.count, index_type, (GLvoid*)(v.offset*index_size));
+	}
+};
+
+/*! Creates nxn quad mesh on GPU with a size=1 and all 16 stitched edges index variants in one index buffer.
+Indices are 16 bit (GL_UNSIGNED_SHORT) for meshes up to 65535 vertices (0xffff is primitive restart index).
+\param position_loc Position attribute location or -1 for vertex pulling (mesh without vertex buffer, vertex
+shader calculates vertex position from its index `gl_VertexID`, see `terrain_shader_variant::vertex_pulling`).
+\param n Odd mesh resolution, so every second edge vertex matches a coarser neighbour mesh vertex.
+\param order Triangles order, see `stitched_quad_mesh::acmr` to compare orders. */
+stitched_quad_mesh create_stitched_quad_mesh(GLint position_loc, unsigned n,
+	quad_index_order order = quad_index_order::z_order);
+
+void destroy_quad_mesh(stitched_quad_mesh const & mesh);
+
+/*! Stitched quad meshes cache, mesh is created once for a resolution and index order (so switching resolutions
+back and forth does not recreate meshes). Cache for vertex pulling (position_loc=-1) keeps only index buffers.
+\code
+quad_mesh_cache meshes{shader.position_location()};
+stitched_quad_mesh const & mesh = meshes.get(11, quad_index_order::strips);
+glBindVertexArray(mesh.vao);
+mesh.draw(edge_north|edge_west);
+\endcode */
+class quad_mesh_cache {
+public:
+	explicit quad_mesh_cache(GLint position_loc) : _position_loc{position_loc} {}
+	~quad_mesh_cache();
+
+	quad_mesh_cache(quad_mesh_cache const &) = delete;
+	quad_mesh_cache & operator=(quad_mesh_cache const &) = delete;
+
+	//! \returns nxn mesh (created for the first request).
+	stitched_quad_mesh const & get(unsigned n, quad_index_order order = quad_index_order::z_order);
+
+private:
+	GLint _position_loc;
+	std::map<std::pair<unsigned, quad_index_order>, stitched_quad_mesh> _meshes;  //!< (resolution, order) to mesh
+};
@@ -0,0 +1,149 @@
+#include <algorithm>
+#if defined(__x86_64__)
+	#include <immintrin.h>
+#elif defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+#include "raster_stats.hpp"
+
+namespace {
+
+/* 32bit lane sums are flushed into 64bit sum after `flush_block` vector iterations (each lane grows
+by at most 2*65535 per iteration). */
+constexpr size_t flush_block = 16384;
+
+raster_stats compute_stats_scalar(uint16_t const * samples, size_t count) {
+	raster_stats stats;
+	for (size_t i = 0; i < count; ++i) {
+		stats.min = std::min(stats.min, samples[i]);
+		stats.max = std::max(stats.max, samples[i]);
+		stats.sum += samples[i];
+	}
+	stats.count = count;
+	return stats;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.1")))
+raster_stats compute_stats_sse41(uint16_t const * samples, size_t count) {
+	__m128i vmin = _mm_set1_epi16(-1),
+		vmax = _mm_setzero_si128();
+	__m128i const zero = _mm_setzero_si128();
+
+	uint64_t sum = 0;
+	size_t i = 0;
+	while (i + 8 <= count) {
+		__m128i vsum = _mm_setzero_si128();  // 4x32bit lane sums
+		size_t const block_end = std::min(count - count%8, i + 8*flush_block);
+		for (; i < block_end; i += 8) {
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(samples + i));
+			vmin = _mm_min_epu16(vmin, v);  // SSE4.1
+			vmax = _mm_max_epu16(vmax, v);  // SSE4.1
+			vsum = _mm_add_epi32(vsum, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+		}
+
+		alignas(16) uint32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i *>(lanes), vsum);
+		sum += uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+	}
+
+	// horizontal min/max, _mm_minpos_epu16 works for min, max is computed as ~min(~v)
+	raster_stats stats;
+	stats.min = _mm_extract_epi16(_mm_minpos_epu16(vmin), 0);
+	stats.max = ~uint16_t(_mm_extract_epi16(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1))), 0));
+	stats.sum = sum;
+	stats.count = i;
+
+	stats.merge(compute_stats_scalar(samples + i, count - i));  // tail
+	return stats;
+}
+
+bool has_sse41() {
+	static bool const result = __builtin_cpu_supports("sse4.1");
+	return result;
+}
+
+#elif defined(__aarch64__)
+
+raster_stats compute_stats_neon(uint16_t const * samples, size_t count) {
+	uint16x8_t vmin = vdupq_n_u16(0xffff),
+		vmax = vdupq_n_u16(0);
+
+	uint64_t sum = 0;
+	size_t i = 0;
+	while (i + 8 <= count) {
+		uint32x4_t vsum = vdupq_n_u32(0);
+		size_t const block_end = std::min(count - count%8, i + 8*flush_block);
+		for (; i < block_end; i += 8) {
+			uint16x8_t const v = vld1q_u16(samples + i);
+			vmin = vminq_u16(vmin, v);
+			vmax = vmaxq_u16(vmax, v);
+			vsum = vpadalq_u16(vsum, v);  // pairwise add into 32bit lanes
+		}
+		sum += vaddlvq_u32(vsum);
+	}
+
+	raster_stats stats;
+	stats.min = vminvq_u16(vmin);
+	stats.max = vmaxvq_u16(vmax);
+	stats.sum = sum;
+	stats.count = i;
+
+	stats.merge(compute_stats_scalar(samples + i, count - i));  // tail
+	return stats;
+}
+
+#endif
+
+}  // namespace
+
+void raster_stats::merge(raster_stats const & other) {
+	if (other.count == 0)
+		return;
+
+	min = std::min(min, other.min);
+	max = std::max(max, other.max);
+	sum += other.sum;
+	count += other.count;
+}
+
+raster_stats compute_stats(uint16_t const * samples, size_t count) {
+#if defined(__x86_64__)
+	if (has_sse41())
+		return compute_stats_sse41(samples, count);
+#elif defined(__aarch64__)
+	return compute_stats_neon(samples, count);
+#endif
+	return compute_stats_scalar(samples, count);
+}
+
+void add_to_histogram(uint16_t const * samples, size_t count, raster_histogram & histogram) {
+	/* four partial histograms to break store-to-load dependency for neighbour samples in the same bin
+	(typical for elevation data), histogram update can't be vectorized without scatter instructions */
+	std::array<raster_histogram, 4> partial = {};
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		++partial[0][samples[i] >> 8];
+		++partial[1][samples[i+1] >> 8];
+		++partial[2][samples[i+2] >> 8];
+		++partial[3][samples[i+3] >> 8];
+	}
+
+	for (; i < count; ++i)
+		++partial[0][samples[i] >> 8];
+
+	for (size_t bin = 0; bin < std::size(histogram); ++bin)
+		histogram[bin] += partial[0][bin] + partial[1][bin] + partial[2][bin] + partial[3][bin];
+}
+
+char const * stats_kernel_name() {
+#if defined(__x86_64__)
+	return has_sse41() ? "sse4.1" : "scalar";
+#elif defined(__aarch64__)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
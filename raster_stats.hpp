@@ -0,0 +1,30 @@
+/*! \file
+16bit raster (elevation) statistics with vectorized (SSE4.1/NEON) kernels. */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//! Elevation (16bit unsigned samples) statistics.
+struct raster_stats {
+	uint16_t min = 0xffff,
+		max = 0;
+	uint64_t sum = 0;  //!< sum of all samples
+	size_t count = 0;  //!< number of samples
+
+	double mean() const {return count ? double(sum)/count : 0.0;}
+	void merge(raster_stats const & other);
+};
+
+//! 256 bins histogram of 16bit samples (bin = sample/256).
+using raster_histogram = std::array<uint64_t, 256>;
+
+/*! Computes min/max/sum statistics of \c count samples in one pass. SSE4.1 (x86-64, selected at run
+time) or NEON (aarch64) implementation is used when available. */
+raster_stats compute_stats(uint16_t const * samples, size_t count);
+
+//! Adds \c count samples into \c histogram.
+void add_to_histogram(uint16_t const * samples, size_t count, raster_histogram & histogram);
+
+//! \returns Name of the kernel implementation used by compute_stats() e.g. "sse4.1".
+char const * stats_kernel_name();
@@ -3,6 +3,7 @@
 #include <cstddef>  // NULL
 
 using std::cout, std::endl;  // TODO: we want to switch to spdlog
+using std::string, std::string_view;
 
 
 // TODO: rewrite to string_view, glShaderSource call needs to be changed
@@ -70,3 +71,20 @@ GLuint get_shader_program(char const * vertex_shader_source, char const * fragme
 	glDeleteShader(fragment_shader);
 	return shader_program;
 }
+
+string with_defines(string_view shader_source, std::initializer_list<string_view> defines, string_view prelude) {
+	// #version needs to be the first directive in a shader
+	size_t pos = 0;
+	if (shader_source.starts_with("#version")) {
+		pos = shader_source.find('\n');
+		pos = (pos == string_view::npos) ? size(shader_source) : pos + 1;
+	}
+
+	string result{shader_source.substr(0, pos)};
+	for (string_view define : defines)
+		result.append("#define ").append(define).append("\n");
+	if (!empty(prelude))
+		result.append(prelude).append("\n");
+	result.append(shader_source.substr(pos));
+	return result;
+}
@@ -1,6 +1,17 @@
 #pragma once
+#include <initializer_list>
+#include <string>
+#include <string_view>
 #include <GLES3/gl32.h>
 
 //! \return OpenGL program object ID, 0 if an error ocurs.
 GLuint get_shader_program(char const * vertex_shader_source,
 	char const * fragment_shader_source, char const * geometry_shader_source = nullptr);
+
+/*! Inserts `#define` line for each of \c defines (followed by \c prelude code) after `#version`
+directive of \c shader_source (to compile shader variants from one shader source file).
+\code
+string const vs = with_defines(read_file("height_overlap.vs"), {"TEXTURE_ARRAY"});
+\endcode */
+std::string with_defines(std::string_view shader_source, std::initializer_list<std::string_view> defines,
+	std::string_view prelude = {});
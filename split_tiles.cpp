@@ -0,0 +1,470 @@
+/* Splits input TIFF raster into NxN grid of (overlapping) tiles stored as `<stem>_<C>_<R>.tif` files
+(as expected by `terrain_grid::load_tiles`), C represents column and R row of a grid so `<stem>_0_0.tif`
+is the top-left tile.
+
+Tile size is `image_width/N` and neighbour tiles share `overlap` pixels (rows/columns). Input raster is
+read by row blocks (see `tiff_row_reader`) and each tile row is written while the input is read so the
+whole image is never in memory. Tiles of a tile row are written in parallel. GeoTIFF tags are copied
+(with tile tiepoints), input raster is expected to be already projected (e.g. to UTM, see `prepare_plzen`).
+
+With `--overviews N` each tile also contains N reduced resolution images (box filtered, each level
+halves the previous one) stored as next image file directories (GDAL internal overviews layout), so a
+distant tile can be loaded from an overview (see `mapped_tiff` level) instead of a full resolution image.
+With `--border PX` overviews keep the full PX pixels tile border (e.g. 2 for elevation tiles, see
+`elevation_tile_border`), only the tile interior is reduced and border pixels are filtered from input
+pixels around the tile (see `overview_size()`), so overview tile normals can be calculated the same way
+as for a full resolution tile.
+
+Usage: split_tiles [--overlap PX] [--overviews N] [--border PX] [--threads N] [--output DIR] --row-tiles N INPUT_TILE */
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <fmt/core.h>
+#include <tiffio.h>
+#include "tiff.hpp"
+#include "geotiff.hpp"
+
+using std::vector, std::map, std::string, std::size;
+using std::filesystem::path, std::filesystem::create_directories;
+using std::cerr;
+using std::jthread;
+using fmt::print, fmt::format;
+
+struct split_options {
+	path input_tile;
+	path output_directory = "out";
+	size_t row_tiles = 0,  //!< number of tiles in a row
+		overlap = 1;  //!< number of shared pixels between neighbour tiles
+	unsigned overview_count = 0;  //!< number of reduced resolution images stored in each tile
+	size_t border = 0;  //!< tile border kept by all overviews
+	unsigned thread_count = std::thread::hardware_concurrency();
+	size_t read_block_size = 64*1024*1024;  //!< input row block size in bytes
+};
+
+//! Grid of tiles over input image.
+struct tile_grid {
+	size_t tile_size,
+		step,  //!< distance between neighbour tiles in pixels (tile_size - overlap)
+		columns, rows;
+
+	size_t first_row(size_t tile_row) const {return tile_row*step;}
+	size_t last_row(size_t tile_row) const {return tile_row*step + tile_size - 1;}
+};
+
+//! Sample description needed to filter pixels.
+struct sample_desc {
+	tiff_data_desc desc;
+	uint16_t sample_format;
+};
+
+/*! Collects tile pixels (and input pixels around the tile needed by overview borders) from input image
+rows and writes tile overviews after the full resolution image. */
+class tile_overviews {
+public:
+	/*! \param x, y Tile position in the input image.
+	\param border Tile border kept by all overviews, border pixels are filtered from input pixels around the tile. */
+	tile_overviews(size_t x, size_t y, size_t tile_size, sample_desc const & samples, unsigned overview_count,
+		size_t border);
+
+	void add_row(size_t y, std::byte const * row);  //!< \param row Input image row \c y.
+	void write(TIFF * tile, path const & fname);  //!< \note Full resolution image is expected to be written.
+
+	//! \returns Number of input pixels around a tile needed by \c overview_count overviews with \c border.
+	static size_t extension(unsigned overview_count, size_t border) {return border*((size_t{1} << overview_count) - 1);}
+
+private:
+	size_t _x, _y,
+		_tile_size;
+	sample_desc _samples;
+	unsigned _overview_count;
+	size_t _border;
+	size_t _region_x, _region_y,  //!< collected input region (tile with extension, clipped by the input image)
+		_region_w, _region_h;
+	vector<std::byte> _pixels;  //!< collected region pixels
+};
+
+//! Opened output tile.
+struct output_tile {
+	TIFF * tiff;
+	tile_overviews overviews;
+};
+
+tile_grid make_tile_grid(tiff_data_desc const & desc, split_options const & opts);
+TIFF * open_tile(path const & fname, sample_desc const & samples, size_t tile_size, geotiff_tags const & geotags);
+void set_image_fields(TIFF * tile, sample_desc const & samples, size_t size);
+void close_tile(output_tile & tile, path const & fname);
+void filter_overview(std::byte const * pixels, size_t width, vector<size_t> const & columns, vector<size_t> const & rows,
+	unsigned level, sample_desc const & samples, std::byte * result);
+void parse_commandline(int argc, char * argv[], split_options & opts);
+int split_tile(split_options const & opts);
+
+int main(int argc, char * argv[]) {
+	split_options opts;
+	try {
+		parse_commandline(argc, argv, opts);
+	}
+	catch (std::exception const & e) {
+		cerr << e.what() << "\n"
+			<< "usage: split_tiles [--overlap PX] [--overviews N] [--border PX] [--threads N] [--output DIR] --row-tiles N INPUT_TILE\n";
+		return 1;
+	}
+
+	try {
+		return split_tile(opts);
+	}
+	catch (std::exception const & e) {
+		cerr << e.what() << "\n";
+		return 1;
+	}
+}
+
+//! Splits \c opts.input_tile into tiles, \returns program exit code.
+int split_tile(split_options const & opts) {
+	print("input-tile={}\n", opts.input_tile.c_str());
+
+	TIFFSetWarningHandler(nullptr);  // e.g. unknown GDAL tags
+	register_geotiff_tags();
+
+	TIFF * input = TIFFOpen(opts.input_tile.c_str(), "r");
+	if (!input) {
+		cerr << format("can't open '{}' file\n", opts.input_tile.c_str());
+		return 1;
+	}
+
+	geotiff_tags const geotags = read_geotiff_tags(input);
+	uint16_t sample_format = SAMPLEFORMAT_UINT;
+	TIFFGetFieldDefaulted(input, TIFFTAG_SAMPLEFORMAT, &sample_format);
+	TIFFClose(input);
+
+	tiff_row_reader in{opts.input_tile, opts.read_block_size};
+	tiff_data_desc const & desc = in.desc();
+	size_t const pixel_size = size_t{desc.bytes_per_sample}*desc.samples_per_pixel,
+		image_row_size = desc.width*pixel_size;
+	sample_desc const samples = {desc, sample_format};
+
+	print("raster info: width={}, height={}, bands={}\n", desc.width, desc.height, desc.samples_per_pixel);
+
+	tile_grid const grid = make_tile_grid(desc, opts);
+	print("tile_size={}\ntiles: {}x{} (w,h)\n", grid.tile_size, grid.columns, grid.rows);
+
+	create_directories(opts.output_directory);
+	string const tile_name = opts.input_tile.stem().string();
+	auto tile_path = [&](size_t c, size_t r){
+		return opts.output_directory / format("{}_{}_{}.tif", tile_name, c, r);
+	};
+
+	/* Tile rows are opened while input rows needed by the tile row are read (overlap rows belongs to both
+	neighbour tile rows, overview borders needs rows around the tile), each opened tile row has one TIFF
+	handle per column. */
+	map<size_t, vector<output_tile>> open_rows;  // tile row -> column tiles
+	size_t next_tile_row = 0;
+
+	size_t const extension = tile_overviews::extension(opts.overview_count, opts.border);
+	auto first_needed_row = [&](size_t tile_row){
+		return grid.first_row(tile_row) - std::min(grid.first_row(tile_row), extension);
+	};
+	auto last_needed_row = [&](size_t tile_row){
+		return std::min(grid.last_row(tile_row) + extension, desc.height - 1);
+	};
+
+	unsigned const thread_count = std::clamp<unsigned>(opts.thread_count, 1, grid.columns);
+
+	while (auto rows = in.next()) {
+		size_t const block_last_row = rows->y + rows->h - 1;
+
+		// open tile rows needing the block
+		for (; next_tile_row < grid.rows && first_needed_row(next_tile_row) <= block_last_row; ++next_tile_row) {
+			vector<output_tile> & tiles = open_rows[next_tile_row];
+			for (size_t c = 0; c < grid.columns; ++c) {
+				geotiff_tags const tile_geotags = subimage_tags(geotags, c*grid.step, grid.first_row(next_tile_row));
+				tiles.push_back(output_tile{
+					.tiff=open_tile(tile_path(c, next_tile_row), samples, grid.tile_size, tile_geotags),
+					.overviews=tile_overviews{c*grid.step, grid.first_row(next_tile_row), grid.tile_size, samples,
+						opts.overview_count, opts.border}
+				});
+			}
+		}
+
+		/* write tile rows, each worker writes every thread_count-th column of all opened tile rows and
+		closes (writes overviews of) finished tiles of the columns */
+		vector<std::exception_ptr> errors(thread_count);
+		auto write_columns = [&](unsigned worker){
+			try {
+				vector<std::byte> row_buf(grid.tile_size*pixel_size);  // libtiff can modify scanline buffer
+				for (auto & [tile_row, tiles] : open_rows) {
+					size_t const first_row = grid.first_row(tile_row),
+						last_row = grid.last_row(tile_row),
+						y0 = std::max(rows->y, first_needed_row(tile_row)),
+						y1 = std::min(block_last_row, last_needed_row(tile_row));
+
+					for (size_t c = worker; c < grid.columns; c += thread_count) {
+						for (size_t y = y0; y <= y1; ++y) {
+							std::byte const * image_row = rows->pixels + (y - rows->y)*image_row_size;
+							tiles[c].overviews.add_row(y, image_row);
+							if (y < first_row || y > last_row)
+								continue;  // row around the tile needed by overview borders
+
+							memcpy(row_buf.data(), image_row + c*grid.step*pixel_size, size(row_buf));
+							if (TIFFWriteScanline(tiles[c].tiff, row_buf.data(), y - first_row, 0) != 1)
+								throw std::runtime_error{format("unable to write '{}' tile", tile_path(c, tile_row).c_str())};
+						}
+
+						if (last_needed_row(tile_row) <= block_last_row)  // tile finished
+							close_tile(tiles[c], tile_path(c, tile_row));
+					}
+				}
+			}
+			catch (...) {
+				errors[worker] = std::current_exception();
+			}
+		};
+
+		{
+			vector<jthread> workers;
+			for (unsigned worker = 1; worker < thread_count; ++worker)
+				workers.emplace_back(write_columns, worker);
+			write_columns(0);
+		}  // join workers
+
+		for (std::exception_ptr const & e : errors)
+			if (e)
+				std::rethrow_exception(e);
+
+		// forget finished (closed) tile rows
+		std::erase_if(open_rows, [&](auto const & kv){return last_needed_row(kv.first) <= block_last_row;});
+	}
+
+	assert(open_rows.empty() && next_tile_row == grid.rows);
+
+	print("done, check {} directory, bye!\n", opts.output_directory.c_str());
+	return 0;
+}
+
+tile_grid make_tile_grid(tiff_data_desc const & desc, split_options const & opts) {
+	size_t const tile_size = desc.width/opts.row_tiles;
+	if (tile_size <= opts.overlap)
+		throw std::runtime_error{format("tile size ({}px) needs to be bigger than overlap ({}px)", tile_size, opts.overlap)};
+
+	if (tile_size <= 2*opts.border)
+		throw std::runtime_error{format("tile size ({}px) needs to be bigger than border ({}px)", tile_size, 2*opts.border)};
+
+	size_t const step = tile_size - opts.overlap;
+	return {
+		.tile_size=tile_size,
+		.step=step,
+		.columns=1 + (desc.width - tile_size)/step,
+		.rows=(desc.height < tile_size) ? 0 : 1 + (desc.height - tile_size)/step
+	};
+}
+
+TIFF * open_tile(path const & fname, sample_desc const & samples, size_t tile_size, geotiff_tags const & geotags) {
+	TIFF * tile = TIFFOpen(fname.c_str(), "w");
+	if (!tile)
+		throw std::runtime_error{format("can't create '{}' file", fname.c_str())};
+
+	set_image_fields(tile, samples, tile_size);
+	write_geotiff_tags(tile, geotags);
+
+	return tile;
+}
+
+void set_image_fields(TIFF * tile, sample_desc const & samples, size_t size) {
+	tiff_data_desc const & desc = samples.desc;
+	TIFFSetField(tile, TIFFTAG_IMAGEWIDTH, uint32_t(size));
+	TIFFSetField(tile, TIFFTAG_IMAGELENGTH, uint32_t(size));
+	TIFFSetField(tile, TIFFTAG_BITSPERSAMPLE, uint16_t(desc.bytes_per_sample*8));
+	TIFFSetField(tile, TIFFTAG_SAMPLESPERPIXEL, uint16_t(desc.samples_per_pixel));
+	TIFFSetField(tile, TIFFTAG_SAMPLEFORMAT, samples.sample_format);
+	TIFFSetField(tile, TIFFTAG_PHOTOMETRIC, uint16_t(is_rgb(desc) ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK));
+	TIFFSetField(tile, TIFFTAG_PLANARCONFIG, uint16_t(PLANARCONFIG_CONTIG));
+	TIFFSetField(tile, TIFFTAG_COMPRESSION, uint16_t(COMPRESSION_NONE));  // uncompressed tiles can be mapped by mapped_tiff
+	TIFFSetField(tile, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tile, 0));
+}
+
+void close_tile(output_tile & tile, path const & fname) {
+	tile.overviews.write(tile.tiff, fname);
+	TIFFClose(tile.tiff);
+	tile.tiff = nullptr;
+	print("{} created\n", fname.c_str());
+}
+
+tile_overviews::tile_overviews(size_t x, size_t y, size_t tile_size, sample_desc const & samples,
+	unsigned overview_count, size_t border)
+	: _x{x}, _y{y}, _tile_size{tile_size}, _samples{samples}, _overview_count{overview_count}, _border{border} {
+
+	assert(_tile_size > 2*_border);
+
+	// overviews are not created bellow 1x1 pixel tile interior
+	while (_overview_count > 0 && overview_size(_tile_size, _overview_count-1, _border) == 1 + 2*_border)
+		--_overview_count;
+
+	tiff_data_desc const & image = _samples.desc;
+	size_t const e = extension(_overview_count, _border);
+	_region_x = _x - std::min(_x, e);
+	_region_y = _y - std::min(_y, e);
+	_region_w = std::min(_x + _tile_size + e, image.width) - _region_x;
+	_region_h = std::min(_y + _tile_size + e, image.height) - _region_y;
+}
+
+void tile_overviews::add_row(size_t y, std::byte const * row) {
+	if (_overview_count == 0 || y < _region_y || y >= _region_y + _region_h)
+		return;
+
+	size_t const pixel_size = size_t{_samples.desc.bytes_per_sample}*_samples.desc.samples_per_pixel,
+		region_row_size = _region_w*pixel_size;
+
+	if (empty(_pixels))  // allocate lazily, tiles are opened in the main thread
+		_pixels.resize(_region_h*region_row_size);
+
+	memcpy(_pixels.data() + (y - _region_y)*region_row_size, row + _region_x*pixel_size, region_row_size);
+}
+
+namespace {
+
+/*! \returns Region pixel index for each pixel of overview \c level boxes (2^level pixels per overview pixel)
+along one tile axis, tile interior starts at \c tile_pos + \c border and border pixels cover pixels around the
+interior. Positions outside of the region are replaced by the nearest region pixel. */
+vector<size_t> box_indices(size_t tile_pos, size_t border, size_t region_pos, size_t region_size, size_t level_size,
+	unsigned level) {
+
+	ptrdiff_t const scale = ptrdiff_t{1} << level,
+		interior_pos = tile_pos + border - region_pos;  // interior position within the region
+
+	vector<size_t> indices(level_size*scale);
+	for (ptrdiff_t i = 0; i < ptrdiff_t(level_size); ++i)
+		for (ptrdiff_t k = 0; k < scale; ++k) {
+			ptrdiff_t const pos = interior_pos + (i - ptrdiff_t(border))*scale + k;
+			indices[i*scale + k] = std::clamp<ptrdiff_t>(pos, 0, region_size - 1);
+		}
+
+	return indices;
+}
+
+}  // namespace
+
+void tile_overviews::write(TIFF * tile, path const & fname) {
+	if (_overview_count == 0)
+		return;
+
+	size_t const pixel_size = size_t{_samples.desc.bytes_per_sample}*_samples.desc.samples_per_pixel;
+
+	vector<std::byte> level_pixels;
+	for (unsigned level = 1; level <= _overview_count; ++level) {
+		if (!TIFFWriteDirectory(tile))  // finish previous level image
+			throw std::runtime_error{format("unable to write '{}' tile", fname.c_str())};
+
+		size_t const level_size = overview_size(_tile_size, level, _border),
+			row_size = level_size*pixel_size;
+
+		// each level is filtered from collected pixels, libtiff can modify scanline buffer
+		level_pixels.resize(level_size*row_size);
+		filter_overview(_pixels.data(), _region_w,
+			box_indices(_x, _border, _region_x, _region_w, level_size, level),
+			box_indices(_y, _border, _region_y, _region_h, level_size, level),
+			level, _samples, level_pixels.data());
+
+		set_image_fields(tile, _samples, level_size);
+		TIFFSetField(tile, TIFFTAG_SUBFILETYPE, uint32_t(FILETYPE_REDUCEDIMAGE));
+
+		for (size_t y = 0; y < level_size; ++y)
+			if (TIFFWriteScanline(tile, level_pixels.data() + y*row_size, y, 0) != 1)
+				throw std::runtime_error{format("unable to write '{}' tile overview", fname.c_str())};
+	}
+
+	_pixels = vector<std::byte>{};  // release collected pixels
+}
+
+namespace {
+
+template <typename T>
+void filter_overview(T const * pixels, size_t width, size_t samples_per_pixel, vector<size_t> const & columns,
+	vector<size_t> const & rows, unsigned level, T * result) {
+
+	size_t const scale = size_t{1} << level,
+		result_width = size(columns) / scale,
+		result_height = size(rows) / scale;
+
+	int64_t const half = (int64_t{1} << 2*level) / 2;  // box has 4^level pixels
+	for (size_t y = 0; y < result_height; ++y) {
+		for (size_t x = 0; x < result_width; ++x) {
+			for (size_t s = 0; s < samples_per_pixel; ++s) {
+				int64_t sum = 0;
+				for (size_t v = 0; v < scale; ++v) {
+					T const * row = pixels + rows[y*scale + v]*width*samples_per_pixel;
+					for (size_t u = 0; u < scale; ++u)
+						sum += row[columns[x*scale + u]*samples_per_pixel + s];
+				}
+				*result++ = T((sum + half) >> 2*level);  // rounded average
+			}
+		}
+	}
+}
+
+}  // namespace
+
+/*! Box filters overview \c level pixels from \c pixels image of \c width pixels, \c columns and \c rows are
+image pixel indices of overview pixel boxes (see `box_indices()`). */
+void filter_overview(std::byte const * pixels, size_t width, vector<size_t> const & columns, vector<size_t> const & rows,
+	unsigned level, sample_desc const & samples, std::byte * result) {
+
+	size_t const spp = samples.desc.samples_per_pixel;
+	switch (samples.desc.bytes_per_sample) {
+		case 1:
+			filter_overview(reinterpret_cast<uint8_t const *>(pixels), width, spp, columns, rows, level,
+				reinterpret_cast<uint8_t *>(result));
+			break;
+
+		case 2:
+			if (samples.sample_format == SAMPLEFORMAT_INT)
+				filter_overview(reinterpret_cast<int16_t const *>(pixels), width, spp, columns, rows, level,
+					reinterpret_cast<int16_t *>(result));
+			else
+				filter_overview(reinterpret_cast<uint16_t const *>(pixels), width, spp, columns, rows, level,
+					reinterpret_cast<uint16_t *>(result));
+			break;
+
+		default:
+			throw std::runtime_error{format("overviews of {} bytes samples are not supported", samples.desc.bytes_per_sample)};
+	}
+}
+
+void parse_commandline(int argc, char * argv[], split_options & opts) {
+	for (int i = 1; i < argc; ++i) {
+		string const arg = argv[i];
+		auto value = [&]() -> string {
+			if (i+1 >= argc)
+				throw std::runtime_error{format("missing '{}' option value", arg)};
+			return argv[++i];
+		};
+
+		if (arg == "--row-tiles")
+			opts.row_tiles = stoul(value());
+		else if (arg == "--overlap")
+			opts.overlap = stoul(value());
+		else if (arg == "--overviews")
+			opts.overview_count = stoul(value());
+		else if (arg == "--border")
+			opts.border = stoul(value());
+		else if (arg == "--threads")
+			opts.thread_count = stoul(value());
+		else if (arg == "--output")
+			opts.output_directory = value();
+		else if (arg.starts_with("--"))
+			throw std::runtime_error{format("unknown '{}' option", arg)};
+		else
+			opts.input_tile = arg;
+	}
+
+	if (opts.row_tiles == 0)
+		throw std::runtime_error{"--row-tiles option expected"};
+
+	if (opts.input_tile.empty() || !exists(opts.input_tile))
+		throw std::runtime_error{format("input tile '{}' does not exist", opts.input_tile.c_str())};
+}
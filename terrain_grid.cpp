@@ -1,11 +1,16 @@
+#include <algorithm>
 #include <filesystem>
+#include <memory>
+#include <fstream>
+#include <optional>
 #include <regex>
+#include <sstream>
 #include <string>
-#include <tuple>
 #include <utility>
 #include <spdlog/spdlog.h>
 #include "geometry/glmprint.hpp"
 #include "texture.hpp"
+#include "tile_pack.hpp"
 #include "terrain_grid.hpp"
 
 // to implement is_above()
@@ -16,11 +21,10 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
-using std::map;
+using std::map, std::vector;
 using std::string, std::to_string;
 using std::filesystem::path;
 using std::pair;
-using std::tuple, std::get;
 using glm::vec2, glm::vec3;
 
 namespace {  //!< Helper functions.
@@ -28,13 +32,8 @@ namespace {  //!< Helper functions.
 //! Helper function to calculate word position from grid (coumn, row) position.
 vec2 to_word_position(int column, int row, int grid_size, float quad_size);
 
-bool is_square(tuple<GLuint, size_t, size_t> const & tile) {
-	return get<1>(tile) == get<2>(tile);
-}
-
-GLuint get_tid(tuple<GLuint, size_t, size_t> const & tile) {  //!< get OpenGL texture ID
-	return get<0>(tile);
-}
+//! \returns Texture array \c layer storage.
+texture_storage array_layer(texture_storage array, GLint layer);
 
 }  // namespace
 
@@ -66,6 +65,17 @@ void terrain_grid::load_tiles(path const & data_path) {
 		return;
 	}
 
+	_dataset = data_path.string();
+	_cache = std::make_unique<tile_cache>(cache_budget);
+	_residency = std::make_unique<texture_residency>(gpu_budget);
+	_streamer = std::make_unique<texture_streamer>();
+	_loader = std::make_unique<tile_loader>(0, _cache.get());
+
+	if (is_regular_file(data_path)) {
+		load_pack_tiles(data_path);
+		return;
+	}
+
 	load_description(data_path);  // read dataset description file first
 
 	// - make a list of tiles froom tiles_directory
@@ -94,41 +104,263 @@ void terrain_grid::load_tiles(path const & data_path) {
 			}
 			// TODO: this is super slow implementation, we should search in a list of tile files
 
-			// - calculate terrain word position
-			int const column = stoi(column_str),
-				row = stoi(row_str);
-			vec2 const word_pos = to_word_position(column, row, _grid_size, quad_size);
-
-			// - load elevation tile
-			auto const elevation_tile = create_texture_16b(file);
-			assert(is_square(elevation_tile) && "we expect square elevation tiles");
-			assert(size_t(_elevation_tile_size) == get<1>(elevation_tile) && "unexpected elevation tile size");
-
-			// - load satellite tile
-			auto const satellite_tile = create_texture_8b(satellite_path);
-			assert(is_square(satellite_tile));
-			// TODO: check satellite tile size
-
-			// - create terrain instance and filll maps and position
-			terrain trn;
-			trn.elevation_map = get_tid(elevation_tile);
-			trn.satellite_map = get_tid(satellite_tile);
-			trn.position = word_pos;
-			trn.grid_c = column;
-			trn.grid_r = row;
-
-			// - calculate elevation max value
-			trn.elevation_min = _elevation_tile_max_value.at(file.filename());  // TODO: can thrrow std::out_of_range
-
-			// - add to the list of terrains
-			_terrains.push_back(trn);
+			// - add terrain, elevation and satellite tiles are loaded once terrain is visible
+			add_terrain(stoi(column_str), stoi(row_str), {.file=file, .level=overview},
+				{.file=satellite_path, .level=overview});
 		}
 	}
 }
 
+void terrain_grid::load_pack_tiles(path const & pack_file) {
+	_pack = std::make_unique<tile_pack>(pack_file);  // tiles are loaded (streamed) from the mapped pack
+	tile_pack const & pack = *_pack;
+	if (empty(pack.entries())) {
+		spdlog::error("tile pack '{}' is empty", pack_file.c_str());
+		return;
+	}
+
+	unsigned const level = pack.entries()[0].level;  // grid of terrains is single level dataset
+	pack_level const content = read_pack_level(pack, level, overview);
+
+	std::istringstream desc{string{content.description}};
+	load_description(desc);
+
+	for (pack_terrain_tile const & tile : content.tiles)
+		add_terrain(tile.column, tile.row, tile.elevation, tile.satellite);
+
+	spdlog::info("{} ({} entries) tile pack opened", pack_file.c_str(), std::size(pack.entries()));
+}
+
+void terrain_grid::add_terrain(int column, int row, tile_image_source const & elevation,
+	tile_image_source const & satellite) {
+
+	terrain trn;
+	trn.elevation_map = trn.satellite_map = 0;  // not resident, created by upload_loaded_tiles()
+	trn.position = to_word_position(column, row, _grid_size, quad_size);
+	trn.grid_c = column;
+	trn.grid_r = row;
+
+	// dataset description refers tiles by the original tile file names
+	path const elevation_file = fmt::format("{}{}_{}.tif", _elevation_tile_prefix, column, row);
+	trn.elevation_min = _elevation_tile_max_value.at(elevation_file);  // TODO: can thrrow std::out_of_range
+
+	tile_id const id = {.level=0, .column=column, .row=row};
+	_terrain_index[id] = std::size(_terrains);
+	_requests[id] = {.id=id, .dataset=_dataset, .elevation=elevation, .satellite=satellite};
+	_terrains.push_back(trn);
+}
+
+void terrain_grid::mark_visible(terrain const & trn) {
+	tile_id const id = {.level=0, .column=trn.grid_c, .row=trn.grid_r};
+	if (trn.resident())
+		_residency->touch(id);
+	else if (!_loading.contains(id)) {  // (re)load evicted or not yet loaded terrain
+		if (auto it = _requests.find(id); it != end(_requests)) {
+			_loader->request(it->second);
+			_loading.insert(id);
+		}
+	}
+}
+
+size_t terrain_grid::upload_loaded_tiles(size_t byte_budget) {
+	if (!_loader)
+		return 0;
+
+	// start streaming of loaded tiles (keep about one call budget in the upload queue)
+	while (_streamer->queued_bytes() + _posted_bytes < byte_budget) {
+		std::optional<loaded_tile> tile = std::exchange(_layer_waiting, std::nullopt);
+		if (!tile)
+			tile = _loader->poll();
+		if (!tile)
+			break;
+
+		if (!empty(tile->error)) {
+			spdlog::error("tile ({}, {}) loading failed: {}", tile->id.column, tile->id.row, tile->error);
+			_loading.erase(tile->id);
+			_requests.erase(tile->id);  // do not request failing tile again
+			continue;
+		}
+
+		tiff_data_desc const & elevation_desc = tile->elevation.desc,
+			& satellite_desc = tile->satellite.desc;
+		assert(elevation_desc.width == elevation_desc.height && "we expect square elevation tiles");
+		assert(size_t(elevation_tile_size()) == elevation_desc.width && "unexpected elevation tile size");
+		assert(satellite_desc.width == satellite_desc.height);
+
+		std::optional<GLint> layer;
+		if (texture_arrays) {
+			layer = allocate_layer(elevation_desc, satellite_desc);
+			if (!layer) {  // all layers are used by visible terrains, keep the tile until a layer is free
+				_layer_waiting = std::move(tile);
+				break;
+			}
+		}
+
+		if (upload_thread) {
+			post_upload(*tile, layer);
+			continue;
+		}
+
+		// images are top-down rows, shaders flip t coordinate (see top_down_rows uniform)
+		texture_storage const elevation = layer ? array_layer(_elevation_array, *layer) : create_texture_storage_16b(elevation_desc),
+			satellite = layer ? array_layer(_satellite_array, *layer) : create_texture_storage_8b(satellite_desc);
+		_streamer->push(elevation, tile->elevation);
+		_streamer->push(satellite, tile->satellite);
+
+		_streamed[{satellite.texture, satellite.layer}] = streamed_tile{
+			.id=tile->id,
+			.elevation_map=elevation.texture,
+			.satellite_map=satellite.texture,
+			.layer=layer.value_or(-1),
+			.texture_bytes=texture_bytes(elevation_desc) + texture_bytes(satellite_desc)
+		};
+	}
+
+	size_t uploaded = upload_thread ? upload_thread->poll() : 0;  // terrains uploaded by the upload thread
+	for (texture_storage const & texture : _streamer->upload(byte_budget)) {
+		auto node = _streamed.extract({texture.texture, texture.layer});
+		if (!node)
+			continue;  // elevation texture, tile is uploaded with satellite texture
+
+		streamed_tile const & tile = node.mapped();
+		make_resident(tile.id, tile.elevation_map, tile.satellite_map, tile.layer, tile.texture_bytes);
+		++uploaded;
+	}
+
+	return uploaded;
+}
+
+void terrain_grid::post_upload(loaded_tile const & tile, std::optional<GLint> layer) {
+	struct textures {
+		GLuint elevation_map = 0,
+			satellite_map = 0;
+	};
+
+	auto uploaded = std::make_shared<textures>();  // written by upload thread, read by ready function
+	size_t const tile_bytes = tile.elevation.size() + tile.satellite.size(),
+		gpu_bytes = texture_bytes(tile.elevation.desc) + texture_bytes(tile.satellite.desc);
+
+	// images are top-down rows, shaders flip t coordinate (see top_down_rows uniform)
+	upload_thread->post(
+		[uploaded, layer, elevation_array = _elevation_array, satellite_array = _satellite_array,
+			elevation = tile.elevation, satellite = tile.satellite]{  // upload thread
+
+			if (layer) {  // texture arrays are created by the render thread
+				upload_texture(array_layer(elevation_array, *layer), elevation.data(), elevation.desc);
+				upload_texture(array_layer(satellite_array, *layer), satellite.data(), satellite.desc);
+				uploaded->elevation_map = elevation_array.texture;
+				uploaded->satellite_map = satellite_array.texture;
+			}
+			else {
+				uploaded->elevation_map = create_texture_16b(elevation.data(), elevation.desc, row_order::top_down);
+				uploaded->satellite_map = create_texture_8b(satellite.data(), satellite.desc, row_order::top_down);
+			}
+		},
+		[this, uploaded, layer, id = tile.id, tile_bytes, gpu_bytes](string const & error){  // render thread, textures are ready
+			_posted_bytes -= tile_bytes;
+			if (!empty(error)) {
+				spdlog::error("tile ({}, {}) upload failed: {}", id.column, id.row, error);
+				if (layer)
+					_layers->release(*layer);
+				else {
+					glDeleteTextures(1, &uploaded->elevation_map);
+					glDeleteTextures(1, &uploaded->satellite_map);
+				}
+				_loading.erase(id);
+				_requests.erase(id);  // do not request failing tile again
+				return;
+			}
+
+			make_resident(id, uploaded->elevation_map, uploaded->satellite_map, layer.value_or(-1), gpu_bytes);
+		},
+		[uploaded, layer]{  // render thread, dropped job (see gl_upload_thread::cancel())
+			if (layer)
+				return;  // texture arrays are deleted by the grid
+			glDeleteTextures(1, &uploaded->elevation_map);
+			glDeleteTextures(1, &uploaded->satellite_map);
+		});
+
+	_posted_bytes += tile_bytes;
+}
+
+void terrain_grid::make_resident(tile_id const & id, GLuint elevation_map, GLuint satellite_map, GLint layer,
+	size_t gpu_bytes) {
+
+	terrain & trn = _terrains[_terrain_index.at(id)];
+	assert(!trn.resident() && "terrain textures already uploaded");
+	trn.elevation_map = elevation_map;
+	trn.satellite_map = satellite_map;
+	trn.layer = layer;
+	_residency->add(id, gpu_bytes);
+	_loading.erase(id);
+}
+
+std::optional<GLint> terrain_grid::allocate_layer(tiff_data_desc const & elevation_desc,
+	tiff_data_desc const & satellite_desc) {
+
+	if (!_layers) {  // all tiles are expected to be the same size, arrays are created for the first tile
+		GLint max_layers = 256;  // minimum required by OpenGL ES 3.2
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+		size_t const tile_bytes = texture_bytes(elevation_desc) + texture_bytes(satellite_desc);
+		unsigned const capacity = std::max(size_t{1}, std::min({size(), gpu_budget / tile_bytes, size_t(max_layers)}));
+
+		_elevation_array = create_texture_array_storage_16b(elevation_desc, capacity);
+		_satellite_array = create_texture_array_storage_8b(satellite_desc, capacity);
+		_layers = std::make_unique<layer_allocator>(capacity);
+		spdlog::info("terrain texture arrays created ({} layers, {} bytes)", capacity, capacity*tile_bytes);
+	}
+
+	if (std::optional<GLint> layer = _layers->allocate())
+		return layer;
+
+	// all layers are in use, reuse layer of the least recently visible terrain
+	std::optional<tile_id> const evicted = _residency->evict_least_recent();
+	if (!evicted)
+		return std::nullopt;
+
+	evict(*evicted);
+	return _layers->allocate();
+}
+
+void terrain_grid::evict(tile_id const & id) {
+	terrain & trn = _terrains[_terrain_index.at(id)];
+	if (trn.layer != -1) {  // texture arrays layer, arrays are kept
+		_layers->release(trn.layer);
+		trn.layer = -1;
+	}
+	else {
+		glDeleteTextures(1, &trn.elevation_map);
+		glDeleteTextures(1, &trn.satellite_map);
+	}
+	trn.elevation_map = trn.satellite_map = 0;
+}
+
+size_t terrain_grid::update_residency() {
+	if (!_residency)
+		return 0;
+
+	std::vector<tile_id> const evicted = _residency->end_frame();
+	for (tile_id const & id : evicted)
+		evict(id);
+
+	if (!empty(evicted))
+		spdlog::info("{} terrains evicted ({} resident terrains, {} bytes)", std::size(evicted),
+			_residency->count(), _residency->size());
+
+	return std::size(evicted);
+}
+
 void terrain_grid::load_description(path const & data_path) {
+	std::ifstream in{data_path/"dataset.json"};
+	if (!in.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' dataset description file", (data_path/"dataset.json").c_str())};
+	load_description(in);
+}
+
+void terrain_grid::load_description(std::istream & in) {
 	boost::property_tree::ptree config;  // TODO: rename to dataset
-	boost::property_tree::read_json(data_path/"dataset.json", config);
+	boost::property_tree::read_json(in, config);
 
 	/* TODO properties are mandatory otherwisee
 	terminate called after throwing an instance of 'boost::wrapexcept<boost::property_tree::ptree_bad_path>'
@@ -154,4 +386,9 @@ vec2 to_word_position(int column, int row, int grid_size, float quad_size) {
 	return position;
 }
 
+texture_storage array_layer(texture_storage array, GLint layer) {
+	array.layer = layer;
+	return array;
+}
+
 }  // namespace
@@ -1,9 +1,21 @@
 #include <filesystem>
+#include <istream>
 #include <map>
+#include <memory>
+#include <optional>
 #include <ranges>
+#include <set>
 #include <vector>
 #include <glm/vec2.hpp>
 #include <GLES3/gl32.h>
+#include "gl_upload_thread.hpp"
+#include "layer_allocator.hpp"
+#include "tiff.hpp"
+#include "texture_residency.hpp"
+#include "texture_streamer.hpp"
+#include "tile_cache.hpp"
+#include "tile_loader.hpp"
+#include "tile_pack.hpp"
 
 /* - we are expecting that all terrains has the same size textures so thre is no reason to store texture w/h
 - grid_size is also the same for all terrain */
@@ -14,6 +26,9 @@ struct terrain {
 	float elevation_min;  // TODO: use terrain related value there, TODO: rename to eelevation_max
 
 	int grid_c, grid_r; // TODO: grid position for debug
+	GLint layer = -1;  //!< Texture array layer in case of terrain_grid::texture_arrays (maps are shared texture arrays then).
+
+	[[nodiscard]] bool resident() const {return elevation_map != 0;}  //!< \returns True if terrain textures are uploaded.
 };
 
 /*! Function to find out whether position is above a terrain.
@@ -28,8 +43,50 @@ struct terrain_grid {
 
 	// TODO: check that elevation tiles are all the same (width, height), the same for satellite tiles
 	// TODO: we want to get rid og elevation_tile_prefix and satellite_tile_prefix they should be read from data_path config file
+	/*! Creates grid terrains without textures (not resident), terrain tiles are loaded in background
+	once terrain is visible (see mark_visible()) and uploaded by upload_loaded_tiles() call.
+	\param data_path Dataset directory or tile pack file (see `pack_tiles`). */
 	void load_tiles(std::filesystem::path const & data_path);
-	[[nodiscard]] size_t size() const {return std::size(_terrains);}
+
+	/*! Streams loaded tiles into textures (see `texture_streamer.hpp`), uploads at most `byte_budget` bytes
+	per call. Uploaded tiles become resident (renderable). Expected to be called once per frame from the
+	OpenGL context thread. With `upload_thread` textures are created by the upload thread instead of
+	streaming (at most `byte_budget` bytes are waiting for the upload thread).
+	\returns Number of uploaded tiles. */
+	size_t upload_loaded_tiles(size_t byte_budget = 8*1024*1024);
+
+	/*! Marks terrain visible in the current frame, tiles of not resident terrain are requested.
+	\code
+	terrains.upload_loaded_tiles();
+	for (terrain const & trn : terrains.iterate()) {
+		if (!is_visible(trn))
+			continue;
+		terrains.mark_visible(trn);
+		if (trn.resident())
+			draw(trn);
+	}
+	terrains.update_residency();
+	\endcode */
+	void mark_visible(terrain const & trn);
+
+	/*! Deletes textures of least recently visible terrains while resident textures are over `gpu_budget`
+	(terrains visible in the current frame are kept). Expected to be called at the end of a frame.
+	\returns Number of evicted terrains. */
+	size_t update_residency();
+
+	[[nodiscard]] size_t size() const {return std::size(_terrains);}  //!< \returns Number of (resident or not resident) terrains.
+	[[nodiscard]] size_t resident_count() const {return _residency ? _residency->count() : 0;}
+	[[nodiscard]] size_t resident_bytes() const {return _residency ? _residency->size() : 0;}  //!< \returns Estimated GPU memory of resident textures.
+	[[nodiscard]] size_t loading() const {return std::size(_loading);}  //!< \returns Number of requested not yet uploaded terrains.
+	[[nodiscard]] size_t upload_queue_depth() const {  //!< \returns Number of textures waiting for upload.
+		return (_streamer ? _streamer->queue_depth() : 0) + (upload_thread ? 2*upload_thread->pending() : 0);
+	}
+	[[nodiscard]] tile_cache::statistics cache_stats() const {return _cache ? _cache->stats() : tile_cache::statistics{};}
+
+	//! \returns Elevation texture array (GL_TEXTURE_2D_ARRAY) with all terrain tiles in case of `texture_arrays` or 0.
+	[[nodiscard]] GLuint elevation_array() const {return _elevation_array.texture;}
+	[[nodiscard]] GLuint satellite_array() const {return _satellite_array.texture;}  //!< \see elevation_array()
+	[[nodiscard]] unsigned used_layers() const {return _layers ? _layers->used() : 0;}
 
 	/*! \returns Range to iterate through list of terrains.
 	\code
@@ -42,25 +99,80 @@ struct terrain_grid {
 	}
 
 	[[nodiscard]] int grid_size() const {return _grid_size;}
-	[[nodiscard]] int elevation_tile_size() const {return _elevation_tile_size;}
-	[[nodiscard]] double elevation_pixel_size() const {return _elevation_pixel_size;}
+
+	//! \returns Size of loaded elevation tiles (depends on overview, overviews keep elevation tile border).
+	[[nodiscard]] int elevation_tile_size() const {
+		return overview_size(_elevation_tile_size, overview, elevation_tile_border);
+	}
+
+	//! \returns Pixel size of loaded elevation tiles (tile covers the same area for all overviews).
+	[[nodiscard]] double elevation_pixel_size() const {
+		return _elevation_pixel_size*_elevation_tile_size / elevation_tile_size();
+	}
 
 	float quad_size = 1.0f;
+	unsigned overview = 0;  //!< Tile overview level loaded by load_tiles(), 0 for full resolution tiles (see `split_tiles --overviews`).
+
+	size_t cache_budget = 256*1024*1024;  //!< Decoded tile cache (see `tile_cache.hpp`) byte budget used by load_tiles().
+	size_t gpu_budget = 512*1024*1024;  //!< Resident textures (see `texture_residency.hpp`) byte budget used by load_tiles().
+
+	/*! Optional upload thread with shared OpenGL context (see `gl_upload_thread.hpp`) to create tile textures
+	out of the render thread, needs to outlive the grid (posted jobs are canceled by the grid destructor). */
+	gl_upload_thread * upload_thread = nullptr;
+
+	/*! Tiles are stored as layers of two shared texture arrays (see elevation_array(), satellite_array()),
+	terrain layer needs to be passed to shaders instead of binding terrain textures. Array capacity is
+	limited by `gpu_budget`. */
+	bool texture_arrays = false;
 
 	static float camera_ground_height;  //!< Terrain ground height bellow camera. Camera needs to have an access to the property.
 
 	~terrain_grid() {
+		if (upload_thread)
+			upload_thread->cancel();  // posted jobs read pack payloads and write texture arrays
+
 		for (terrain const & trn : _terrains) {  // TODO: terrain is now owner of textures so it is terrain responsibility to delete textures
+			if (trn.layer != -1)
+				continue;  // texture array layer
 			glDeleteTextures(1, &trn.elevation_map);
 			glDeleteTextures(1, &trn.satellite_map);
 		}
+
+		for (auto const & [texture, tile] : _streamed) {  // not yet uploaded terrains
+			if (tile.layer != -1)
+				continue;
+			glDeleteTextures(1, &tile.elevation_map);
+			glDeleteTextures(1, &tile.satellite_map);
+		}
+
+		glDeleteTextures(1, &_elevation_array.texture);
+		glDeleteTextures(1, &_satellite_array.texture);
 	}
 
 private:
 	void load_description(std::filesystem::path const & data_path);
+	void load_description(std::istream & in);
+	void load_pack_tiles(std::filesystem::path const & pack_file);
+	void add_terrain(int column, int row, tile_image_source const & elevation, tile_image_source const & satellite);
 	int elevation_maxval(std::filesystem::path const & filename) const;
 
-	std::vector<terrain> _terrains;
+	//! Posts loaded tile textures creation (or texture array \c layer upload) to the upload thread.
+	void post_upload(loaded_tile const & tile, std::optional<GLint> layer);
+
+	//! Makes uploaded terrain renderable.
+	void make_resident(tile_id const & id, GLuint elevation_map, GLuint satellite_map, GLint layer, size_t gpu_bytes);
+
+	/*! Allocates texture arrays layer for a tile (texture arrays are created for the first tile), in case all
+	layers are in use the least recently visible terrain is evicted to reuse its layer.
+	\returns Layer index or nothing in case all layers are used by (recently) visible terrains. */
+	std::optional<GLint> allocate_layer(tiff_data_desc const & elevation_desc, tiff_data_desc const & satellite_desc);
+
+	void evict(tile_id const & id);  //!< Deletes terrain textures (or releases its texture arrays layer).
+
+	std::vector<terrain> _terrains;  //!< \note terrain references are stable after load_tiles()
+	std::map<tile_id, size_t> _terrain_index;  //!< tile to _terrains index
+	std::map<tile_id, tile_request> _requests;  //!< tile loader requests to (re)load terrain tiles
+	std::set<tile_id> _loading;  //!< requested tiles
 	int _grid_size,
 		_elevation_tile_size,
 		_satellite_tile_size;
@@ -71,4 +183,28 @@ private:
 	/* TODO: This is how wee work with elevations in a vertx shader program
 	float h = float(texture(heights, position.xy).r) * elevation_scale * height_scale; */
 	std::map<std::filesystem::path, int> _elevation_tile_max_value;
+
+	std::string _dataset;  //!< Dataset directory or tile pack file.
+	std::unique_ptr<tile_pack> _pack;  //!< Keeps pack mapped while tiles are loaded.
+	std::unique_ptr<tile_cache> _cache;
+	std::unique_ptr<texture_residency> _residency;
+	std::unique_ptr<texture_streamer> _streamer;
+
+	texture_storage _elevation_array = {},  //!< elevation texture array in case of texture_arrays
+		_satellite_array = {};
+	std::unique_ptr<layer_allocator> _layers;  //!< texture arrays layers
+	std::optional<loaded_tile> _layer_waiting;  //!< loaded tile waiting for a free texture arrays layer
+
+	struct streamed_tile {
+		tile_id id;
+		GLuint elevation_map,
+			satellite_map;
+		GLint layer;
+		size_t texture_bytes;
+	};
+
+	//! (satellite texture, layer) pair (uploaded after elevation texture) to streamed tile
+	std::map<std::pair<GLuint, GLint>, streamed_tile> _streamed;
+	size_t _posted_bytes = 0;  //!< tile bytes waiting for upload thread
+	std::unique_ptr<tile_loader> _loader;  //!< \note needs to be destroyed before _pack and _cache
 };
@@ -0,0 +1,35 @@
+#include <algorithm>
+#include "terrain_instance_buffer.hpp"
+
+using std::span;
+
+terrain_instance_buffer::terrain_instance_buffer() {
+	glGenBuffers(1, &_vbo);
+}
+
+terrain_instance_buffer::~terrain_instance_buffer() {
+	glDeleteBuffers(1, &_vbo);
+}
+
+void terrain_instance_buffer::attach(GLuint vao) const {
+	static_assert(sizeof(terrain_instance) == 4*sizeof(float), "terrain_instance is expected to be vec4 attribute");
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glVertexAttribPointer(tile_location, 4, GL_FLOAT, GL_FALSE, sizeof(terrain_instance), (GLvoid*)0);
+	glVertexAttribDivisor(tile_location, 1);  // one value per instance
+	glEnableVertexAttribArray(tile_location);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void terrain_instance_buffer::update(span<terrain_instance const> instances) {
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+	_capacity = std::max(_capacity, std::size(instances));
+	glBufferData(GL_ARRAY_BUFFER, _capacity*sizeof(terrain_instance), nullptr, GL_STREAM_DRAW);  // orphan previous frame data
+	glBufferSubData(GL_ARRAY_BUFFER, 0, std::size(instances)*sizeof(terrain_instance), instances.data());
+	_size = std::size(instances);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,42 @@
+/*! \file
+Per terrain instance data for instanced terrain grid rendering. Visible terrains placement and
+texture arrays layer are uploaded once per frame and whole grid is drawn by one instanced draw
+call per pass (shaders compiled with `INSTANCED` define, see `terrain_shader_variant.hpp`).
+\code
+terrain_instance_buffer instances;
+instances.attach(vao);  // for each quad mesh VAO
+// ...
+instances.update(visible_terrains);  // once per frame
+glDrawElementsInstanced(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, 0, instances.size());
+\endcode */
+#pragma once
+#include <span>
+#include <glm/vec2.hpp>
+#include <GLES3/gl32.h>
+
+//! Terrain instance data, see `layout(location = 1) in vec4 tile` shader attribute.
+struct terrain_instance {
+	glm::vec2 offset;  //!< terrain world position
+	float scale;  //!< terrain world size
+	float layer;  //!< terrain texture arrays layer
+};
+
+class terrain_instance_buffer {
+public:
+	static constexpr GLuint tile_location = 1;  //!< instance attribute location
+
+	terrain_instance_buffer();
+	~terrain_instance_buffer();
+
+	terrain_instance_buffer(terrain_instance_buffer const &) = delete;
+	terrain_instance_buffer & operator=(terrain_instance_buffer const &) = delete;
+
+	void attach(GLuint vao) const;  //!< Adds instance attribute to \c vao (e.g. after quad mesh is recreated).
+	void update(std::span<terrain_instance const> instances);  //!< Replaces instances (buffer is orphaned).
+	[[nodiscard]] GLsizei size() const {return _size;}  //!< \returns Number of instances.
+
+private:
+	GLuint _vbo = 0;
+	size_t _capacity = 0;  //!< in instances
+	GLsizei _size = 0;
+};
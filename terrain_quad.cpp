@@ -761,11 +761,11 @@ tuple<unique_ptr<byte>, size_t, size_t> load_tiff(path const & tiff_file) {
 	// TODO: we expect 1
 
 	// read strip by strip and store it into whole image
-	unsigned const image_size = image_w*image_h*sample_format;
+	size_t const image_size = size_t{image_w}*image_h*sample_format;
 	unique_ptr<byte> image_data{new byte[image_size]};
 	memset(image_data.get(), 0xff, image_size);
 	for (tstrip_t strip = 0; strip < strip_count; ++strip) {
-		unsigned offset = strip*(strip_size/2);
+		size_t const offset = size_t{strip}*(strip_size/2);
 		uint16_t * buf = reinterpret_cast<uint16_t *>(image_data.get()) + offset;
 		// cout << "buf=" << std::hex << uint64_t(buf) << ", offset=" << offset << '\n';
 		tmsize_t ret = TIFFReadEncodedStrip(tiff, strip, buf, (tsize_t)-1);
@@ -44,6 +44,9 @@ void terrain_scale_ui::create() {
 		quad_resolution = std::max(min_quad_resolution, quad_resolution);
 	}
 
+	if (pixel_error > 0.0f)
+		ImGui::DragFloat("LOD Pixel Error", &pixel_error, 0.1f, 0.5f, 64.0f);
+
 	ImGui::End();  // end window
 
 	ImGui::SetWindowFocus(nullptr);
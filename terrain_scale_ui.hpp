@@ -10,6 +10,7 @@ public:
 		quad_scale = 2.0f;
 
 	int quad_resolution = 100;
+	float pixel_error = 0.0f;  //!< LOD screen space error threshold in pixels, UI is created only for non zero value.
 
 	// constrains
 	constexpr static int min_quad_resolution = 10;
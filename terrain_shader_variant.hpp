@@ -0,0 +1,56 @@
+/*! \file
+Terrain shader program variants compiled from the same shader sources (see with_defines()). */
+#pragma once
+#include <string>
+#include <string_view>
+#include <GLES3/gl32.h>
+#include "shader.hpp"
+#include "io.hpp"
+
+enum class terrain_shader_variant {
+	textures,  //!< terrain tile textures bound per draw, loose uniforms set per draw
+	texture_array,  //!< terrain tiles stored as texture arrays layers, uniform blocks (`TEXTURE_ARRAY` and `UNIFORM_BLOCKS` defines)
+	instanced,  //!< texture arrays with terrain placement and layer as instance data (`TEXTURE_ARRAY`, `INSTANCED` and `UNIFORM_BLOCKS` defines)
+	vertex_pulling,  //!< terrain tile textures bound per draw without vertex attributes, quad mesh vertex position is calculated from vertex index, uniform blocks with per terrain tile sizes (`VERTEX_PULLING` and `UNIFORM_BLOCKS` defines, see terrain_tile_uniforms)
+	baked_normals  //!< vertex pulling with normals read from baked normal maps (`VERTEX_PULLING`, `NORMAL_MAP` and `UNIFORM_BLOCKS` defines), see `normal_map.hpp`
+};
+
+//! \returns True for variants with uniforms set per draw, otherwise uniforms are in terrain uniform blocks.
+constexpr bool has_loose_uniforms(terrain_shader_variant variant) {
+	return variant == terrain_shader_variant::textures;
+}
+
+//! \returns True for variants without vertex attributes (see `VERTEX_PULLING`).
+constexpr bool pulls_vertices(terrain_shader_variant variant) {
+	return variant == terrain_shader_variant::vertex_pulling || variant == terrain_shader_variant::baked_normals;
+}
+
+constexpr GLuint terrain_frame_binding = 0,  //!< `terrain_frame` uniform block binding point
+	terrain_tile_binding = 1;  //!< `terrain_tile` uniform block binding point
+
+/*! \returns Shader source with \c variant defines, uniform block variants also get terrain uniform
+blocks declarations (see `terrain_uniform_blocks.glsl`). */
+inline std::string with_variant_defines(std::string_view shader_source, terrain_shader_variant variant) {
+	switch (variant) {
+		case terrain_shader_variant::texture_array:
+			return with_defines(shader_source, {"TEXTURE_ARRAY", "UNIFORM_BLOCKS"}, read_file("terrain_uniform_blocks.glsl"));
+		case terrain_shader_variant::instanced:
+			return with_defines(shader_source, {"TEXTURE_ARRAY", "INSTANCED", "UNIFORM_BLOCKS"},
+				read_file("terrain_uniform_blocks.glsl"));
+		case terrain_shader_variant::vertex_pulling:
+			return with_defines(shader_source, {"VERTEX_PULLING", "UNIFORM_BLOCKS"}, read_file("terrain_uniform_blocks.glsl"));
+		case terrain_shader_variant::baked_normals:
+			return with_defines(shader_source, {"VERTEX_PULLING", "NORMAL_MAP", "UNIFORM_BLOCKS"},
+				read_file("terrain_uniform_blocks.glsl"));
+		default: return std::string{shader_source};
+	}
+}
+
+//! Binds \c program terrain uniform blocks to the binding points (blocks not used by the program are ignored).
+inline void bind_terrain_uniform_blocks(GLuint program) {
+	if (GLuint const frame = glGetUniformBlockIndex(program, "terrain_frame"); frame != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame, terrain_frame_binding);
+
+	if (GLuint const tile = glGetUniformBlockIndex(program, "terrain_tile"); tile != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, tile, terrain_tile_binding);
+}
@@ -0,0 +1,36 @@
+// Terrain uniform blocks, inserted into uniform block shader variants (see `terrain_uniform_buffers.hpp`).
+
+layout(std140) uniform terrain_frame {  // per frame data (terrain_frame_uniforms)
+	highp mat4 world_to_screen;
+	highp vec4 light_direction;  // shading light direction (xyz) in world space
+	highp float elevation_scale;  // terrain elevation scale factor calculated from elevation pixel resolution
+	highp float height_scale;  // e.g. 10.0
+	highp float terrain_size;  // terrain size in real world units e.g. meters
+	highp float elevation_tile_size;  // size of elevation tile in px (e.g. 734)
+	highp float normal_tile_size;  // size of normal tile in px (e.g. 730)
+	bool use_satellite_map;
+	bool use_shading;
+	bool top_down_rows;  // textures stored with the first image row at t=0 (not flipped while uploaded)
+};
+
+#ifndef INSTANCED
+#ifdef VERTEX_PULLING  // quadtree terrains of different levels (terrain_tile_uniforms), tile sizes depends on terrain level
+layout(std140) uniform terrain_tile {  // per terrain data bound for each draw
+	highp vec4 tile;  // (offset.x, offset.y, scale, texture array layer)
+	highp float tile_elevation_scale;
+	highp float tile_terrain_size;
+	highp float tile_elevation_tile_size;
+	highp float tile_normal_tile_size;
+};
+
+// terrain_frame values are replaced by the terrain ones
+#define elevation_scale tile_elevation_scale
+#define terrain_size tile_terrain_size
+#define elevation_tile_size tile_elevation_tile_size
+#define normal_tile_size tile_normal_tile_size
+#else
+layout(std140) uniform terrain_tile {  // per terrain data bound for each draw (terrain_instance)
+	highp vec4 tile;  // (offset.x, offset.y, scale, texture array layer)
+};
+#endif
+#endif
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include "terrain_uniform_buffers.hpp"
+
+using std::span, std::vector;
+
+terrain_uniform_buffers::terrain_uniform_buffers() {
+	static_assert(sizeof(terrain_frame_uniforms) == 112, "std140 terrain_frame block layout expected");
+	static_assert(sizeof(terrain_tile_uniforms) == 32, "std140 terrain_tile block layout expected");
+
+	glGenBuffers(1, &_frame_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, _frame_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(terrain_frame_uniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glGenBuffers(1, &_tile_ubo);
+
+	GLint offset_alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+	size_t const alignment = std::max(offset_alignment, 1);
+	size_t const tile_size = std::max(sizeof(terrain_instance), sizeof(terrain_tile_uniforms));
+	_tile_stride = (tile_size + alignment-1) / alignment * alignment;
+}
+
+terrain_uniform_buffers::~terrain_uniform_buffers() {
+	glDeleteBuffers(1, &_tile_ubo);
+	glDeleteBuffers(1, &_frame_ubo);
+}
+
+void terrain_uniform_buffers::update_frame(terrain_frame_uniforms const & frame) {
+	glBindBuffer(GL_UNIFORM_BUFFER, _frame_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(terrain_frame_uniforms), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, terrain_frame_binding, _frame_ubo);
+}
+
+void terrain_uniform_buffers::update_tiles(span<terrain_instance const> tiles) {
+	upload_tiles(tiles.data(), std::size(tiles), sizeof(terrain_instance));
+}
+
+void terrain_uniform_buffers::update_tiles(span<terrain_tile_uniforms const> tiles) {
+	upload_tiles(tiles.data(), std::size(tiles), sizeof(terrain_tile_uniforms));
+}
+
+void terrain_uniform_buffers::upload_tiles(void const * tiles, size_t count, size_t tile_size) {
+	if (count == 0)
+		return;
+
+	// terrain blocks needs to be aligned, pack them with the alignment padding
+	vector<std::byte> data(count*_tile_stride);
+	for (size_t i = 0; i < count; ++i)
+		memcpy(data.data() + i*_tile_stride, static_cast<std::byte const *>(tiles) + i*tile_size, tile_size);
+
+	_tile_size = tile_size;
+	_tile_capacity = std::max(_tile_capacity, count);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, _tile_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, _tile_capacity*_tile_stride, nullptr, GL_STREAM_DRAW);  // orphan previous frame data
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size(data), data.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void terrain_uniform_buffers::bind_tile(size_t index) const {
+	assert(index < _tile_capacity && "terrain block out of range");
+	glBindBufferRange(GL_UNIFORM_BUFFER, terrain_tile_binding, _tile_ubo, index*_tile_stride, _tile_size);
+}
@@ -0,0 +1,70 @@
+/*! \file
+Uniform buffers for uniform block terrain shader variants (see `terrain_shader_variant.hpp` and
+`terrain_uniform_blocks.glsl`). Per frame data are uploaded once per frame, per terrain data of all
+visible terrains are uploaded into one buffer and each draw only binds its terrain range, so no
+loose uniforms are set per terrain.
+\code
+terrain_uniform_buffers blocks;
+blocks.update_frame(frame);  // once per frame
+blocks.update_tiles(visible_terrains);
+for (size_t i = 0; i < size(visible_terrains); ++i) {
+	blocks.bind_tile(i);
+	glDrawElements(...);
+}
+\endcode */
+#pragma once
+#include <span>
+#include <cstdint>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <GLES3/gl32.h>
+#include "terrain_instance_buffer.hpp"
+#include "terrain_shader_variant.hpp"
+
+//! `terrain_frame` uniform block data (std140 layout).
+struct terrain_frame_uniforms {
+	glm::mat4 world_to_screen;
+	glm::vec4 light_direction;
+	float elevation_scale,
+		height_scale,
+		terrain_size,
+		elevation_tile_size,
+		normal_tile_size;
+	uint32_t use_satellite_map,  //!< std140 bool
+		use_shading,
+		top_down_rows;
+};
+
+/*! `terrain_tile` uniform block data (std140 layout) of vertex pulling variants, quadtree terrains of
+different levels have different elevation tile sizes, so tile sizes are per terrain data (terrain_frame
+values are not used). */
+struct terrain_tile_uniforms {
+	terrain_instance tile;  //!< layer is not used (tile textures are bound per draw)
+	float elevation_scale,
+		terrain_size,
+		elevation_tile_size,
+		normal_tile_size;
+};
+
+class terrain_uniform_buffers {
+public:
+	terrain_uniform_buffers();
+	~terrain_uniform_buffers();
+
+	terrain_uniform_buffers(terrain_uniform_buffers const &) = delete;
+	terrain_uniform_buffers & operator=(terrain_uniform_buffers const &) = delete;
+
+	void update_frame(terrain_frame_uniforms const & frame);  //!< Uploads and binds per frame block.
+	void update_tiles(std::span<terrain_instance const> tiles);  //!< Uploads per terrain blocks (buffer is orphaned).
+	void update_tiles(std::span<terrain_tile_uniforms const> tiles);  //!< Vertex pulling variants version of update_tiles().
+	void bind_tile(size_t index) const;  //!< Binds \c index terrain block (uploaded by the last update_tiles() call).
+
+private:
+	void upload_tiles(void const * tiles, size_t count, size_t tile_size);
+
+	GLuint _frame_ubo = 0,
+		_tile_ubo = 0;
+	size_t _tile_stride;  //!< per terrain block size aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	size_t _tile_size = sizeof(terrain_instance);  //!< per terrain block size (of the last update_tiles() call)
+	size_t _tile_capacity = 0;  //!< in terrains
+};
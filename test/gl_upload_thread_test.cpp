@@ -0,0 +1,97 @@
+/* Checks upload thread job reporting (see `gl_upload_thread.hpp`), failing upload job is reported by its
+ready function and objects of uploaded jobs dropped by cancel() are released by discard functions. Needs
+OpenGL ES 3.2 context (hidden window).
+
+Usage: gl_upload_thread_test */
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fmt/core.h>
+#include <SDL.h>
+#include <GLES3/gl32.h>
+#include "gl_upload_thread.hpp"
+
+using std::string;
+using std::cerr;
+using fmt::print;
+
+//! Polls \c uploader until all posted jobs are finished.
+void wait_for(gl_upload_thread & uploader) {
+	while (uploader.pending() > 0) {
+		uploader.poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+}
+
+int main() {
+	SDL_Init(SDL_INIT_VIDEO);
+	SDL_Window * window = SDL_CreateWindow("gl_upload_thread_test", SDL_WINDOWPOS_UNDEFINED,
+		SDL_WINDOWPOS_UNDEFINED, 64, 64, SDL_WINDOW_OPENGL|SDL_WINDOW_HIDDEN);
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+
+	SDL_GLContext context = SDL_GL_CreateContext(window);
+	if (!context) {
+		cerr << "unable to create OpenGL ES 3.2 context (" << SDL_GetError() << ")\n";
+		return 1;
+	}
+
+	int result = 0;
+	{
+		gl_upload_thread uploader{window, context};
+		print("running={}\n", uploader.running());
+
+		// failing job
+		string error;
+		uploader.post(
+			[]{throw std::runtime_error{"unsupported image"};},
+			[&error](string const & e){error = e;});
+		wait_for(uploader);
+
+		if (error != "unsupported image") {
+			cerr << "failing upload job is expected to be reported by ready function\n";
+			result = 1;
+		}
+
+		// uploaded job dropped by cancel()
+		GLuint texture = 0;
+		std::atomic<bool> uploaded = false;
+		bool ready = false,
+			discarded = false;
+		uploader.post(
+			[&texture, &uploaded]{
+				glGenTextures(1, &texture);
+				uploaded = true;
+			},
+			[&ready](string const &){ready = true;},
+			[&texture, &discarded]{
+				glDeleteTextures(1, &texture);
+				discarded = true;
+			});
+
+		while (!uploaded)  // wait for upload, but do not poll
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+		uploader.cancel();
+		print("ready={}, discarded={}, pending={}\n", ready, discarded, uploader.pending());
+
+		if (uploader.running() && (ready || !discarded || uploader.pending() != 0)) {
+			cerr << "canceled uploaded job is expected to be discarded\n";
+			result = 1;
+		}
+	}
+
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	if (result == 0)
+		print("passed\n");
+
+	return result;
+}
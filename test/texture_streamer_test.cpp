@@ -0,0 +1,68 @@
+/* Checks that texture streamer uploads queued textures with default (unlimited) time budget (see
+`texture_streamer.hpp`). Needs OpenGL ES 3.2 context (hidden window).
+
+Usage: texture_streamer_test */
+#include <memory>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <fmt/core.h>
+#include <SDL.h>
+#include <GLES3/gl32.h>
+#include "texture_streamer.hpp"
+
+using std::vector, std::byte;
+using std::cerr;
+using fmt::print;
+
+int main() {
+	SDL_Init(SDL_INIT_VIDEO);
+	SDL_Window * window = SDL_CreateWindow("texture_streamer_test", SDL_WINDOWPOS_UNDEFINED,
+		SDL_WINDOWPOS_UNDEFINED, 64, 64, SDL_WINDOW_OPENGL|SDL_WINDOW_HIDDEN);
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+
+	SDL_GLContext context = SDL_GL_CreateContext(window);
+	if (!context) {
+		cerr << "unable to create OpenGL ES 3.2 context (" << SDL_GetError() << ")\n";
+		return 1;
+	}
+
+	int result = 0;
+	try {
+		tiff_data_desc const desc = {.width=64, .height=64, .bytes_per_sample=2, .samples_per_pixel=1};
+		std::shared_ptr<byte[]> pixels{new byte[desc.width*desc.height*desc.bytes_per_sample]{}};
+		decoded_image const image{.desc=desc, .pixels=pixels};
+
+		texture_storage const elevation = create_texture_storage_16b(desc);
+		{
+			texture_streamer streamer;
+			streamer.push(elevation, image);
+
+			vector<texture_storage> const uploaded = streamer.upload(1024*1024);  // default time budget
+			print("uploaded={}, queue_depth={}, queued_bytes={}\n", std::size(uploaded), streamer.queue_depth(),
+				streamer.queued_bytes());
+
+			if (std::size(uploaded) != 1 || streamer.queue_depth() != 0 || streamer.queued_bytes() != 0) {
+				cerr << "queued texture is expected to be uploaded by one upload call\n";
+				result = 1;
+			}
+		}
+		glDeleteTextures(1, &elevation.texture);
+	}
+	catch (std::exception const & e) {
+		cerr << e.what() << "\n";
+		result = 1;
+	}
+
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	if (result == 0)
+		print("passed\n");
+
+	return result;
+}
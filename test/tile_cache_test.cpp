@@ -0,0 +1,131 @@
+/* Checks that compressed TIFF tiles are cached by tile loader (see `tile_cache.hpp`). Deflate
+compressed elevation and satellite tiles (with baked normal map) are loaded twice, the second load needs
+to be served from the cache (one hit for each tile image). Normal map baked with a different pixel size
+is not expected to be served from the cache.
+
+Usage: tile_cache_test */
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+#include <tiffio.h>
+#include "tile_cache.hpp"
+#include "tile_loader.hpp"
+
+using std::vector, std::byte;
+using std::filesystem::path, std::filesystem::temp_directory_path;
+using std::cerr;
+using fmt::print, fmt::format;
+
+//! Writes deflate compressed \c size x \c size TIFF with \c samples_per_pixel samples of \c bits_per_sample.
+void write_deflate_tiff(path const & fname, uint32_t size, uint16_t bits_per_sample, uint16_t samples_per_pixel) {
+	TIFF * tiff = TIFFOpen(fname.c_str(), "w");
+	if (!tiff)
+		throw std::runtime_error{format("can't create '{}' file", fname.c_str())};
+
+	TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, size);
+	TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, size);
+	TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, bits_per_sample);
+	TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, samples_per_pixel);
+	TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, uint16_t(SAMPLEFORMAT_UINT));
+	TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, uint16_t(samples_per_pixel == 3 ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK));
+	TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, uint16_t(PLANARCONFIG_CONTIG));
+	TIFFSetField(tiff, TIFFTAG_COMPRESSION, uint16_t(COMPRESSION_ADOBE_DEFLATE));
+	TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tiff, 0));
+
+	vector<byte> row(size_t{size}*(bits_per_sample/8)*samples_per_pixel);
+	for (uint32_t y = 0; y < size; ++y) {
+		for (size_t i = 0; i < std::size(row); ++i)
+			row[i] = byte(y + i);
+
+		if (TIFFWriteScanline(tiff, row.data(), y, 0) != 1) {
+			TIFFClose(tiff);
+			throw std::runtime_error{format("unable to write '{}' file", fname.c_str())};
+		}
+	}
+
+	TIFFClose(tiff);
+}
+
+//! Requests tile and waits for the result.
+loaded_tile load(tile_loader & loader, tile_request const & r) {
+	loader.request(r);
+	while (true) {
+		if (std::optional<loaded_tile> tile = loader.poll())
+			return *tile;
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+}
+
+int main() {
+	TIFFSetWarningHandler(nullptr);
+
+	path const elevation_file = temp_directory_path()/"tile_cache_test_elev.tif",
+		satellite_file = temp_directory_path()/"tile_cache_test_rgb.tif";
+
+	int result = 0;
+	try {
+		write_deflate_tiff(elevation_file, 64, 16, 1);
+		write_deflate_tiff(satellite_file, 64, 8, 3);
+
+		tile_cache cache{16*1024*1024};
+		tile_loader loader{1, &cache};
+
+		tile_request const r = {
+			.id={0, 0, 0},
+			.dataset="tile_cache_test",
+			.elevation={.file=elevation_file},
+			.satellite={.file=satellite_file},
+			.normal_map_pixel_size=10.0f
+		};
+
+		for (int i = 0; i < 2; ++i) {
+			loaded_tile const tile = load(loader, r);
+			if (!empty(tile.error))
+				throw std::runtime_error{format("unable to load tile ({})", tile.error)};
+
+			if (tile.elevation.mapped || tile.satellite.mapped)
+				throw std::runtime_error{"decoded (compressed) TIFF images are not expected to be mapped"};
+
+			if (!tile.normals.pixels)
+				throw std::runtime_error{"baked normal map expected"};
+		}
+
+		tile_cache::statistics stats = cache.stats();
+		print("hits={}, misses={}, count={}\n", stats.hits, stats.misses, stats.count);
+
+		if (stats.hits != 3 || stats.misses != 3 || stats.count != 3) {  // one hit for each tile image
+			cerr << "second tile load is expected to be served from the cache\n";
+			result = 1;
+		}
+
+		tile_request coarser = r;
+		coarser.normal_map_pixel_size = 20.0f;
+		loaded_tile const tile = load(loader, coarser);
+		if (!empty(tile.error))
+			throw std::runtime_error{format("unable to load tile ({})", tile.error)};
+
+		stats = cache.stats();
+		print("hits={}, misses={}, count={}\n", stats.hits, stats.misses, stats.count);
+
+		if (stats.hits != 5 || stats.misses != 4 || stats.count != 4) {  // normal map baked again
+			cerr << "normal map with a different pixel size is not expected to be served from the cache\n";
+			result = 1;
+		}
+	}
+	catch (std::exception const & e) {
+		cerr << e.what() << "\n";
+		result = 1;
+	}
+
+	std::filesystem::remove(elevation_file);
+	std::filesystem::remove(satellite_file);
+
+	if (result == 0)
+		print("passed\n");
+
+	return result;
+}
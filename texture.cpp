@@ -1,3 +1,7 @@
+#include <span>
+#include <vector>
+#include <cassert>
+#include <cstring>
 #include <spdlog/spdlog.h>
 #include <glm/vec4.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -5,7 +9,7 @@
 #include "texture.hpp"
 #include "color.hpp"
 
-using std::tuple;
+using std::tuple, std::span, std::byte, std::vector;
 using std::filesystem::path;
 using glm::vec4, glm::value_ptr;
 
@@ -13,83 +17,261 @@ bool is_tiff(path const & fname) {
 	return (fname.extension() == ".tiff") || (fname.extension() == ".tif");
 }
 
-tuple<GLuint, size_t, size_t> create_texture_16b(path const & fname) {
-	auto const [image_data, image_desc] = [&fname](){
-		if (is_tiff(fname))
-			return load_tiff_desc(fname, true);
-		else
-			throw std::runtime_error("unsupported texture format (only TIFF (*.tif) suported");
-	}();
+namespace {
 
-	spdlog::info("{} ({}x{}) image loaded", fname.c_str(), image_desc.width, image_desc.height);
+using image_blocks = span<mapped_tiff::block const>;
 
-	GLuint tbo;
-	glGenTextures(1, &tbo);
-	glBindTexture(GL_TEXTURE_2D, tbo);
+/*! Uploads image into level 0 of bound GL_TEXTURE_2D texture. Image blocks rows are copied in
+reverse order into a flipped scratch image to get bottom-up texture by one upload call (row by row
+upload means hundreds of upload calls per tile). */
+void upload_flipped(image_blocks blocks, tiff_data_desc const & desc, GLenum format, GLenum type) {
+	size_t const pixel_size = desc.bytes_per_sample*desc.samples_per_pixel,
+		row_size = desc.width*pixel_size;
+
+	vector<byte> flipped(desc.height*row_size);
+	for (mapped_tiff::block const & b : blocks) {
+		for (size_t r = 0; r < b.h; ++r) {
+			size_t const y = desc.height-1 - (b.y+r);
+			memcpy(flipped.data() + y*row_size + b.x*pixel_size, b.pixels + r*b.row_length*pixel_size, b.w*pixel_size);
+		}
+	}
+
+	GLint unpack_alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // rows are tightly packed
+
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, desc.width, desc.height, format, type, flipped.data());
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+}
+
+/*! Uploads image into level 0 of bound GL_TEXTURE_2D texture in image (top-down) row order, one
+upload call per image block. */
+void upload_top_down(image_blocks blocks, GLenum format, GLenum type) {
+	GLint unpack_alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // mapped rows are not aligned
+
+	for (mapped_tiff::block const & b : blocks) {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, b.row_length);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, b.x, b.y, b.w, b.h, format, type, b.pixels);
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+}
+
+void upload(image_blocks blocks, tiff_data_desc const & desc, GLenum format, GLenum type, row_order rows) {
+	if (rows == row_order::top_down)
+		upload_top_down(blocks, format, type);
+	else
+		upload_flipped(blocks, desc, format, type);
+}
+
+//! Image stored continuously (top-down rows) as one image block.
+mapped_tiff::block whole_image(byte const * pixels, tiff_data_desc const & desc) {
+	return {.x=0, .y=0, .w=desc.width, .h=desc.height, .row_length=desc.width, .pixels=pixels};
+}
+
+/*! Creates 16bit GRAY or RGB texture (\c target GL_TEXTURE_2D) or texture array (\c target
+GL_TEXTURE_2D_ARRAY) storage without pixels. */
+texture_storage create_storage_16b(GLenum target, tiff_data_desc const & image_desc, unsigned layers) {
+	texture_storage storage = {.texture=0, .format=GL_RED_INTEGER, .type=GL_UNSIGNED_SHORT, .target=target, .layer=0};
+	glGenTextures(1, &storage.texture);
+	glBindTexture(target, storage.texture);
 
 	// note: 16bit I/UI textures can not be interpolated and so filter needs to be set to GL_NEAREST
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);  // or GL_NEAREST
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);  // or GL_NEAREST
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
 	// clam to the edge outside of [0,1]^2 range
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+	GLenum internal_format = GL_NONE;
 	if (is_grayscale(image_desc)) {
 		// TODO: elevation data seems to be INTEGER not UNSIGNED INTEGET
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI /*GL_R16I*/, image_desc.width, image_desc.height);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_desc.width, image_desc.height, GL_RED_INTEGER, GL_UNSIGNED_SHORT /*GL_SHORT*/, image_data.get());
+		internal_format = GL_R16UI;  /*GL_R16I*/
+		storage.format = GL_RED_INTEGER;
+		storage.type = GL_UNSIGNED_SHORT;  /*GL_SHORT*/
 	}
 	else if (is_rgb(image_desc)) {
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16UI, image_desc.width, image_desc.height);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_desc.width, image_desc.height, GL_RGB_INTEGER, GL_UNSIGNED_SHORT, image_data.get());
+		internal_format = GL_RGB16UI;
+		storage.format = GL_RGB_INTEGER;
+		storage.type = GL_UNSIGNED_SHORT;
 	}
-	else  // TODO: provide info about channels
+	else {  // TODO: provide info about channels
+		glBindTexture(target, 0);
+		glDeleteTextures(1, &storage.texture);
 		throw std::runtime_error{"unsupported number of channels (?), only GRAY and RGB images are supported"};
+	}
 
+	if (target == GL_TEXTURE_2D_ARRAY)
+		glTexStorage3D(target, 1, internal_format, image_desc.width, image_desc.height, layers);
+	else
+		glTexStorage2D(target, 1, internal_format, image_desc.width, image_desc.height);
+
+	glBindTexture(target, 0);  // unbint texture
+
+	return storage;
+}
+
+//! Creates 8bit RGB texture or texture array storage without pixels, see create_storage_16b().
+texture_storage create_storage_8b(GLenum target, tiff_data_desc const & image_desc, unsigned layers) {
+	if (!is_rgb(image_desc))
+		throw std::runtime_error{"only 8bit RGB textures are supported"};
+
+	texture_storage storage = {.texture=0, .format=GL_RGB, .type=GL_UNSIGNED_BYTE, .target=target, .layer=0};
+	glGenTextures(1, &storage.texture);
+	glBindTexture(target, storage.texture);
+
+	if (target == GL_TEXTURE_2D_ARRAY)
+		glTexStorage3D(target, 1, GL_RGB8, image_desc.width, image_desc.height, layers);
+	else
+		glTexStorage2D(target, 1, GL_RGB8, image_desc.width, image_desc.height);
+
+	// in case of wrapping, we want to be able to easilly see it in scene as red color
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, value_ptr(vec4{rgb::red, 1.0}));
+
+	// set texture filtering (interpolation) mode (if GL_LINEAR is set, we can see artifacts in a scene)
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindTexture(target, 0);  // unbint texture
+
+	return storage;
+}
+
+GLuint create_texture_16b(image_blocks blocks, tiff_data_desc const & image_desc, row_order rows) {
+	texture_storage const storage = create_texture_storage_16b(image_desc);
+
+	glBindTexture(GL_TEXTURE_2D, storage.texture);
+	upload(blocks, image_desc, storage.format, storage.type, rows);
 	glBindTexture(GL_TEXTURE_2D, 0);  // unbint texture
 
-	return {tbo, image_desc.width, image_desc.height};
+	return storage.texture;
 }
 
+GLuint create_texture_8b(image_blocks blocks, tiff_data_desc const & image_desc, row_order rows) {
+	texture_storage const storage = create_texture_storage_8b(image_desc);
 
-tuple<GLuint, size_t, size_t> create_texture_8b(path const & fname) {
-	// TODO: implement ...
-	auto const [image_data, image_desc] = [&fname](){
-		if (is_tiff(fname))
-			return load_tiff_desc(fname, true);
-		else
-			throw std::runtime_error("unsupported texture format (only TIFF (*.tif) suported");
-	}();
+	glBindTexture(GL_TEXTURE_2D, storage.texture);
+	upload(blocks, image_desc, storage.format, storage.type, rows);
+	glBindTexture(GL_TEXTURE_2D, 0);  // unbint texture
 
-	// TODO: we need to flip the data there
+	return storage.texture;
+}
 
-	spdlog::info("{} ({}x{}) image loaded", fname.c_str(), image_desc.width, image_desc.height);
+mapped_tiff map_texture_image(path const & fname, unsigned level) {
+	if (!is_tiff(fname))
+		throw std::runtime_error("unsupported texture format (only TIFF (*.tif) suported");
+	return mapped_tiff{fname, 0, level};  // decode with all cores in case of compressed image
+}
 
-	if (!is_rgb(image_desc))
-		throw std::runtime_error{"only 8bit RGB textures are supported"};
+}  // namespace
 
-	GLuint tbo;
-	glGenTextures(1, &tbo);
-	glBindTexture(GL_TEXTURE_2D, tbo);
+texture_storage create_texture_storage_16b(tiff_data_desc const & image_desc) {
+	return create_storage_16b(GL_TEXTURE_2D, image_desc, 1);
+}
 
-	// TODO: this is inefficient, we want to get rid of that ALIGNMENT
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // tell OpenGL to change aligment from 4 to 1 to read RGB textures
+texture_storage create_texture_storage_8b(tiff_data_desc const & image_desc) {
+	return create_storage_8b(GL_TEXTURE_2D, image_desc, 1);
+}
 
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, image_desc.width, image_desc.height);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_desc.width, image_desc.height, GL_RGB, GL_UNSIGNED_BYTE, image_data.get());
+texture_storage create_texture_array_storage_16b(tiff_data_desc const & image_desc, unsigned layers) {
+	return create_storage_16b(GL_TEXTURE_2D_ARRAY, image_desc, layers);
+}
 
-	// in case of wrapping, we want to be able to easilly see it in scene as red color
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, value_ptr(vec4{rgb::red, 1.0}));
+texture_storage create_texture_array_storage_8b(tiff_data_desc const & image_desc, unsigned layers) {
+	return create_storage_8b(GL_TEXTURE_2D_ARRAY, image_desc, layers);
+}
 
-	// set texture filtering (interpolation) mode (if GL_LINEAR is set, we can see artifacts in a scene)
+void upload_rows(texture_storage const & storage, size_t y, size_t width, size_t rows, void const * pixels) {
+	glBindTexture(storage.target, storage.texture);
+	if (storage.target == GL_TEXTURE_2D_ARRAY)
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, y, storage.layer, width, rows, 1, storage.format, storage.type, pixels);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rows, storage.format, storage.type, pixels);
+}
+
+void upload_texture(texture_storage const & storage, byte const * pixels, tiff_data_desc const & desc) {
+	GLint unpack_alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // rows are tightly packed
+
+	upload_rows(storage, 0, desc.width, desc.height, pixels);
+
+	glBindTexture(storage.target, 0);  // unbint texture
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+}
+
+texture_storage create_normal_map_storage(tiff_data_desc const & desc) {
+	assert(desc.bytes_per_sample == 1 && desc.samples_per_pixel == 2 && "baked normal map expected");
+
+	texture_storage storage = {.texture=0, .format=GL_RG, .type=GL_BYTE, .target=GL_TEXTURE_2D, .layer=0};
+	glGenTextures(1, &storage.texture);
+	glBindTexture(GL_TEXTURE_2D, storage.texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG8_SNORM, desc.width, desc.height);
+
+	// shaders read normals by texelFetch
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
 	glBindTexture(GL_TEXTURE_2D, 0);  // unbint texture
 
+	return storage;
+}
+
+GLuint create_normal_map_texture(byte const * pixels, tiff_data_desc const & desc) {
+	texture_storage const storage = create_normal_map_storage(desc);
+	upload_texture(storage, pixels, desc);
+	return storage.texture;
+}
+
+tuple<GLuint, size_t, size_t> create_texture_16b(path const & fname, row_order rows, unsigned level) {
+	mapped_tiff const image = map_texture_image(fname, level);
+	tiff_data_desc const & image_desc = image.desc();
+
+	spdlog::info("{} ({}x{}, level {}) image loaded", fname.c_str(), image_desc.width, image_desc.height, level);
+
+	GLuint tbo;
+	if (byte const * pixels = image.data()) {  // one upload call for whole image
+		mapped_tiff::block const whole = whole_image(pixels, image_desc);
+		tbo = create_texture_16b(image_blocks{&whole, 1}, image_desc, rows);
+	}
+	else
+		tbo = create_texture_16b(image.blocks(), image_desc, rows);
+
+	return {tbo, image_desc.width, image_desc.height};
+}
+
+tuple<GLuint, size_t, size_t> create_texture_8b(path const & fname, row_order rows, unsigned level) {
+	mapped_tiff const image = map_texture_image(fname, level);
+	tiff_data_desc const & image_desc = image.desc();
+
+	spdlog::info("{} ({}x{}, level {}) image loaded", fname.c_str(), image_desc.width, image_desc.height, level);
+
+	GLuint tbo;
+	if (byte const * pixels = image.data()) {  // one upload call for whole image
+		mapped_tiff::block const whole = whole_image(pixels, image_desc);
+		tbo = create_texture_8b(image_blocks{&whole, 1}, image_desc, rows);
+	}
+	else
+		tbo = create_texture_8b(image.blocks(), image_desc, rows);
+
 	return {tbo, image_desc.width, image_desc.height};
 }
 
+GLuint create_texture_16b(byte const * pixels, tiff_data_desc const & desc, row_order rows) {
+	mapped_tiff::block const whole = whole_image(pixels, desc);
+	return create_texture_16b(image_blocks{&whole, 1}, desc, rows);
+}
+
+GLuint create_texture_8b(byte const * pixels, tiff_data_desc const & desc, row_order rows) {
+	mapped_tiff::block const whole = whole_image(pixels, desc);
+	return create_texture_8b(image_blocks{&whole, 1}, desc, rows);
+}
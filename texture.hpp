@@ -3,10 +3,63 @@ OpenGL textures support. */
 #pragma once
 #include <tuple>
 #include <filesystem>
+#include <cstddef>
 #include <GLES3/gl32.h>
+#include "tiff.hpp"
+
+//! Order of texture rows in texture memory.
+enum class row_order {
+	bottom_up,  //!< first texture row is the bottom image row (OpenGL convention), image is flipped while uploaded
+	top_down  //!< image rows uploaded as stored in a file (no flip), shaders needs to flip t texture coordinate
+};
 
 /*! Creates 16bit INT GRAY or RGB OpenGL texture from TIFF image \c fname file and returns
 OpenGL texture ID.
+\param rows With row_order::top_down image is uploaded straight from (mapped) file memory by one
+upload call per strip (or tile) and shaders are expected to sample with `vec2(s, 1-t)`.
+\param level TIFF image level, 0 is full resolution image and next levels are overviews (see
+`split_tiles --overviews`), only the level image is read from the file.
 \return (TBO, width, height) triplet. */
-std::tuple<GLuint, size_t, size_t> create_texture_16b(std::filesystem::path const & fname);
-std::tuple<GLuint, size_t, size_t> create_texture_8b(std::filesystem::path const & fname);
+std::tuple<GLuint, size_t, size_t> create_texture_16b(std::filesystem::path const & fname,
+	row_order rows = row_order::bottom_up, unsigned level = 0);
+
+std::tuple<GLuint, size_t, size_t> create_texture_8b(std::filesystem::path const & fname,
+	row_order rows = row_order::bottom_up, unsigned level = 0);
+
+/*! Creates texture from \c pixels image data stored continuously as top-down rows (e.g. tile pack
+payload), with row_order::top_down by one upload call.
+\return OpenGL texture ID. */
+GLuint create_texture_16b(std::byte const * pixels, tiff_data_desc const & desc, row_order rows);
+GLuint create_texture_8b(std::byte const * pixels, tiff_data_desc const & desc, row_order rows);
+
+//! Texture with allocated (not yet uploaded) storage and pixel transfer format.
+struct texture_storage {
+	GLuint texture;
+	GLenum format,  //!< pixel format for glTexSubImage2D (e.g. GL_RED_INTEGER)
+		type;  //!< pixel type for glTexSubImage2D (e.g. GL_UNSIGNED_SHORT)
+	GLenum target = GL_TEXTURE_2D;  //!< GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+	GLint layer = 0;  //!< texture array layer to upload pixels to
+};
+
+/*! Creates texture the same way as create_texture_16b() and create_texture_8b() without pixels
+upload (e.g. to stream pixels later, see `texture_streamer.hpp`). */
+texture_storage create_texture_storage_16b(tiff_data_desc const & desc);
+texture_storage create_texture_storage_8b(tiff_data_desc const & desc);
+
+/*! Creates texture array for \c layers same size images (e.g. terrain tiles), layer textures are
+created the same way as create_texture_storage_16b() and create_texture_storage_8b(). */
+texture_storage create_texture_array_storage_16b(tiff_data_desc const & desc, unsigned layers);
+texture_storage create_texture_array_storage_8b(tiff_data_desc const & desc, unsigned layers);
+
+//! Creates GL_RG8_SNORM texture for a baked normal map (see `normal_map.hpp`) without pixels upload.
+texture_storage create_normal_map_storage(tiff_data_desc const & desc);
+
+//! Creates GL_RG8_SNORM texture from baked normal map \c pixels (top-down rows). \returns OpenGL texture ID.
+GLuint create_normal_map_texture(std::byte const * pixels, tiff_data_desc const & desc);
+
+/*! Uploads \c rows top-down image rows starting with row \c y into level 0 of \c storage texture (or
+texture array layer), \c pixels rows are expected to be tightly packed. */
+void upload_rows(texture_storage const & storage, size_t y, size_t width, size_t rows, void const * pixels);
+
+//! Uploads whole \c pixels image (top-down rows) into \c storage texture (or texture array layer).
+void upload_texture(texture_storage const & storage, std::byte const * pixels, tiff_data_desc const & desc);
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include "texture_residency.hpp"
+
+using std::vector, std::pair, std::optional;
+
+texture_residency::texture_residency(size_t byte_budget)
+	: _byte_budget{byte_budget} {}
+
+void texture_residency::add(tile_id const & id, size_t bytes) {
+	remove(id);  // in case of re-upload
+	_tiles[id] = resident_tile{.bytes=bytes, .last_visible=_frame};  // tiles are requested once visible
+	_size += bytes;
+}
+
+void texture_residency::remove(tile_id const & id) {
+	auto it = _tiles.find(id);
+	if (it == end(_tiles))
+		return;
+
+	_size -= it->second.bytes;
+	_tiles.erase(it);
+}
+
+void texture_residency::touch(tile_id const & id) {
+	if (auto it = _tiles.find(id); it != end(_tiles))
+		it->second.last_visible = _frame;
+}
+
+vector<tile_id> texture_residency::end_frame() {
+	vector<tile_id> evicted;
+
+	if (_size > _byte_budget) {
+		vector<pair<uint64_t, tile_id>> candidates;  // (last visible frame, tile)
+		for (auto const & [id, tile] : _tiles)
+			if (tile.last_visible < _frame)  // not visible in this frame
+				candidates.emplace_back(tile.last_visible, id);
+
+		std::sort(begin(candidates), end(candidates));  // least recently visible first
+
+		for (auto const & [last_visible, id] : candidates) {
+			if (_size <= _byte_budget)
+				break;
+			remove(id);
+			evicted.push_back(id);
+		}
+	}
+
+	++_frame;
+	return evicted;
+}
+
+optional<tile_id> texture_residency::evict_least_recent() {
+	auto victim = end(_tiles);
+	for (auto it = begin(_tiles); it != end(_tiles); ++it) {
+		if (it->second.last_visible + 1 >= _frame)  // visible in the current or the previous frame
+			continue;
+		if (victim == end(_tiles) || it->second.last_visible < victim->second.last_visible)
+			victim = it;
+	}
+
+	if (victim == end(_tiles))
+		return std::nullopt;
+
+	tile_id const id = victim->first;
+	remove(id);
+	return id;
+}
@@ -0,0 +1,61 @@
+/*! \file
+GPU texture residency tracking with a memory budget. Tracks estimated texture bytes of resident
+(uploaded) tiles and the last frame each tile was visible. When over budget, least recently visible
+tiles are selected for eviction, tiles visible in the current frame are never evicted.
+\code
+texture_residency residency{512*1024*1024};
+residency.add(id, texture_bytes(elevation_desc) + texture_bytes(satellite_desc));  // after upload
+// ...
+residency.touch(id);  // tile visible in the frame
+// ...
+for (tile_id const & id : residency.end_frame())  // at the end of frame
+	delete_tile_textures(id);
+\endcode */
+#pragma once
+#include <map>
+#include <optional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "tiff.hpp"
+#include "tile_loader.hpp"
+
+class texture_residency {
+public:
+	explicit texture_residency(size_t byte_budget);
+
+	void add(tile_id const & id, size_t bytes);  //!< Tile textures were uploaded.
+	void remove(tile_id const & id);  //!< Tile textures were deleted.
+	void touch(tile_id const & id);  //!< Tile is visible in the current frame.
+	[[nodiscard]] bool contains(tile_id const & id) const {return _tiles.contains(id);}
+
+	/*! Finishes frame and stops tracking of tiles selected for eviction.
+	\returns Least recently visible tiles to evict (textures to delete) to get in budget. */
+	[[nodiscard]] std::vector<tile_id> end_frame();
+
+	/*! Stops tracking of the least recently visible tile not visible in the current and the previous
+	frame (e.g. to reuse its texture array layer for a newly loaded tile).
+	\returns Tile to evict or nothing in case all tiles are (recently) visible. */
+	[[nodiscard]] std::optional<tile_id> evict_least_recent();
+
+	[[nodiscard]] size_t size() const {return _size;}  //!< \returns Resident texture bytes.
+	[[nodiscard]] size_t count() const {return std::size(_tiles);}  //!< \returns Number of resident tiles.
+	[[nodiscard]] size_t byte_budget() const {return _byte_budget;}
+
+private:
+	struct resident_tile {
+		size_t bytes;
+		uint64_t last_visible;  //!< frame number, uploaded tiles count as visible in the upload frame
+	};
+
+	size_t const _byte_budget;
+	size_t _size = 0;
+	uint64_t _frame = 1;
+	std::map<tile_id, resident_tile> _tiles;
+};
+
+//! \returns Estimated GPU memory size of an image texture (3 channel textures are expected to be padded to 4 channels).
+constexpr size_t texture_bytes(tiff_data_desc const & desc) {
+	size_t const channels = desc.samples_per_pixel == 3 ? 4 : desc.samples_per_pixel;
+	return desc.width*desc.height*desc.bytes_per_sample*channels;
+}
@@ -175,11 +175,11 @@ tuple<unique_ptr<byte>, tiff_data_desc> load_tiff(path const & tiff_file) {
 	assert(samples_per_pixel == 1 || samples_per_pixel == 3);  // expect GRAY or RGB images
 
 	// read strip by strip and store it into whole image
-	unsigned const image_size = image_w*image_h*(bits_per_sample/8)*samples_per_pixel;
+	size_t const image_size = size_t{image_w}*image_h*(bits_per_sample/8)*samples_per_pixel;
 	unique_ptr<byte> image_data{new byte[image_size]};
 	memset(image_data.get(), 0xff, image_size);   // clear buffer
 	for (tstrip_t strip = 0; strip < strip_count; ++strip) {
-		unsigned const offset = strip*strip_size;
+		size_t const offset = size_t{strip}*strip_size;
 		uint8_t * buf = reinterpret_cast<uint8_t *>(image_data.get()) + offset;
 		tmsize_t ret = TIFFReadEncodedStrip(tiff, strip, buf, (tsize_t)-1);
 		assert(ret != -1 && ret > 0);
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+#include <cstring>
+#include <fmt/core.h>
+#include "texture_streamer.hpp"
+
+using std::vector;
+using std::chrono::steady_clock;
+
+texture_streamer::texture_streamer(size_t buffer_size, unsigned buffer_count)
+	: _buffer_size{buffer_size} {
+	assert(buffer_count > 0);
+
+	vector<GLuint> pbos(buffer_count);
+	glGenBuffers(buffer_count, pbos.data());
+	for (GLuint pbo : pbos) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, _buffer_size, nullptr, GL_STREAM_DRAW);
+		_buffers.push_back(ring_buffer{.pbo=pbo});
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+texture_streamer::~texture_streamer() {
+	for (ring_buffer & buf : _buffers) {
+		if (buf.fence)
+			glDeleteSync(buf.fence);
+		glDeleteBuffers(1, &buf.pbo);
+	}
+}
+
+void texture_streamer::push(texture_storage const & storage, decoded_image const & image) {
+	tiff_data_desc const & desc = image.desc;
+	size_t const row_size = desc.width*desc.bytes_per_sample*desc.samples_per_pixel;
+	if (row_size > _buffer_size)
+		throw std::runtime_error{fmt::format("image row ({} bytes) does not fit into upload buffer ({} bytes)",
+			row_size, _buffer_size)};
+
+	_queue.push_back(upload_job{.storage=storage, .image=image, .row=0});
+	_queued_bytes += image.size();
+}
+
+void texture_streamer::cancel(texture_storage const & storage) {
+	auto it = std::ranges::find_if(_queue, [&storage](upload_job const & job){
+		return job.storage.texture == storage.texture && job.storage.layer == storage.layer;
+	});
+	if (it == end(_queue))
+		return;
+
+	tiff_data_desc const & desc = it->image.desc;
+	_queued_bytes -= (desc.height - it->row)*desc.width*desc.bytes_per_sample*desc.samples_per_pixel;
+	_queue.erase(it);
+}
+
+vector<texture_storage> texture_streamer::upload(size_t byte_budget, steady_clock::duration time_budget) {
+	vector<texture_storage> uploaded;
+	if (empty(_queue))
+		return uploaded;
+
+	auto const t0 = steady_clock::now();
+
+	GLint unpack_alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // rows are tightly packed
+
+	size_t uploaded_bytes = 0;
+	while (!empty(_queue) && uploaded_bytes < byte_budget && steady_clock::now() - t0 < time_budget) {
+		ring_buffer & buf = _buffers[_next_buffer];
+		if (!available(buf))
+			break;  // GPU still reads all ring buffers, continue next frame
+
+		upload_job & job = _queue.front();
+		tiff_data_desc const & desc = job.image.desc;
+		size_t const row_size = desc.width*desc.bytes_per_sample*desc.samples_per_pixel,
+			rows = std::min(desc.height - job.row, _buffer_size / row_size),
+			chunk_size = rows*row_size;
+
+		// copy chunk rows into the buffer (buffer content is invalidated, GPU is done with it)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf.pbo);
+		void * dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, chunk_size,
+			GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
+		assert(dst && "unable to map pixel buffer");
+		memcpy(dst, job.image.data() + job.row*row_size, chunk_size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// upload from the bound buffer (data pointer is a buffer offset)
+		upload_rows(job.storage, job.row, desc.width, rows, nullptr);
+		glBindTexture(job.storage.target, 0);
+		buf.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		_next_buffer = (_next_buffer + 1) % std::size(_buffers);
+		job.row += rows;
+		uploaded_bytes += chunk_size;
+		_queued_bytes -= chunk_size;
+
+		if (job.row == desc.height) {  // texture uploaded
+			uploaded.push_back(job.storage);
+			_queue.pop_front();
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+
+	return uploaded;
+}
+
+bool texture_streamer::available(ring_buffer & buf) {
+	if (!buf.fence)
+		return true;
+
+	GLenum const status = glClientWaitSync(buf.fence, 0, 0);  // no wait
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	glDeleteSync(buf.fence);
+	buf.fence = nullptr;
+	return true;  // GL_ALREADY_SIGNALED, GL_CONDITION_SATISFIED (or GL_WAIT_FAILED)
+}
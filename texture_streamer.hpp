@@ -0,0 +1,69 @@
+/*! \file
+Streaming texture uploader. Texture pixels are copied into a ring of pixel buffer objects (PBO) and
+uploaded from the buffers by glTexSubImage2D calls, so the upload does not block on client memory
+transfer. Each ring buffer is guarded by a fence, a buffer still read by GPU is never written (the
+upload continues next frame instead of stalling). Images are uploaded in row chunks limited by a per
+frame byte (and time) budget.
+\code
+texture_streamer streamer;
+texture_storage const elevation = create_texture_storage_16b(image.desc);
+streamer.push(elevation, image);
+// ...
+for (texture_storage const & uploaded : streamer.upload(8*1024*1024))  // once per frame
+	use(uploaded.texture);  // texture is completely uploaded
+\endcode */
+#pragma once
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <GLES3/gl32.h>
+#include "texture.hpp"
+#include "tile_loader.hpp"
+
+class texture_streamer {
+public:
+	/*! \param buffer_size Size of one ring buffer in bytes (the biggest upload chunk), at least one image row.
+	\param buffer_count Number of ring buffers. */
+	explicit texture_streamer(size_t buffer_size = 4*1024*1024, unsigned buffer_count = 3);
+	~texture_streamer();
+
+	texture_streamer(texture_streamer const &) = delete;
+	texture_streamer & operator=(texture_streamer const &) = delete;
+
+	/*! Queues image (top-down rows) upload into level 0 of \c storage texture or texture array layer (textures
+	are uploaded in FIFO order), texture needs to be alive until upload is finished or cancel() is called. */
+	void push(texture_storage const & storage, decoded_image const & image);
+
+	void cancel(texture_storage const & storage);  //!< Removes texture (layer) from the upload queue (e.g. before the texture is deleted).
+
+	/*! Uploads queued textures until \c byte_budget bytes are uploaded, \c time_budget passed or all ring
+	buffers are in use by GPU (at least one chunk is uploaded if there is a free buffer).
+	\returns Textures (layers) uploaded completely by the call. */
+	std::vector<texture_storage> upload(size_t byte_budget,
+		std::chrono::steady_clock::duration time_budget = std::chrono::steady_clock::duration::max());
+
+	[[nodiscard]] size_t queue_depth() const {return std::size(_queue);}  //!< \returns Number of not yet uploaded textures.
+	[[nodiscard]] size_t queued_bytes() const {return _queued_bytes;}  //!< \returns Not yet uploaded bytes.
+
+private:
+	struct upload_job {
+		texture_storage storage;
+		decoded_image image;
+		size_t row;  //!< next row to upload
+	};
+
+	struct ring_buffer {
+		GLuint pbo;
+		GLsync fence = nullptr;  //!< last upload from the buffer
+	};
+
+	//! \returns True if the buffer can be written (GPU finished reading the buffer), never waits.
+	static bool available(ring_buffer & buf);
+
+	size_t const _buffer_size;
+	std::vector<ring_buffer> _buffers;
+	size_t _next_buffer = 0;
+	std::deque<upload_job> _queue;
+	size_t _queued_bytes = 0;
+};
@@ -1,8 +1,16 @@
+#include <algorithm>
+#include <exception>
 #include <fstream>
 #include <limits>
+#include <thread>
+#include <vector>
 #include <cassert>
 #include <cstring>
-#include <boost/gil.hpp>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <tiffio.hxx>
 #include "tiff.hpp"
 
@@ -10,7 +18,9 @@ using std::tuple, std::byte,
 	std::unique_ptr,
 	std::filesystem::path,
 	std::ifstream,
-	std::move, std::swap,
+	std::vector, std::size, std::empty,
+	std::jthread,
+	std::move,
 	std::numeric_limits;
 
 // Custom warning handler (does nothing to suppress warnings)
@@ -18,14 +28,248 @@ static void suppress_tiff_warnings(char const * module, char const * fmt, va_lis
 	// Do nothing, effectively suppressing warnings
 }
 
+namespace {
+
+//! Strip or tile organization of TIFF image data.
+struct tiff_block_layout {
+	size_t width, height,  //!< image size in pixels
+		pixel_size;  //!< in bytes
+	bool tiled;
+	size_t block_count = 0,
+		block_w = 0, block_h = 0;  //!< strip (image_w x rows_per_strip) or tile size in pixels
+	size_t block_size = 0;  //!< decoded block size in bytes
+};
+
+tiff_block_layout get_block_layout(TIFF * tiff, size_t image_w, size_t image_h, size_t pixel_size) {
+	tiff_block_layout layout = {
+		.width=image_w,
+		.height=image_h,
+		.pixel_size=pixel_size,
+		.tiled=TIFFIsTiled(tiff) != 0
+	};
+
+	if (layout.tiled) {
+		uint32_t tile_w = 0,
+			tile_h = 0;
+		TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &tile_w);
+		TIFFGetField(tiff, TIFFTAG_TILELENGTH, &tile_h);
+		layout.block_count = TIFFNumberOfTiles(tiff);
+		layout.block_w = tile_w;
+		layout.block_h = tile_h;
+		layout.block_size = TIFFTileSize(tiff);
+	}
+	else {
+		uint32_t rows_per_strip = 0;
+		TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+		layout.block_count = TIFFNumberOfStrips(tiff);
+		layout.block_w = image_w;
+		layout.block_h = std::min<size_t>(rows_per_strip, image_h);
+		layout.block_size = TIFFStripSize(tiff);
+	}
+
+	return layout;
+}
+
+//! Throws \c block (strip or tile) read error of \c tiff image.
+[[noreturn]] void throw_block_read_error(TIFF * tiff, size_t block) {
+	throw std::runtime_error{fmt::format("can't read {} {} of '{}' file", TIFFIsTiled(tiff) ? "tile" : "strip", block,
+		TIFFFileName(tiff))};
+}
+
+//! Reverses order of \c rows rows (each \c row_size bytes long) in place.
+void reverse_rows(byte * pixels, size_t rows, size_t row_size) {
+	for (size_t top = 0, bottom = rows - 1; top < bottom; ++top, --bottom)
+		std::swap_ranges(pixels + top*row_size, pixels + (top+1)*row_size, pixels + bottom*row_size);
+}
+
+/*! Decodes blocks `first, first+step, first+2*step, ...` into \c image buffer. Strips are decoded
+straight into the image, tiles are decoded into a tile buffer first and then copied (tiles on the right
+and bottom image edges needs to be clipped).
+\param flip Write image rows in reverse order (bottom row first). Strips are decoded into the flipped
+strip position and its rows are then reversed in place (while the strip is still in cache), tile rows
+are copied into flipped positions. */
+void read_blocks(TIFF * tiff, tiff_block_layout const & layout, byte * image, size_t first, size_t step,
+	bool flip = false) {
+
+	size_t const image_row_size = layout.width * layout.pixel_size;
+
+	if (!layout.tiled) {
+		for (size_t strip = first; strip < layout.block_count; strip += step) {
+			size_t const y = strip*layout.block_h,
+				h = std::min(layout.block_h, layout.height - y);
+
+			byte * buf = image + (flip ? layout.height - y - h : y)*image_row_size;
+			tmsize_t ret = TIFFReadEncodedStrip(tiff, strip, buf, h*image_row_size);
+			if (ret <= 0)
+				throw_block_read_error(tiff, strip);
+
+			if (flip)
+				reverse_rows(buf, h, image_row_size);
+		}
+		return;
+	}
+
+	vector<byte> tile_buf(layout.block_size);
+	size_t const tiles_across = (layout.width + layout.block_w - 1) / layout.block_w,
+		tile_row_size = layout.block_w * layout.pixel_size;
+
+	for (size_t tile = first; tile < layout.block_count; tile += step) {
+		tmsize_t ret = TIFFReadEncodedTile(tiff, tile, tile_buf.data(), size(tile_buf));
+		if (ret <= 0)
+			throw_block_read_error(tiff, tile);
+
+		size_t const x = (tile % tiles_across) * layout.block_w,
+			y = (tile / tiles_across) * layout.block_h,
+			w = std::min(layout.block_w, layout.width - x),
+			h = std::min(layout.block_h, layout.height - y);
+
+		for (size_t r = 0; r < h; ++r) {
+			size_t const dst_row = flip ? layout.height - 1 - (y+r) : y+r;
+			memcpy(image + dst_row*image_row_size + x*layout.pixel_size, tile_buf.data() + r*tile_row_size, w*layout.pixel_size);
+		}
+	}
+}
+
+//! Image area in pixels.
+struct image_window {
+	size_t x, y,
+		w, h;
+};
+
+/*! Decodes strips (tiles) overlapping \c window (which needs to be inside the image) and copies window
+pixels into \c dst buffer with \c dst_row_size bytes per row. */
+void read_window(TIFF * tiff, tiff_block_layout const & layout, image_window const & window,
+	byte * dst, size_t dst_row_size, vector<byte> & block_buf) {
+
+	assert(window.x + window.w <= layout.width && window.y + window.h <= layout.height);
+
+	if (window.w == 0 || window.h == 0)
+		return;
+
+	block_buf.resize(layout.block_size);
+	size_t const block_row_size = layout.block_w * layout.pixel_size,
+		blocks_across = (layout.width + layout.block_w - 1) / layout.block_w;
+
+	for (size_t by = window.y / layout.block_h; by <= (window.y + window.h - 1) / layout.block_h; ++by) {
+		for (size_t bx = window.x / layout.block_w; bx <= (window.x + window.w - 1) / layout.block_w; ++bx) {
+			size_t const block = by*blocks_across + bx;
+			tmsize_t const ret = layout.tiled ?
+				TIFFReadEncodedTile(tiff, block, block_buf.data(), size(block_buf)) :
+				TIFFReadEncodedStrip(tiff, block, block_buf.data(), size(block_buf));
+			if (ret <= 0)
+				throw_block_read_error(tiff, block);
+
+			// copy block and window intersection
+			size_t const x0 = std::max(window.x, bx*layout.block_w),
+				x1 = std::min(window.x + window.w, (bx+1)*layout.block_w),
+				y0 = std::max(window.y, by*layout.block_h),
+				y1 = std::min(window.y + window.h, (by+1)*layout.block_h);
+
+			for (size_t y = y0; y < y1; ++y)
+				memcpy(dst + (y - window.y)*dst_row_size + (x0 - window.x)*layout.pixel_size,
+					block_buf.data() + (y - by*layout.block_h)*block_row_size + (x0 - bx*layout.block_w)*layout.pixel_size,
+					(x1 - x0)*layout.pixel_size);
+		}
+	}
+}
+
+/*! Runs `fn(worker)` for `worker = 0, ..., thread_count-1` in parallel (worker 0 runs in the calling
+thread) and rethrows the first exception thrown by a worker. */
+template <typename WorkerFn>
+void run_workers(unsigned thread_count, WorkerFn fn) {
+	vector<std::exception_ptr> errors(thread_count);
+	{
+		vector<jthread> workers;
+		for (unsigned worker = 1; worker < thread_count; ++worker) {
+			workers.emplace_back([&, worker]{
+				try {
+					fn(worker);
+				}
+				catch (...) {
+					errors[worker] = std::current_exception();
+				}
+			});
+		}
+
+		fn(0);
+	}  // join workers
+
+	for (std::exception_ptr const & e : errors)
+		if (e)
+			std::rethrow_exception(e);
+}
+
+//! \returns Number of decoding threads to use for \c layout image (0 means all cores).
+unsigned decoding_threads(unsigned thread_count, tiff_block_layout const & layout) {
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	return std::min<size_t>(thread_count, layout.block_count);
+}
+
+//! TIFF file content in a memory (e.g. memory mapped file) for TIFFClientOpen().
+struct memory_source {
+	byte const * data;
+	size_t size,
+		pos = 0;
+};
+
+tmsize_t memory_read(thandle_t h, void * buf, tmsize_t n) {
+	memory_source & src = *static_cast<memory_source *>(h);
+	size_t const count = std::min<size_t>(n, src.size - std::min(src.pos, src.size));
+	memcpy(buf, src.data + src.pos, count);
+	src.pos += count;
+	return count;
+}
+
+tmsize_t memory_write(thandle_t, void *, tmsize_t) {
+	return 0;  // read only
+}
+
+toff_t memory_seek(thandle_t h, toff_t off, int whence) {
+	memory_source & src = *static_cast<memory_source *>(h);
+	switch (whence) {
+		case SEEK_SET: src.pos = off; break;
+		case SEEK_CUR: src.pos += off; break;
+		case SEEK_END: src.pos = src.size + off; break;
+	}
+	return src.pos;
+}
+
+int memory_close(thandle_t) {
+	return 0;
+}
+
+toff_t memory_size(thandle_t h) {
+	return static_cast<memory_source *>(h)->size;
+}
+
+int memory_map(thandle_t h, void ** base, toff_t * size) {  // let libtiff read strips directly from memory
+	memory_source & src = *static_cast<memory_source *>(h);
+	*base = const_cast<byte *>(src.data);
+	*size = src.size;
+	return 1;
+}
+
+void memory_unmap(thandle_t, void *, toff_t) {}
+
+//! \param name File name used by error messages.
+TIFF * open_memory_tiff(memory_source & src, char const * name = "memory") {
+	return TIFFClientOpen(name, "r", &src, memory_read, memory_write, memory_seek, memory_close,
+		memory_size, memory_map, memory_unmap);
+}
+
+}  // namespace
+
 tuple<unique_ptr<byte>, size_t, size_t> load_tiff(path const & tiff_file) {
 	ifstream fin{tiff_file};
-	assert(fin.is_open());
+	if (!fin.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' file", tiff_file.c_str())};
 
 	TIFFSetWarningHandler(suppress_tiff_warnings);
 
-	TIFF * tiff = TIFFStreamOpen("memory", &fin);
-	assert(tiff);
+	TIFF * tiff = TIFFStreamOpen(tiff_file.c_str(), &fin);
+	if (!tiff)
+		throw std::runtime_error{fmt::format("'{}' is not a TIFF file", tiff_file.c_str())};
 
 	// image w, h
 	uint32_t image_w = 0,
@@ -52,15 +296,18 @@ tuple<unique_ptr<byte>, size_t, size_t> load_tiff(path const & tiff_file) {
 	// TODO: we expect 1
 
 	// read strip by strip and store it into whole image
-	unsigned const image_size = image_w*image_h*(bits_per_sample/8)*samples_per_pixel;
+	size_t const image_size = size_t{image_w}*image_h*(bits_per_sample/8)*samples_per_pixel;
 	unique_ptr<byte> image_data{new byte[image_size]};
 	memset(image_data.get(), 0xff, image_size);
 	for (tstrip_t strip = 0; strip < strip_count; ++strip) {
-		unsigned offset = strip*(strip_size/2);
+		size_t const offset = size_t{strip}*(strip_size/2);
 		uint16_t * buf = reinterpret_cast<uint16_t *>(image_data.get()) + offset;
 		// cout << "buf=" << std::hex << uint64_t(buf) << ", offset=" << offset << '\n';
 		tmsize_t ret = TIFFReadEncodedStrip(tiff, strip, buf, (tsize_t)-1);
-		assert(ret != -1 && ret > 0);
+		if (ret <= 0) {
+			TIFFClose(tiff);
+			throw std::runtime_error{fmt::format("can't read strip {} of '{}' file", strip, tiff_file.c_str())};
+		}
 	}
 
 	TIFFClose(tiff);
@@ -69,32 +316,22 @@ tuple<unique_ptr<byte>, size_t, size_t> load_tiff(path const & tiff_file) {
 	return {std::move(image_data), (size_t)image_w, (size_t)image_h};
 }
 
-// TODO: make proper doxygen documentation
-template <typename PixelType>  // e.g. rgb8_pixel_t, gray8_pixel_t, ...
-unique_ptr<byte> flip_copy(byte const * pixels, size_t w, size_t h, size_t image_size) {
-	using boost::gil::interleaved_view,
-		boost::gil::flipped_up_down_view,
-		boost::gil::copy_pixels,
-		boost::gil::type_from_x_iterator;
-
-	using view_t = typename type_from_x_iterator<PixelType *>::view_t;
-
-	view_t pixel_view = interleaved_view(w, h, (PixelType *)pixels, w*sizeof(PixelType));
-	view_t flipped_view = flipped_up_down_view(pixel_view);
-
-	unique_ptr<byte> flipped_pixels{new byte[image_size]};
-	copy_pixels(flipped_view, interleaved_view(w, h, (PixelType *)flipped_pixels.get(), w*sizeof(PixelType)));
-	return flipped_pixels;
-}
-
-tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_desc(path const & tiff_file, bool flip) {
+tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_desc(path const & tiff_file, bool flip, unsigned thread_count,
+	unsigned level) {
 	ifstream fin{tiff_file};
-	assert(fin.is_open());
+	if (!fin.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' file", tiff_file.c_str())};
 
 	TIFFSetWarningHandler(suppress_tiff_warnings);
 
-	TIFF * tiff = TIFFStreamOpen("memory", &fin);
-	assert(tiff);
+	TIFF * tiff = TIFFStreamOpen(tiff_file.c_str(), &fin);
+	if (!tiff)
+		throw std::runtime_error{fmt::format("'{}' is not a TIFF file", tiff_file.c_str())};
+
+	if (!TIFFSetDirectory(tiff, level)) {
+		TIFFClose(tiff);
+		throw std::runtime_error{fmt::format("'{}' level not available in '{}' file", level, tiff_file.c_str())};
+	}
 
 	// image w, h
 	uint32_t image_w = 0,
@@ -102,13 +339,6 @@ tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_desc(path const & tiff_file, b
 	TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &image_w);
 	TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &image_h);
 
-	// strip related stuff
-	tstrip_t const strip_count = TIFFNumberOfStrips(tiff);
-	tmsize_t const strip_size = TIFFStripSize(tiff);
-
-	uint32_t rows_per_strip = 0;
-	TIFFGetField(tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
-
 	uint16_t bits_per_sample = 0;
 	TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
 
@@ -120,15 +350,49 @@ tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_desc(path const & tiff_file, b
 	TIFFGetField(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
 	assert(samples_per_pixel == 1 || samples_per_pixel == 3);  // expect GRAY or RGB images
 
-	// read strip by strip and store it into whole image
-	unsigned const image_size = image_w*image_h*(bits_per_sample/8)*samples_per_pixel;
+	tiff_block_layout const layout = get_block_layout(tiff, image_w, image_h, (bits_per_sample/8)*samples_per_pixel);
+
+	// read block (strip or tile) by block and store it into whole image
+	size_t const image_size = size_t{image_w}*image_h*(bits_per_sample/8)*samples_per_pixel;
 	unique_ptr<byte> image_data{new byte[image_size]};
 	memset(image_data.get(), 0xff, image_size);   // (optional) clear buffer
-	for (tstrip_t strip = 0; strip < strip_count; ++strip) {
-		unsigned const offset = strip*strip_size;
-		uint8_t * buf = reinterpret_cast<uint8_t *>(image_data.get()) + offset;
-		tmsize_t ret = TIFFReadEncodedStrip(tiff, strip, buf, (tsize_t)-1);
-		assert(ret != -1 && ret > 0);
+
+	thread_count = decoding_threads(thread_count, layout);
+
+	try {
+		if (thread_count <= 1)
+			read_blocks(tiff, layout, image_data.get(), 0, 1, flip);
+		else {
+			/* Each worker decodes every thread_count-th block with its own TIFF handle (a TIFF handle is not
+			thread safe), blocks do not overlap in the destination buffer so no synchronization is needed. */
+			run_workers(thread_count, [&](unsigned worker){
+				if (worker == 0) {  // this thread works as worker 0
+					read_blocks(tiff, layout, image_data.get(), 0, thread_count, flip);
+					return;
+				}
+
+				ifstream worker_fin{tiff_file};
+				TIFF * worker_tiff = TIFFStreamOpen(tiff_file.c_str(), &worker_fin);
+				if (!worker_tiff)
+					throw std::runtime_error{fmt::format("can't open '{}' TIFF file", tiff_file.c_str())};
+				if (!TIFFSetDirectory(worker_tiff, level)) {
+					TIFFClose(worker_tiff);
+					throw std::runtime_error{fmt::format("'{}' level not available in '{}' file", level, tiff_file.c_str())};
+				}
+				try {
+					read_blocks(worker_tiff, layout, image_data.get(), worker, thread_count, flip);
+				}
+				catch (...) {
+					TIFFClose(worker_tiff);
+					throw;
+				}
+				TIFFClose(worker_tiff);
+			});
+		}
+	}
+	catch (...) {
+		TIFFClose(tiff);
+		throw;
 	}
 
 	TIFFClose(tiff);
@@ -144,27 +408,392 @@ tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_desc(path const & tiff_file, b
 		.samples_per_pixel=static_cast<uint8_t>(samples_per_pixel)
 	};
 
-	if (flip) {
-		// TODO: thiis should be handle by a factory mmethod
-		if (bits_per_sample == 8 && samples_per_pixel == 1) {
-			unique_ptr<byte> flipped_data = flip_copy<boost::gil::gray8_pixel_t>(image_data.get(), image_w, image_h, image_size);
-			swap(flipped_data, image_data);
-		}
-		else if (bits_per_sample == 8 && samples_per_pixel == 3) {
-			unique_ptr<byte> flipped_data = flip_copy<boost::gil::rgb8_pixel_t>(image_data.get(), image_w, image_h, image_size);
-			swap(flipped_data, image_data);
+	return {move(image_data), desc};
+}
+
+tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_memory(byte const * content, size_t size) {
+	TIFFSetWarningHandler(suppress_tiff_warnings);
+
+	memory_source src{content, size};
+	TIFF * tiff = open_memory_tiff(src);
+	if (!tiff)
+		throw std::runtime_error{"not a TIFF file content"};
+
+	uint32_t image_w = 0,
+		image_h = 0;
+	TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &image_w);
+	TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &image_h);
+
+	uint16_t bits_per_sample = 0,
+		samples_per_pixel = 0;
+	TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetField(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	assert(samples_per_pixel == 1 || samples_per_pixel == 3);  // expect GRAY or RGB images
+
+	size_t const pixel_size = (bits_per_sample/8)*samples_per_pixel;
+	tiff_block_layout const layout = get_block_layout(tiff, image_w, image_h, pixel_size);
+
+	unique_ptr<byte> image_data{new byte[size_t{image_w}*image_h*pixel_size]};
+	read_blocks(tiff, layout, image_data.get(), 0, 1, false);
+	TIFFClose(tiff);
+
+	tiff_data_desc const desc = {
+		.width=image_w,
+		.height=image_h,
+		.bytes_per_sample=static_cast<uint8_t>(bits_per_sample/8),
+		.samples_per_pixel=static_cast<uint8_t>(samples_per_pixel)
+	};
+
+	return {move(image_data), desc};
+}
+
+unsigned tiff_level_count(path const & tiff_file) {
+	TIFFSetWarningHandler(suppress_tiff_warnings);
+
+	TIFF * tiff = TIFFOpen(tiff_file.c_str(), "r");
+	if (!tiff)
+		throw std::runtime_error{fmt::format("can't open '{}' TIFF file", tiff_file.c_str())};
+
+	unsigned const count = TIFFNumberOfDirectories(tiff);
+	TIFFClose(tiff);
+	return count;
+}
+
+tuple<unique_ptr<byte>, tiff_data_desc> load_tiff_region(path const & tiff_file, int x, int y,
+	size_t w, size_t h, unsigned level) {
+
+	ifstream fin{tiff_file};
+	if (!fin.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' file", tiff_file.c_str())};
+
+	TIFFSetWarningHandler(suppress_tiff_warnings);
+
+	TIFF * tiff = TIFFStreamOpen(tiff_file.c_str(), &fin);
+	if (!tiff)
+		throw std::runtime_error{fmt::format("'{}' is not a TIFF file", tiff_file.c_str())};
+
+	if (!TIFFSetDirectory(tiff, level)) {
+		TIFFClose(tiff);
+		throw std::runtime_error{fmt::format("'{}' level not available in '{}' file", level, tiff_file.c_str())};
+	}
+
+	uint32_t image_w = 0,
+		image_h = 0;
+	TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &image_w);
+	TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &image_h);
+
+	uint16_t bits_per_sample = 0,
+		samples_per_pixel = 0;
+	TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetField(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	assert(samples_per_pixel == 1 || samples_per_pixel == 3);  // expect GRAY or RGB images
+
+	size_t const pixel_size = (bits_per_sample/8)*samples_per_pixel;
+	tiff_block_layout const layout = get_block_layout(tiff, image_w, image_h, pixel_size);
+
+	// window clipped by image
+	long const x0 = std::max(0L, long{x}),
+		y0 = std::max(0L, long{y}),
+		x1 = std::min(long{image_w}, long(x + w)),
+		y1 = std::min(long{image_h}, long(y + h));
+
+	if (x0 >= x1 || y0 >= y1) {
+		TIFFClose(tiff);
+		throw std::runtime_error{fmt::format("({}, {}, {}, {}) region is outside of '{}' image", x, y, w, h, tiff_file.c_str())};
+	}
+
+	size_t const row_size = w*pixel_size;
+	unique_ptr<byte> region_data{new byte[h*row_size]};
+
+	image_window const inside = {size_t(x0), size_t(y0), size_t(x1 - x0), size_t(y1 - y0)};
+	byte * inside_data = region_data.get() + (y0 - y)*row_size + (x0 - x)*pixel_size;
+	vector<byte> block_buf;
+	try {
+		read_window(tiff, layout, inside, inside_data, row_size, block_buf);
+	}
+	catch (...) {
+		TIFFClose(tiff);
+		throw;
+	}
+
+	TIFFClose(tiff);
+
+	// fill pixels outside of the image with the nearest edge pixels (left/right first, then top/bottom rows)
+	for (long r = y0 - y; r < y1 - y; ++r) {
+		byte * row = region_data.get() + r*row_size;
+		for (long c = 0; c < x0 - x; ++c)
+			memcpy(row + c*pixel_size, row + (x0 - x)*pixel_size, pixel_size);
+		for (long c = x1 - x; c < long(w); ++c)
+			memcpy(row + c*pixel_size, row + (x1 - x - 1)*pixel_size, pixel_size);
+	}
+
+	for (long r = 0; r < y0 - y; ++r)
+		memcpy(region_data.get() + r*row_size, region_data.get() + (y0 - y)*row_size, row_size);
+	for (long r = y1 - y; r < long(h); ++r)
+		memcpy(region_data.get() + r*row_size, region_data.get() + (y1 - y - 1)*row_size, row_size);
+
+	tiff_data_desc const desc = {
+		.width=w,
+		.height=h,
+		.bytes_per_sample=static_cast<uint8_t>(bits_per_sample/8),
+		.samples_per_pixel=static_cast<uint8_t>(samples_per_pixel)
+	};
+
+	return {move(region_data), desc};
+}
+
+struct tiff_row_reader::source {
+	ifstream fin;
+	TIFF * tiff = nullptr;
+	tiff_block_layout layout;
+	vector<byte> block_buf;  //!< decoded strip (tile) buffer
+
+	~source() {
+		if (tiff)
+			TIFFClose(tiff);
+	}
+};
+
+tiff_row_reader::tiff_row_reader(path const & tiff_file, size_t max_block_size, unsigned buffer_count,
+	unsigned level)
+		: _src{std::make_unique<source>()} {
+
+	assert(buffer_count > 0);
+
+	_src->fin.open(tiff_file);
+	if (!_src->fin.is_open())
+		throw std::runtime_error{fmt::format("can't open '{}' file", tiff_file.c_str())};
+
+	TIFFSetWarningHandler(suppress_tiff_warnings);
+
+	_src->tiff = TIFFStreamOpen(tiff_file.c_str(), &_src->fin);
+	if (!_src->tiff)
+		throw std::runtime_error{fmt::format("'{}' is not a TIFF file", tiff_file.c_str())};
+
+	if (!TIFFSetDirectory(_src->tiff, level))
+		throw std::runtime_error{fmt::format("'{}' level not available in '{}' file", level, tiff_file.c_str())};
+
+	uint32_t image_w = 0,
+		image_h = 0;
+	TIFFGetField(_src->tiff, TIFFTAG_IMAGEWIDTH, &image_w);
+	TIFFGetField(_src->tiff, TIFFTAG_IMAGELENGTH, &image_h);
+
+	uint16_t bits_per_sample = 0,
+		samples_per_pixel = 0;
+	TIFFGetField(_src->tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetField(_src->tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	assert(samples_per_pixel == 1 || samples_per_pixel == 3);  // expect GRAY or RGB images
+
+	_desc = tiff_data_desc{
+		.width=image_w,
+		.height=image_h,
+		.bytes_per_sample=static_cast<uint8_t>(bits_per_sample/8),
+		.samples_per_pixel=static_cast<uint8_t>(samples_per_pixel)
+	};
+
+	size_t const pixel_size = size_t{_desc.bytes_per_sample}*_desc.samples_per_pixel;
+	_src->layout = get_block_layout(_src->tiff, image_w, image_h, pixel_size);
+
+	// whole strips (rows of tiles) per row block so each strip (tile) is decoded only once
+	size_t const block_h = std::max<size_t>(_src->layout.block_h, 1),
+		row_size = size_t{image_w}*pixel_size,
+		max_rows = std::max<size_t>(max_block_size / std::max<size_t>(row_size, 1), 1);
+
+	_rows_per_block = std::min<size_t>(std::max(max_rows / block_h, size_t{1}) * block_h, image_h);
+
+	_buffers.resize(buffer_count);
+}
+
+tiff_row_reader::~tiff_row_reader() = default;
+
+std::optional<tiff_row_reader::row_block> tiff_row_reader::next() {
+	if (_next_row >= _desc.height)
+		return std::nullopt;
+
+	size_t const row_size = _desc.width * _src->layout.pixel_size;
+
+	unique_ptr<byte[]> & buf = _buffers[_buffer_idx];
+	if (!buf)  // buffers are allocated lazily and then reused
+		buf.reset(new byte[_rows_per_block*row_size]);
+
+	_buffer_idx = (_buffer_idx + 1) % size(_buffers);
+
+	row_block const rows = {
+		.y=_next_row,
+		.h=std::min(_rows_per_block, _desc.height - _next_row),
+		.pixels=buf.get()
+	};
+
+	image_window const window = {0, rows.y, _desc.width, rows.h};
+	read_window(_src->tiff, _src->layout, window, buf.get(), row_size, _src->block_buf);
+
+	_next_row += rows.h;
+	return rows;
+}
+
+void tiff_row_reader::rewind() {
+	_next_row = 0;
+}
+
+mapped_tiff::mapped_tiff(path const & tiff_file, unsigned thread_count, unsigned level)
+	: _map{nullptr}, _map_size{0}, _desc{} {
+
+	int const fd = open(tiff_file.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::runtime_error{fmt::format("can't open '{}' file", tiff_file.c_str())};
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) == -1) {
+		close(fd);
+		throw std::runtime_error{fmt::format("can't stat '{}' file", tiff_file.c_str())};
+	}
+	_map_size = file_stat.st_size;
+	void * map = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);  // mapping is still valid after close
+	if (map == MAP_FAILED)
+		throw std::runtime_error{fmt::format("can't map '{}' file", tiff_file.c_str())};
+	_map = static_cast<byte const *>(map);
+
+	TIFFSetWarningHandler(suppress_tiff_warnings);
+
+	memory_source src{_map, _map_size};
+	TIFF * tiff = open_memory_tiff(src, tiff_file.c_str());
+	if (!tiff) {
+		munmap(map, _map_size);
+		throw std::runtime_error{fmt::format("'{}' is not a TIFF file", tiff_file.c_str())};
+	}
+
+	if (!TIFFSetDirectory(tiff, level)) {
+		TIFFClose(tiff);
+		munmap(map, _map_size);
+		throw std::runtime_error{fmt::format("'{}' level not available in '{}' file", level, tiff_file.c_str())};
+	}
+
+	uint32_t image_w = 0,
+		image_h = 0;
+	TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &image_w);
+	TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &image_h);
+
+	uint16_t bits_per_sample = 0,
+		samples_per_pixel = 0,
+		compression = 0,
+		planar_config = 0;
+	TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetField(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression);
+	TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar_config);
+	assert(samples_per_pixel == 1 || samples_per_pixel == 3);  // expect GRAY or RGB images
+
+	_desc = {
+		.width=image_w,
+		.height=image_h,
+		.bytes_per_sample=static_cast<uint8_t>(bits_per_sample/8),
+		.samples_per_pixel=static_cast<uint8_t>(samples_per_pixel)
+	};
+
+	size_t const pixel_size = _desc.bytes_per_sample*_desc.samples_per_pixel;
+	tiff_block_layout const layout = get_block_layout(tiff, image_w, image_h, pixel_size);
+
+	// we can use mapped pages only for uncompressed, interleaved and native byte order pixels
+	bool const mappable = compression == COMPRESSION_NONE
+		&& (planar_config == PLANARCONFIG_CONTIG || samples_per_pixel == 1)
+		&& (bits_per_sample == 8 || (bits_per_sample == 16 && !TIFFIsByteSwapped(tiff)));
+
+	if (mappable) {
+		size_t const tiles_across = (layout.width + layout.block_w - 1) / layout.block_w;
+		for (size_t i = 0; i < layout.block_count; ++i) {
+			size_t const x = layout.tiled ? (i % tiles_across) * layout.block_w : 0,
+				y = layout.tiled ? (i / tiles_across) * layout.block_h : i * layout.block_h,
+				offset = TIFFGetStrileOffset(tiff, i);
+
+			block const b = {
+				.x=x,
+				.y=y,
+				.w=std::min(layout.block_w, layout.width - x),
+				.h=std::min(layout.block_h, layout.height - y),
+				.row_length=layout.block_w,
+				.pixels=_map + offset
+			};
+
+			// check block data are inside the file (otherwise fallback to decoding)
+			size_t const block_size = ((b.h-1)*b.row_length + b.w)*pixel_size;
+			if (offset + block_size > _map_size || TIFFGetStrileByteCount(tiff, i) < block_size) {
+				_blocks.clear();
+				break;
+			}
+
+			_blocks.push_back(b);
 		}
-		else if (bits_per_sample == 16 && samples_per_pixel == 1) {
-			unique_ptr<byte> flipped_data = flip_copy<boost::gil::gray16_pixel_t>(image_data.get(), image_w, image_h, image_size);
-			swap(flipped_data, image_data);
+	}
+
+	if (empty(_blocks)) {  // decode
+		_decoded.reset(new byte[size_t{image_w}*image_h*pixel_size]);
+
+		thread_count = decoding_threads(thread_count, layout);
+		try {
+			run_workers(thread_count, [&](unsigned worker){
+				if (worker == 0) {
+					read_blocks(tiff, layout, _decoded.get(), 0, thread_count);
+					return;
+				}
+
+				memory_source worker_src{_map, _map_size};  // each worker needs its own handle
+				TIFF * worker_tiff = open_memory_tiff(worker_src, tiff_file.c_str());
+				if (!worker_tiff)
+					throw std::runtime_error{fmt::format("'{}' is not a TIFF file", tiff_file.c_str())};
+				if (!TIFFSetDirectory(worker_tiff, level)) {
+					TIFFClose(worker_tiff);
+					throw std::runtime_error{fmt::format("'{}' level not available in '{}' file", level, tiff_file.c_str())};
+				}
+				try {
+					read_blocks(worker_tiff, layout, _decoded.get(), worker, thread_count);
+				}
+				catch (...) {
+					TIFFClose(worker_tiff);
+					throw;
+				}
+				TIFFClose(worker_tiff);
+			});
 		}
-		else if (bits_per_sample == 16 && samples_per_pixel == 3) {
-			unique_ptr<byte> flipped_data = flip_copy<boost::gil::rgb16_pixel_t>(image_data.get(), image_w, image_h, image_size);
-			swap(flipped_data, image_data);
+		catch (...) {
+			TIFFClose(tiff);
+			munmap(map, _map_size);
+			throw;
 		}
-		else
-			throw std::runtime_error{"flip algorithm only implemented for 8/16bit RGB/GRAY images"};  // TODO: is there any standard not_yet_implemented exception?
+
+		_blocks.push_back(block{
+			.x=0, .y=0,
+			.w=image_w, .h=image_h,
+			.row_length=image_w,
+			.pixels=_decoded.get()
+		});
 	}
 
-	return {move(image_data), desc};
+	TIFFClose(tiff);
+
+	if (_decoded) {  // we do not need mapping anymore
+		munmap(const_cast<byte *>(_map), _map_size);
+		_map = nullptr;
+		_map_size = 0;
+	}
+}
+
+mapped_tiff::~mapped_tiff() {
+	if (_map)
+		munmap(const_cast<byte *>(_map), _map_size);
+}
+
+byte const * mapped_tiff::data() const {
+	if (empty(_blocks) || _blocks[0].w != _desc.width || _blocks[0].row_length != _desc.width)
+		return nullptr;
+
+	// strips stored one after another in a file are the whole image
+	size_t const row_size = _desc.width*_desc.bytes_per_sample*_desc.samples_per_pixel;
+	for (size_t i = 1; i < size(_blocks); ++i) {
+		block const & prev = _blocks[i-1];
+		if (_blocks[i].x != 0 || _blocks[i].w != _desc.width || _blocks[i].pixels != prev.pixels + prev.h*row_size)
+			return nullptr;
+	}
+
+	return _blocks[0].pixels;
 }
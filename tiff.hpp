@@ -1,10 +1,12 @@
 /*! \file
 TIFF image files manipulation support.
-Dependencies: libtiff, Boost.GIL */
+Dependencies: libtiff */
 
 #pragma once
 #include <memory>
+#include <optional>
 #include <tuple>
+#include <vector>
 #include <filesystem>
 #include <cstddef>
 
@@ -15,16 +17,145 @@ struct tiff_data_desc {
 		samples_per_pixel;
 };
 
-/*! Loads striped TIFF file.
+/*! Loads striped or tiled TIFF file.
+\param flip Store image rows bottom-up (first row is the bottom image row, as OpenGL textures expect). Rows
+are written into flipped positions while decoding, no additional image buffer is needed.
+\param thread_count Number of decoding threads, 0 means one thread per hardware core. Strips (tiles)
+are spread across threads, each thread works with its own TIFF handle and decodes directly into the
+result buffer so the result is the same as for a single thread.
+\param level Image file directory (IFD) index, 0 is full resolution image and next directories are
+overviews.
 \return (data, image-descriptor) tupple. */
 std::tuple<std::unique_ptr<std::byte>, tiff_data_desc> load_tiff_desc(
-	std::filesystem::path const & tiff_file, bool flip = false);
+	std::filesystem::path const & tiff_file, bool flip = false, unsigned thread_count = 1, unsigned level = 0);
+
+/*! Decodes TIFF file \c content already stored in a memory (e.g. file read into a buffer), full resolution
+image is decoded by one thread the same way as load_tiff_desc() does.
+\return (data, image-descriptor) tupple. */
+std::tuple<std::unique_ptr<std::byte>, tiff_data_desc> load_tiff_memory(std::byte const * content, size_t size);
+
+/*! \returns Number of image levels (full resolution image and overviews) stored in a TIFF file as
+image file directories (see `split_tiles --overviews`). */
+unsigned tiff_level_count(std::filesystem::path const & tiff_file);
+
+/*! \returns Overview \c level size of \c size pixels image side (each level halves the previous one).
+\param border Image border kept by all overviews (see `split_tiles --border`), only the image interior is halved. */
+constexpr size_t overview_size(size_t size, unsigned level, size_t border = 0) {
+	size -= 2*border;
+	for (; level > 0; --level)
+		size = (size + 1) / 2;
+	return size + 2*border;
+}
+
+/*! Elevation tile border in pixels, tile edge normals are calculated from border pixels (see `normal_map.hpp`).
+Border is kept by elevation tile overviews (see `split_tiles --border`). */
+constexpr unsigned elevation_tile_border = 2;
+
+/*! Loads (x, y, w, h) window from striped or tiled TIFF file, only strips (tiles) overlapping the window
+are decoded. Window can reach outside of the image (e.g. for tile overlap borders on a dataset edge),
+outside pixels are filled by the nearest image edge pixels.
+\param level Image file directory (IFD) index, 0 is full resolution image, next directories are
+expected to be overviews (reduced resolution images).
+\code
+// tile (c, r) with 2px overlap border from a big elevation file
+int const border = 2;
+auto [data, desc] = load_tiff_region("data/plzen_elev.tif", c*tile_size - border, r*tile_size - border,
+	tile_size + 2*border, tile_size + 2*border);
+\endcode
+\return (data, image-descriptor) tupple where image-descriptor describes window data. */
+std::tuple<std::unique_ptr<std::byte>, tiff_data_desc> load_tiff_region(
+	std::filesystem::path const & tiff_file, int x, int y, size_t w, size_t h, unsigned level = 0);
 
 /*! Loads striped TIFF file.
 \deprecated Please use \ref load_tiff_exp function instead.
 \return (data, width, height) triplet. */
 std::tuple<std::unique_ptr<std::byte>, size_t, size_t> load_tiff(std::filesystem::path const & tiff_file);
 
+/*! Memory mapped TIFF file. Pixel data of uncompressed images (with native byte order) are accessed
+directly from mapped file pages without a copy, other images are decoded into a buffer.
+\code
+mapped_tiff image{"data/tile_1_1.tif"};
+for (mapped_tiff::block const & b : image.blocks())
+	glTexSubImage2D(GL_TEXTURE_2D, 0, b.x, b.y, b.w, b.h, ...);  // with GL_UNPACK_ROW_LENGTH set to b.row_length
+\endcode */
+class mapped_tiff {
+public:
+	struct block {  //!< Image area stored as row-major pixels.
+		size_t x, y,  //!< block position in the image (in pixels)
+			w, h;
+		size_t row_length;  //!< number of pixels between block rows
+		std::byte const * pixels;
+	};
+
+	/*! \param thread_count Number of decoding threads in case the image needs to be decoded (0 for all cores).
+	\param level Image file directory (IFD) index, 0 is full resolution image and next directories are
+	overviews, only pages of the requested level are read from the file. */
+	explicit mapped_tiff(std::filesystem::path const & tiff_file, unsigned thread_count = 1, unsigned level = 0);
+	~mapped_tiff();
+
+	mapped_tiff(mapped_tiff const &) = delete;
+	mapped_tiff & operator=(mapped_tiff const &) = delete;
+
+	[[nodiscard]] tiff_data_desc const & desc() const {return _desc;}
+	[[nodiscard]] bool zero_copy() const {return !_decoded;}  //!< pixels are accessed directly from mapped file pages
+	[[nodiscard]] std::vector<block> const & blocks() const {return _blocks;}  //!< strips/tiles or one decoded block
+
+	/*! \returns Whole image as row-major pixel data (top row first) or nullptr in case image blocks
+	are not stored continuously (e.g. tiled image). */
+	[[nodiscard]] std::byte const * data() const;
+
+private:
+	std::byte const * _map;
+	size_t _map_size;
+	tiff_data_desc _desc;
+	std::vector<block> _blocks;
+	std::unique_ptr<std::byte[]> _decoded;  //!< fallback for compressed (or byte swapped) images
+};
+
+/*! Streaming TIFF reader for rasters bigger than RAM. Image is read from top to bottom as blocks of
+whole rows, so memory usage is bounded by row block size and number of row buffers.
+\code
+tiff_row_reader in{"data/europe_elev.tif", 64*1024*1024};
+while (auto rows = in.next()) {
+	// process rows->h rows (starting with rows->y image row) there
+}
+\endcode */
+class tiff_row_reader {
+public:
+	struct row_block {  //!< Image rows stored as row-major pixels.
+		size_t y, h;  //!< first row index and number of rows
+		std::byte const * pixels;
+	};
+
+	/*! \param max_block_size Maximum row block size in bytes, rows are always read by whole strips (or
+	row of tiles) so at least one strip (row of tiles) is read.
+	\param buffer_count Number of reused row buffers, row block returned by next() stays valid for next
+	`buffer_count-1` next() calls (e.g. to process block in a worker while the next one is read).
+	\param level Image file directory (IFD) index, 0 is full resolution image. */
+	explicit tiff_row_reader(std::filesystem::path const & tiff_file, size_t max_block_size = 64*1024*1024,
+		unsigned buffer_count = 1, unsigned level = 0);
+
+	~tiff_row_reader();
+
+	tiff_row_reader(tiff_row_reader const &) = delete;
+	tiff_row_reader & operator=(tiff_row_reader const &) = delete;
+
+	[[nodiscard]] tiff_data_desc const & desc() const {return _desc;}
+	[[nodiscard]] size_t rows_per_block() const {return _rows_per_block;}
+
+	//! \returns Next row block or empty optional after the last image row was read.
+	[[nodiscard]] std::optional<row_block> next();
+	void rewind();  //!< Starts reading from the first image row again.
+
+private:
+	struct source;  //!< opened TIFF file
+	std::unique_ptr<source> _src;
+	tiff_data_desc _desc;
+	size_t _rows_per_block,
+		_next_row = 0;
+	std::vector<std::unique_ptr<std::byte[]>> _buffers;
+	size_t _buffer_idx = 0;
+};
 
 // TODO: Can we garantee noexcept there? Should we do that?
 inline bool is_grayscale(tiff_data_desc const & desc) {
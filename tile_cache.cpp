@@ -0,0 +1,60 @@
+#include "tile_cache.hpp"
+
+using std::optional, std::lock_guard;
+
+tile_cache::tile_cache(size_t byte_budget)
+	: _byte_budget{byte_budget} {}
+
+optional<decoded_image> tile_cache::find(tile_cache_key const & key) {
+	lock_guard lock{_mutex};
+
+	auto it = _index.find(key);
+	if (it == end(_index)) {
+		++_stats.misses;
+		return std::nullopt;
+	}
+
+	_images.splice(begin(_images), _images, it->second);  // move to front (iterators stay valid)
+	++_stats.hits;
+	return it->second->second;
+}
+
+void tile_cache::insert(tile_cache_key const & key, decoded_image const & image) {
+	size_t const image_size = image.size();
+	if (image_size > _byte_budget)
+		return;
+
+	lock_guard lock{_mutex};
+
+	if (auto it = _index.find(key); it != end(_index))  // e.g. tile loaded by two workers
+		erase(it->second);
+
+	while (_stats.size + image_size > _byte_budget) {  // evict least recently used images
+		erase(std::prev(end(_images)));
+		++_stats.evictions;
+	}
+
+	_images.emplace_front(key, image);
+	_index[key] = begin(_images);
+	_stats.size += image_size;
+	_stats.count += 1;
+}
+
+void tile_cache::clear() {
+	lock_guard lock{_mutex};
+	_images.clear();
+	_index.clear();
+	_stats.size = _stats.count = 0;
+}
+
+tile_cache::statistics tile_cache::stats() const {
+	lock_guard lock{_mutex};
+	return _stats;
+}
+
+void tile_cache::erase(lru_list::iterator it) {
+	_stats.size -= it->second.size();
+	_stats.count -= 1;
+	_index.erase(it->first);
+	_images.erase(it);
+}
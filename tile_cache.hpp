@@ -0,0 +1,67 @@
+/*! \file
+Decoded tile image cache with a byte budget and least recently used (LRU) eviction. Cache is thread
+safe, it is meant to be shared by tile loader worker threads (see `tile_loader.hpp`) so that tiles
+requested again (e.g. after camera moves away and back) are not read and decoded again.
+\code
+tile_cache cache{256*1024*1024};
+tile_loader loader{0, &cache};
+\endcode */
+#pragma once
+#include <compare>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <cstddef>
+#include "tile_loader.hpp"
+#include "tile_pack.hpp"
+
+struct tile_cache_key {
+	std::string dataset;  //!< dataset directory or tile pack file
+	int level,
+		column,
+		row;
+	tile_layer layer;
+	unsigned overview;
+	float normal_map_pixel_size;  //!< pixel size normal map was baked with (tile_layer::normals), 0 otherwise
+
+	auto operator<=>(tile_cache_key const &) const = default;
+};
+
+class tile_cache {
+public:
+	struct statistics {
+		size_t hits = 0,
+			misses = 0,
+			evictions = 0,
+			size = 0,  //!< cached bytes
+			count = 0;  //!< cached images
+	};
+
+	//! \param byte_budget Maximum size of cached images in bytes.
+	explicit tile_cache(size_t byte_budget);
+
+	//! \returns Cached image (image becomes the most recently used one) or empty optional.
+	[[nodiscard]] std::optional<decoded_image> find(tile_cache_key const & key);
+
+	/*! Inserts (or replaces) image, least recently used images are evicted to keep cache in budget.
+	\note Images bigger than the budget are not cached. */
+	void insert(tile_cache_key const & key, decoded_image const & image);
+
+	void clear();
+	[[nodiscard]] statistics stats() const;
+	[[nodiscard]] size_t byte_budget() const {return _byte_budget;}
+
+private:
+	using lru_list = std::list<std::pair<tile_cache_key, decoded_image>>;  //!< most recently used first
+
+	void erase(lru_list::iterator it);
+
+	size_t const _byte_budget;
+	mutable std::mutex _mutex;
+	lru_list _images;
+	std::map<tile_cache_key, lru_list::iterator> _index;
+	statistics _stats;
+};
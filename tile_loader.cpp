@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cassert>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include "normal_map.hpp"
+#include "tile_cache.hpp"
+#include "tile_loader.hpp"
+
+using std::vector, std::byte, std::shared_ptr, std::make_shared, std::optional;
+using std::lock_guard, std::unique_lock, std::mutex;
+using std::jthread, std::stop_token;
+
+namespace {
+
+constexpr size_t page_size = 4096;
+
+//! Reads mapped pages in (on a worker thread) so that the upload does not wait for I/O.
+void prefault(byte const * data, size_t size) {
+	uint8_t sum = 0;
+	for (size_t offset = 0; offset < size; offset += page_size)
+		sum ^= static_cast<uint8_t>(data[offset]);
+
+	[[maybe_unused]] uint8_t volatile result = sum;  // keeps reads
+}
+
+decoded_image decode_pack_image(tile_pack const & pack, tile_pack_entry const & e) {
+	decoded_image image = {.desc=pack.desc(e), .pixels=nullptr, .mapped=false};
+
+	if (e.codec == tile_codec::raw) {  // zero copy, pack outlives the loader
+		prefault(pack.data(e), e.size);
+		image.pixels = shared_ptr<byte const[]>{pack.data(e), [](byte const *){}};
+		image.mapped = true;
+	}
+	else {
+		auto buffer = make_shared<vector<byte>>();
+		byte const * pixels = pack.pixels(e, *buffer);
+		image.pixels = shared_ptr<byte const[]>{buffer, pixels};
+	}
+
+	return image;
+}
+
+decoded_image decode_tiff_image(std::filesystem::path const & file, unsigned level) {
+	auto mapped = make_shared<mapped_tiff const>(file, 1, level);
+	if (byte const * pixels = mapped->data()) {  // stored continuously, keep the mapping (or decoded buffer)
+		bool const zero_copy = mapped->zero_copy();  // otherwise decoded (e.g. compressed) image, can be cached
+		decoded_image image = {.desc=mapped->desc(), .pixels=shared_ptr<byte const[]>{mapped, pixels}, .mapped=zero_copy};
+		if (zero_copy)
+			prefault(pixels, image.size());
+		return image;
+	}
+
+	mapped.reset();
+
+	auto [pixels, desc] = load_tiff_desc(file, false, 1, level);
+	return {.desc=desc, .pixels=shared_ptr<byte const[]>{pixels.release()}, .mapped=false};  // allocated as byte[]
+}
+
+tile_cache_key cache_key(tile_request const & r, tile_layer layer, tile_image_source const & source) {
+	return {
+		.dataset=r.dataset,
+		.level=r.id.level,
+		.column=r.id.column,
+		.row=r.id.row,
+		.layer=layer,
+		.overview=source.pack ? source.entry->overview : source.level,
+		.normal_map_pixel_size=layer == tile_layer::normals ? r.normal_map_pixel_size : 0.0f
+	};
+}
+
+}  // namespace
+
+decoded_image decode_image(tile_image_source const & source) {
+	if (source.pack) {
+		assert(source.entry && "pack entry expected");
+		return decode_pack_image(*source.pack, *source.entry);
+	}
+	else
+		return decode_tiff_image(source.file, source.level);
+}
+
+pack_level read_pack_level(tile_pack const & pack, unsigned level, unsigned overview) {
+	pack_level result = {.description = pack.description(level), .tiles = {}};
+	if (empty(result.description))
+		throw std::runtime_error{fmt::format("level {} dataset description not found in '{}' tile pack", level,
+			pack.file().c_str())};
+
+	for (tile_pack_entry const & tile : pack.entries()) {
+		if (tile.level != level || tile.layer != tile_layer::elevation || tile.overview != 0)
+			continue;
+
+		tile_pack_entry const * elevation = pack.find(level, tile_layer::elevation, tile.column, tile.row, overview);
+		if (!elevation)
+			throw std::runtime_error{fmt::format("level {} elevation tile ({}, {}) overview {} not found in '{}' tile pack",
+				level, tile.column, tile.row, overview, pack.file().c_str())};
+
+		tile_pack_entry const * satellite = pack.find(level, tile_layer::satellite, tile.column, tile.row, overview);
+		if (!satellite) {
+			spdlog::info("corresponding satellite data for level {} elevation tile ({}, {}) not found", level, tile.column, tile.row);
+			continue;
+		}
+
+		result.tiles.push_back(pack_terrain_tile{
+			.column = int(tile.column),
+			.row = int(tile.row),
+			.elevation = {.file={}, .level=0, .pack=&pack, .entry=elevation},
+			.satellite = {.file={}, .level=0, .pack=&pack, .entry=satellite}
+		});
+	}
+
+	return result;
+}
+
+tile_loader::tile_loader(unsigned thread_count, tile_cache * cache)
+	: _cache{cache} {
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 0; i < thread_count; ++i)
+		_workers.emplace_back([this](stop_token stop){worker_loop(stop);});
+}
+
+tile_loader::~tile_loader() {
+	for (jthread & worker : _workers)
+		worker.request_stop();  // workers are woken up by stop request (see condition_variable_any::wait)
+	_workers.clear();  // join
+}
+
+void tile_loader::request(tile_request const & r) {
+	{
+		lock_guard lock{_mutex};
+		_requests.push_back(r);
+		++_pending;
+	}
+	_request_ready.notify_one();
+}
+
+optional<loaded_tile> tile_loader::poll() {
+	lock_guard lock{_mutex};
+	if (empty(_results))
+		return std::nullopt;
+
+	loaded_tile r = std::move(_results.front());
+	_results.pop_front();
+	--_pending;
+	return r;
+}
+
+size_t tile_loader::pending() const {
+	lock_guard lock{_mutex};
+	return _pending;
+}
+
+void tile_loader::worker_loop(stop_token stop) {
+	while (true) {
+		tile_request r;
+		{
+			unique_lock lock{_mutex};
+			if (!_request_ready.wait(lock, stop, [this]{return !empty(_requests);}))
+				return;  // stop requested
+
+			r = std::move(_requests.front());
+			_requests.pop_front();
+		}
+
+		loaded_tile loaded = {.id=r.id, .elevation={}, .satellite={}, .normals={}, .error={}};
+		try {
+			loaded.elevation = load_image(r, tile_layer::elevation, r.elevation);
+			loaded.satellite = load_image(r, tile_layer::satellite, r.satellite);
+			if (r.normal_map_pixel_size > 0)
+				loaded.normals = load_normals(r, loaded.elevation);
+		}
+		catch (std::exception const & e) {
+			loaded = {.id=r.id, .elevation={}, .satellite={}, .normals={}, .error=e.what()};
+		}
+
+		lock_guard lock{_mutex};
+		_results.push_back(std::move(loaded));
+	}
+}
+
+decoded_image tile_loader::load_image(tile_request const & r, tile_layer layer, tile_image_source const & source) {
+	if (!_cache || (source.pack && source.entry->codec == tile_codec::raw))  // raw payloads are not decoded
+		return decode_image(source);
+
+	tile_cache_key const key = cache_key(r, layer, source);
+	if (std::optional<decoded_image> image = _cache->find(key))
+		return *image;
+
+	decoded_image image = decode_image(source);
+	if (!image.mapped)  // mapped images are cached by the system page cache
+		_cache->insert(key, image);
+	return image;
+}
+
+decoded_image tile_loader::load_normals(tile_request const & r, decoded_image const & elevation) {
+	if (!_cache)
+		return bake_normal_map(elevation, r.normal_map_pixel_size);
+
+	tile_cache_key const key = cache_key(r, tile_layer::normals, r.elevation);  // baked from elevation tile overview
+	if (std::optional<decoded_image> normals = _cache->find(key))
+		return *normals;
+
+	decoded_image normals = bake_normal_map(elevation, r.normal_map_pixel_size);
+	_cache->insert(key, normals);
+	return normals;
+}
@@ -0,0 +1,125 @@
+/*! \file
+Asynchronous tile loader. Tile images are read and decoded by worker threads, decoded tiles are
+collected in a completion queue and uploaded to GPU by the (OpenGL context owning) main thread.
+\code
+tile_loader loader;
+loader.request({.id={2, c, r}, .dataset=dataset_path, .elevation={.file=elevation_file}, .satellite={.file=satellite_file}});
+// ...
+while (auto tile = loader.poll())  // in the render loop, one tile per frame or bounded by a budget
+	create_texture_16b(tile->elevation.data(), tile->elevation.desc, row_order::top_down);
+\endcode */
+#pragma once
+#include <compare>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include "tiff.hpp"
+#include "tile_pack.hpp"
+
+class tile_cache;
+
+//! Tile image location, TIFF file or tile pack entry.
+struct tile_image_source {
+	std::filesystem::path file;  //!< TIFF file (used when pack is not set)
+	unsigned level = 0;  //!< TIFF image level (overview)
+	tile_pack const * pack = nullptr;  //!< \note pack needs to outlive the loader
+	tile_pack_entry const * entry = nullptr;
+};
+
+//! Decoded tile image stored as tightly packed top-down rows (upload ready).
+struct decoded_image {
+	tiff_data_desc desc;
+	std::shared_ptr<std::byte const[]> pixels;
+	bool mapped = false;  //!< pixels point to mapped file pages (not decoded)
+
+	[[nodiscard]] std::byte const * data() const {return pixels.get();}
+	[[nodiscard]] size_t size() const {return desc.width*desc.height*desc.bytes_per_sample*desc.samples_per_pixel;}
+};
+
+/*! Reads and decodes tile image. Uncompressed stripped TIFF files and raw tile pack payloads are not
+copied, image pixels point to mapped file pages (pages are read in by the function).
+\throw std::runtime_error In case of I/O or decoding error. */
+decoded_image decode_image(tile_image_source const & source);
+
+//! Terrain tile (elevation and satellite image) of a tile pack level.
+struct pack_terrain_tile {
+	int column, row;
+	tile_image_source elevation,
+		satellite;
+};
+
+//! Tile pack level content.
+struct pack_level {
+	std::string_view description;  //!< level dataset description (dataset.json content)
+	std::vector<pack_terrain_tile> tiles;
+};
+
+/*! Reads \c level description and terrain tiles with \c overview images from the \c pack, tiles without
+satellite image are skipped.
+\throw std::runtime_error In case of missing level description or elevation tile overview. */
+pack_level read_pack_level(tile_pack const & pack, unsigned level, unsigned overview);
+
+//! Tile identification in a (quadtree) level grid.
+struct tile_id {
+	int level,
+		column,
+		row;
+
+	auto operator<=>(tile_id const &) const = default;
+};
+
+struct tile_request {
+	tile_id id;
+	std::string dataset;  //!< dataset directory or tile pack file (tile cache key)
+	tile_image_source elevation,
+		satellite;
+	float normal_map_pixel_size = 0;  //!< Elevation pixel size to bake tile normal map (see `normal_map.hpp`), 0 for no normal map.
+};
+
+struct loaded_tile {
+	tile_id id;
+	decoded_image elevation,
+		satellite,
+		normals;  //!< baked normal map in case of tile_request::normal_map_pixel_size (otherwise not set)
+	std::string error;  //!< not empty in case of loading failure (images are not set)
+};
+
+class tile_loader {
+public:
+	/*! \param thread_count Number of worker threads, 0 means one thread per hardware core.
+	\param cache Optional decoded image cache (see `tile_cache.hpp`), needs to outlive the loader. */
+	explicit tile_loader(unsigned thread_count = 0, tile_cache * cache = nullptr);
+	~tile_loader();  //!< Not yet loaded requests are dropped.
+
+	tile_loader(tile_loader const &) = delete;
+	tile_loader & operator=(tile_loader const &) = delete;
+
+	void request(tile_request const & r);  //!< Requests are loaded in FIFO order.
+
+	//! \returns Loaded tile or empty optional if there is no loaded tile (never blocks).
+	[[nodiscard]] std::optional<loaded_tile> poll();
+
+	//! \returns Number of requested tiles not yet returned by poll().
+	[[nodiscard]] size_t pending() const;
+
+private:
+	void worker_loop(std::stop_token stop);
+	decoded_image load_image(tile_request const & r, tile_layer layer, tile_image_source const & source);
+	decoded_image load_normals(tile_request const & r, decoded_image const & elevation);  //!< Bakes (or finds cached) normal map.
+
+	mutable std::mutex _mutex;
+	std::condition_variable_any _request_ready;
+	std::deque<tile_request> _requests;
+	std::deque<loaded_tile> _results;
+	size_t _pending = 0;
+	tile_cache * _cache;
+	std::vector<std::jthread> _workers;  //!< \note needs to be the last member (joined first)
+};
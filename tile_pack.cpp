@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <tuple>
+#include <cassert>
+#include <cstring>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dem_codec.hpp"
+#include "tile_pack.hpp"
+
+using std::string_view, std::vector, std::byte, std::size, std::tie;
+using std::filesystem::path;
+using fmt::format;
+
+namespace {
+
+constexpr char pack_magic[8] = {'E', 'R', 'T', 'P', 'A', 'C', 'K', '\0'};
+constexpr uint32_t pack_version = 1;
+constexpr uint64_t payload_alignment = 4096;
+
+struct tile_pack_header {
+	char magic[8];
+	uint32_t version,
+		entry_count;
+	uint64_t index_offset,
+		file_size;  //!< to detect truncated files
+};
+
+static_assert(sizeof(tile_pack_header) == 32, "unexpected pack header layout");
+
+auto entry_key(tile_pack_entry const & e) {
+	return std::tuple{e.level, e.layer, e.row, e.column, e.overview};
+}
+
+//! \returns \c value narrowed to an 8bit entry field, throws in case \c value does not fit.
+uint8_t to_entry_field(unsigned value, char const * field, path const & fname) {
+	if (value > 0xff)
+		throw std::runtime_error{format("{} {} out of range (0-255) for '{}' pack", field, value, fname.c_str())};
+	return uint8_t(value);
+}
+
+}  // namespace
+
+tile_codec to_tile_codec(string_view name) {
+	if (name == "raw")
+		return tile_codec::raw;
+	else if (name == "dem")
+		return tile_codec::dem;
+	else
+		throw std::runtime_error{format("unknown '{}' tile codec", name)};
+}
+
+tile_pack::tile_pack(path const & pack_file) : _file{pack_file}, _map{nullptr}, _map_size{0} {
+	int const fd = open(pack_file.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::runtime_error{format("can't open '{}' file", pack_file.c_str())};
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(tile_pack_header)) {
+		close(fd);
+		throw std::runtime_error{format("'{}' is not a tile pack file", pack_file.c_str())};
+	}
+
+	_map_size = st.st_size;
+	void * map = mmap(nullptr, _map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);  // mapping keeps file open
+	if (map == MAP_FAILED)
+		throw std::runtime_error{format("can't map '{}' file", pack_file.c_str())};
+
+	_map = static_cast<byte const *>(map);
+
+	tile_pack_header header;
+	memcpy(&header, _map, sizeof(header));
+
+	bool const valid = memcmp(header.magic, pack_magic, sizeof(pack_magic)) == 0
+		&& header.version == pack_version
+		&& header.file_size == _map_size
+		&& header.index_offset % alignof(tile_pack_entry) == 0
+		&& header.index_offset <= _map_size
+		&& uint64_t{header.entry_count}*sizeof(tile_pack_entry) <= _map_size - header.index_offset;
+
+	if (!valid) {
+		munmap(const_cast<byte *>(_map), _map_size);
+		throw std::runtime_error{format("'{}' is not a valid (version {}) tile pack file", pack_file.c_str(), pack_version)};
+	}
+
+	_entries = {reinterpret_cast<tile_pack_entry const *>(_map + header.index_offset), header.entry_count};
+
+	for (tile_pack_entry const & e : _entries)
+		if (e.size > _map_size || e.offset > _map_size - e.size || e.codec > tile_codec::dem) {  // offset + size can overflow
+			munmap(const_cast<byte *>(_map), _map_size);
+			throw std::runtime_error{format("'{}' tile pack file is corrupted", pack_file.c_str())};
+		}
+}
+
+tile_pack::~tile_pack() {
+	if (_map)
+		munmap(const_cast<byte *>(_map), _map_size);
+}
+
+tile_pack_entry const * tile_pack::find(unsigned level, tile_layer layer, unsigned column, unsigned row,
+	unsigned overview) const {
+	tile_pack_entry key = {};
+	key.level = uint8_t(level);
+	key.layer = layer;
+	key.column = column;
+	key.row = row;
+	key.overview = uint8_t(overview);
+	auto it = std::lower_bound(begin(_entries), end(_entries), key,
+		[](tile_pack_entry const & a, tile_pack_entry const & b){return entry_key(a) < entry_key(b);});
+
+	if (it == end(_entries) || entry_key(*it) != entry_key(key))
+		return nullptr;
+
+	return &*it;
+}
+
+byte const * tile_pack::pixels(tile_pack_entry const & e, vector<byte> & buffer) const {
+	if (e.codec == tile_codec::raw)
+		return data(e);
+
+	assert(e.codec == tile_codec::dem && e.bytes_per_sample == 2 && e.samples_per_pixel == 1);
+	buffer.resize(size_t{e.width}*e.height*sizeof(uint16_t));
+	decode_dem(data(e), e.size, e.width, e.height, reinterpret_cast<uint16_t *>(buffer.data()));
+	return buffer.data();
+}
+
+tiff_data_desc tile_pack::desc(tile_pack_entry const & e) const {
+	return {
+		.width=e.width,
+		.height=e.height,
+		.bytes_per_sample=e.bytes_per_sample,
+		.samples_per_pixel=e.samples_per_pixel
+	};
+}
+
+string_view tile_pack::description(unsigned level) const {
+	tile_pack_entry const * e = find(level, tile_layer::description, 0, 0);
+	if (!e)
+		return {};
+	return {reinterpret_cast<char const *>(data(*e)), e->size};
+}
+
+tile_pack_writer::tile_pack_writer(path const & pack_file)
+	: _fname{pack_file}, _fout{pack_file, std::ios::binary} {
+
+	if (!_fout.is_open())
+		throw std::runtime_error{format("can't create '{}' file", pack_file.c_str())};
+
+	tile_pack_header const header = {};  // written by finish()
+	_fout.write(reinterpret_cast<char const *>(&header), sizeof(header));
+}
+
+void tile_pack_writer::add_tile(unsigned level, tile_layer layer, unsigned column, unsigned row, unsigned overview,
+	tiff_data_desc const & desc, byte const * pixels, tile_codec codec) {
+
+	tile_pack_entry e = {
+		.level=to_entry_field(level, "level", _fname),
+		.layer=layer,
+		.codec=codec,
+		.overview=to_entry_field(overview, "overview", _fname),
+		.column=column,
+		.row=row,
+		.width=uint32_t(desc.width),
+		.height=uint32_t(desc.height),
+		.bytes_per_sample=desc.bytes_per_sample,
+		.samples_per_pixel=desc.samples_per_pixel,
+		.offset=0,
+		.size=uint64_t{desc.width}*desc.height*desc.bytes_per_sample*desc.samples_per_pixel
+	};
+
+	if (codec == tile_codec::dem) {
+		if (desc.bytes_per_sample != 2 || !is_grayscale(desc))
+			throw std::runtime_error{format("16bit grayscale tile expected for DEM codec ('{}' pack)", _fname.c_str())};
+
+		vector<byte> const encoded = encode_dem(reinterpret_cast<uint16_t const *>(pixels), desc.width, desc.height);
+		e.size = size(encoded);
+		write_payload(e, encoded.data());
+	}
+	else
+		write_payload(e, pixels);
+}
+
+void tile_pack_writer::add_description(unsigned level, string_view dataset_desc) {
+	tile_pack_entry e = {
+		.level=to_entry_field(level, "level", _fname),
+		.layer=tile_layer::description,
+		.column=0,
+		.row=0,
+		.width=uint32_t(size(dataset_desc)),
+		.height=1,
+		.bytes_per_sample=1,
+		.samples_per_pixel=1,
+		.offset=0,
+		.size=size(dataset_desc)
+	};
+
+	write_payload(e, reinterpret_cast<byte const *>(dataset_desc.data()));
+}
+
+void tile_pack_writer::write_payload(tile_pack_entry & e, byte const * data) {
+	// pad to aligned payload offset
+	uint64_t const pos = _fout.tellp();
+	uint64_t const offset = (pos + payload_alignment - 1) / payload_alignment * payload_alignment;
+	std::fill_n(std::ostreambuf_iterator<char>{_fout}, offset - pos, '\0');
+
+	e.offset = offset;
+	_fout.write(reinterpret_cast<char const *>(data), e.size);
+	if (!_fout)
+		throw std::runtime_error{format("unable to write '{}' file", _fname.c_str())};
+
+	_index.push_back(e);
+}
+
+void tile_pack_writer::finish() {
+	std::ranges::sort(_index, [](tile_pack_entry const & a, tile_pack_entry const & b){
+		return entry_key(a) < entry_key(b);});
+
+	auto const duplicate = std::ranges::adjacent_find(_index, [](tile_pack_entry const & a, tile_pack_entry const & b){
+		return entry_key(a) == entry_key(b);});
+	if (duplicate != end(_index))
+		throw std::runtime_error{format("duplicate (level={}, column={}, row={}, overview={}) entry in '{}' pack",
+			duplicate->level, duplicate->column, duplicate->row, duplicate->overview, _fname.c_str())};
+
+	// index
+	uint64_t const pos = _fout.tellp();
+	uint64_t const index_offset = (pos + alignof(tile_pack_entry) - 1) / alignof(tile_pack_entry) * alignof(tile_pack_entry);
+	std::fill_n(std::ostreambuf_iterator<char>{_fout}, index_offset - pos, '\0');
+	_fout.write(reinterpret_cast<char const *>(_index.data()), size(_index)*sizeof(tile_pack_entry));
+
+	// header
+	tile_pack_header header = {
+		.magic={},
+		.version=pack_version,
+		.entry_count=uint32_t(size(_index)),
+		.index_offset=index_offset,
+		.file_size=uint64_t(_fout.tellp())
+	};
+	memcpy(header.magic, pack_magic, sizeof(pack_magic));
+
+	_fout.seekp(0);
+	_fout.write(reinterpret_cast<char const *>(&header), sizeof(header));
+	_fout.close();
+
+	if (!_fout)
+		throw std::runtime_error{format("unable to write '{}' file", _fname.c_str())};
+}
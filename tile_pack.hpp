@@ -0,0 +1,112 @@
+/*! \file
+Tile pack, single file dataset container (see `pack_tiles` tool).
+
+File layout (little endian):
+- header
+- tile payloads, each payload starts at page (4096B) aligned offset and contains tightly packed
+  (upload ready) image rows in top-down order
+- index of entries sorted by (level, layer, row, column, overview)
+
+Dataset description (`dataset.json`) of each level is stored as `tile_layer::description` payload. Pack
+is opened with a single `open` and `mmap` call and payloads are accessed directly from mapped memory.
+Elevation payloads can be encoded (see `tile_codec`), encoded payloads are decoded by tile_pack::pixels().
+Tile overviews (reduced resolution images, see `split_tiles --overviews`) are stored as separate entries
+with the same (level, layer, column, row) and overview level bigger than 0. */
+
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "tiff.hpp"
+
+enum class tile_layer : uint8_t {
+	elevation,
+	satellite,
+	description,  //!< level dataset description (dataset.json content)
+	normals  //!< baked normal map, not stored in packs (tile cache key only, see `normal_map.hpp`)
+};
+
+enum class tile_codec : uint8_t {
+	raw,  //!< upload ready payload
+	dem  //!< 16bit elevation codec (see `dem_codec.hpp`)
+};
+
+//! \returns Codec for `elevation.codec` dataset description value ("raw" or "dem").
+tile_codec to_tile_codec(std::string_view name);
+
+//! Index entry as stored in a pack file.
+struct tile_pack_entry {
+	uint8_t level;
+	tile_layer layer;
+	tile_codec codec = tile_codec::raw;
+	uint8_t overview = 0;  //!< 0 for full resolution tile image
+	uint32_t column, row;
+	uint32_t width, height;  //!< in pixels (description payload has width equal to payload size and height = 1)
+	uint8_t bytes_per_sample,
+		samples_per_pixel;
+	uint16_t reserved2 = 0;
+	uint64_t offset,  //!< payload offset from the beginning of the file
+		size;  //!< payload size in bytes
+};
+
+static_assert(sizeof(tile_pack_entry) == 40, "unexpected pack index entry layout");
+
+//! Memory mapped tile pack file.
+class tile_pack {
+public:
+	explicit tile_pack(std::filesystem::path const & pack_file);
+	~tile_pack();
+
+	tile_pack(tile_pack const &) = delete;
+	tile_pack & operator=(tile_pack const &) = delete;
+
+	[[nodiscard]] std::span<tile_pack_entry const> entries() const {return _entries;}
+	[[nodiscard]] std::filesystem::path const & file() const {return _file;}
+
+	//! \returns Entry pointer or nullptr if there is no such entry in the pack.
+	[[nodiscard]] tile_pack_entry const * find(unsigned level, tile_layer layer, unsigned column, unsigned row,
+		unsigned overview = 0) const;
+
+	[[nodiscard]] std::byte const * data(tile_pack_entry const & e) const {return _map + e.offset;}  //!< payload
+
+	/*! \returns Upload ready (top-down) tile pixels, raw payloads are returned straight from mapped memory,
+	encoded payloads are decoded into \c buffer (reuse the buffer for the next tile).
+	\throw std::runtime_error In case of corrupted payload. */
+	[[nodiscard]] std::byte const * pixels(tile_pack_entry const & e, std::vector<std::byte> & buffer) const;
+	[[nodiscard]] tiff_data_desc desc(tile_pack_entry const & e) const;
+
+	//! \returns Level dataset description (dataset.json content) or empty string.
+	[[nodiscard]] std::string_view description(unsigned level) const;
+
+private:
+	std::filesystem::path _file;
+	std::byte const * _map;
+	size_t _map_size;
+	std::span<tile_pack_entry const> _entries;
+};
+
+//! Writes tile pack file, payloads are written as they are added so memory usage stays low.
+class tile_pack_writer {
+public:
+	explicit tile_pack_writer(std::filesystem::path const & pack_file);
+
+	/*! \param overview Tile overview level, 0 for full resolution tile image.
+	\param codec Payload codec, tile_codec::dem expects 16bit grayscale tile. */
+	void add_tile(unsigned level, tile_layer layer, unsigned column, unsigned row, unsigned overview,
+		tiff_data_desc const & desc, std::byte const * pixels, tile_codec codec = tile_codec::raw);
+
+	void add_description(unsigned level, std::string_view dataset_desc);
+
+	void finish();  //!< Writes index and header.
+
+private:
+	void write_payload(tile_pack_entry & e, std::byte const * data);
+
+	std::filesystem::path _fname;
+	std::ofstream _fout;
+	std::vector<tile_pack_entry> _index;
+};
@@ -12,7 +12,11 @@ variable defined as `out vec3 d;`. */
 in vec3 d[];  // TODO: need to find a better name, because in vertex shader `d` is easy do colidate with something else
 const float d_length = 0.01;
 
+#ifdef UNIFORM_BLOCKS  // vertices are in world space, transformation from terrain_frame block
+#define local_to_screen world_to_screen
+#else
 uniform mat4 local_to_screen;   // TODO: should be this word_to_screen instead (normals are in a word space)?
+#endif
 
 void main() {
 	for (int i = 0; i < gl_in.length(); ++i) {
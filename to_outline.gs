@@ -6,7 +6,11 @@ to draw wireframe for a mesh (of triangles). */
 layout(triangles) in;
 layout(line_strip, max_vertices = 4) out;
 
+#ifdef UNIFORM_BLOCKS  // vertices are in world space, transformation from terrain_frame block
+#define local_to_screen world_to_screen
+#else
 uniform mat4 local_to_screen;   // TODO: should be this word_to_screen instead (normals are in a word space)?
+#endif
 
 void main() {
 	gl_Position = local_to_screen * vec4(gl_in[0].gl_Position.xyz, 1);